@@ -0,0 +1,11 @@
+#ifndef ALLOCATION_COUNT_H
+#define ALLOCATION_COUNT_H
+
+#include <cstdint>
+
+// Calls to operator new since the program started. Only programs that link allocation_count.cpp, which replaces the
+// global operator new, can use it; what the C library allocates with malloc, such as the FILE behind an open
+// std::ifstream, is not seen
+uint64_t heapAllocationCount();
+
+#endif // ALLOCATION_COUNT_H
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "chunk_ring.h"
+#include "hash.h"
+#include "sha256_mb.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <typeinfo>
+#include <vector>
+
+class FileReader;
+
+// Hash contexts, read buffers, readers, the read-ahead ring and multi-buffer batch lists that outlive the file they
+// were made for. A worker hashing many files keeps one arena, and each file re-initializes what earlier files left
+// in it instead of allocating and tearing down its own. Threads are not kept: a file read ahead on another thread
+// (see HashOptions::bufferCount) still starts that thread. Only one file may use an arena at a time, so each worker
+// needs its own.
+class HashArena {
+    public:
+        struct Stats {
+            uint64_t files = 0;
+            // Times the arena had nothing to reuse and made a new hasher, buffer, reader or ring. This counts misses
+            // of the arena, not heap allocations, which hasher-bench measures
+            uint64_t misses = 0;
+
+            [[nodiscard]] double missesPerFile() const;
+            Stats& operator+=(const Stats& other);
+        };
+
+        HashArena();
+        HashArena(const HashArena&) = delete;
+        HashArena& operator=(const HashArena&) = delete;
+        ~HashArena();
+
+        // A fresh hasher for every distinct algorithm of the list, in order. Valid until the next call
+        const std::vector<Hasher*>& hashers(std::span<const wc_HashType> algorithms);
+        // BUFFER_SIZE bytes to read the given slot into
+        std::span<byte> readBuffer(size_t slot);
+        // An empty buffer with room for at least capacity bytes, for holding the index-th whole file of a batch
+        std::vector<byte>& fileBuffer(size_t index, size_t capacity);
+        // An emptied ring of slotCount chunks for reading ahead of consumerCount hashing threads
+        ChunkRing& chunkRing(size_t slotCount, size_t consumerCount);
+        // The messages and digests of one multi-buffer SHA-256 batch: the list of messages comes back empty and the
+        // digests sized for count messages
+        std::vector<std::span<const uint8_t>>& batchMessages();
+        std::vector<std::array<uint8_t, SHA256_MB_DIGEST_SIZE>>& batchDigests(size_t count);
+
+        // A closed reader of exactly the given type left by an earlier file, or nullptr. Readers opened with an arena
+        // are parked here when they are done, see FileReaderDeleter in reader.h
+        std::unique_ptr<FileReader> takeReader(const std::type_info& type);
+        void parkReader(std::unique_ptr<FileReader> reader);
+
+        // Called once per file hashed, so misses can be reported per file
+        void countFile() { counters.files++; }
+
+        [[nodiscard]] const Stats& stats() const { return counters; }
+
+    private:
+        // Stream, mmap, direct and io_uring; one file at a time never needs two readers of a kind
+        static constexpr size_t MAX_IDLE_READERS = 4;
+
+        std::array<std::unique_ptr<Hasher>, MAX_ALGORITHMS> idleHashers;
+        std::vector<Hasher*> activeHashers;
+        std::vector<std::unique_ptr<byte[]>> readBuffers;
+        std::vector<std::vector<byte>> fileBuffers;
+        ChunkRing ring;
+        std::vector<std::span<const uint8_t>> messages;
+        std::vector<std::array<uint8_t, SHA256_MB_DIGEST_SIZE>> digests;
+        std::vector<std::unique_ptr<FileReader>> idleReaders;
+        Stats counters;
+};
+
+#endif // ARENA_H
\ No newline at end of file
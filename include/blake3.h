@@ -0,0 +1,45 @@
+#ifndef BLAKE3_H
+#define BLAKE3_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t BLAKE3_OUT_LEN = 32;
+
+// BLAKE3 in its default hashing mode. Input is split into 1 KiB chunks that form a binary tree, so large updates are
+// hashed many chunks at a time with the widest SIMD kernel the CPU supports (SSE4.1, AVX2 or AVX-512) and, when they
+// are big enough, split across a shared set of threads.
+class Blake3 {
+    public:
+        Blake3();
+        void update(const uint8_t* input, size_t size);
+        // Write the first outputSize bytes of the extendable output; the standard digest is BLAKE3_OUT_LEN bytes
+        void finalize(uint8_t* output, size_t outputSize) const;
+        // Whether the chunk and the chaining value stack agree with each other, for a state restored from raw bytes
+        [[nodiscard]] bool isValid() const;
+
+        // The chunk currently being filled
+        struct ChunkState {
+            std::array<uint32_t, 8> cv{};
+            uint64_t counter = 0;
+            std::array<uint8_t, 64> buffer{};
+            uint8_t bufferLength = 0;
+            uint8_t blocksCompressed = 0;
+
+            [[nodiscard]] size_t length() const { return blocksCompressed * buffer.size() + bufferLength; }
+        };
+
+    private:
+        // One chaining value per level of the tree, enough for 2^54 chunks
+        static constexpr size_t MAX_DEPTH = 54;
+
+        ChunkState chunk;
+        std::array<std::array<uint8_t, BLAKE3_OUT_LEN>, MAX_DEPTH + 1> cvStack{};
+        size_t cvStackLength = 0;
+
+        void mergeCvStack(uint64_t totalChunks);
+        void pushCv(const uint8_t* cv, uint64_t chunkCounter);
+};
+
+#endif // BLAKE3_H
\ No newline at end of file
@@ -0,0 +1,175 @@
+#ifndef BLAKE3_IMPL_H
+#define BLAKE3_IMPL_H
+
+// Internals shared by the BLAKE3 hasher and its SIMD kernels. Each kernel lives in its own file built with flags for
+// its instruction set, so everything here is in an anonymous namespace: an inline function shared between those
+// files could otherwise be merged into a single copy that uses instructions the CPU does not have.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HASHER_HAVE_BLAKE3_X86
+#endif
+
+// Hash count inputs of blocks * 64 bytes each, every input starting stride bytes after the previous one. Input i is
+// compressed with counter + i when incrementCounter is set (chunks) or plain counter otherwise (parents), its first
+// block also gets flagsStart and its last flagsEnd, and its 32 byte chaining value is written to out + 32 * i.
+// Each kernel only hashes whole groups of its width and returns how many inputs it took.
+#ifdef HASHER_HAVE_BLAKE3_X86
+size_t blake3HashManySse41(const uint8_t* input, size_t count, size_t stride, size_t blocks, const uint32_t key[8],
+                           uint64_t counter, bool incrementCounter, uint8_t flags, uint8_t flagsStart,
+                           uint8_t flagsEnd, uint8_t* out);
+size_t blake3HashManyAvx2(const uint8_t* input, size_t count, size_t stride, size_t blocks, const uint32_t key[8],
+                          uint64_t counter, bool incrementCounter, uint8_t flags, uint8_t flagsStart,
+                          uint8_t flagsEnd, uint8_t* out);
+size_t blake3HashManyAvx512(const uint8_t* input, size_t count, size_t stride, size_t blocks, const uint32_t key[8],
+                            uint64_t counter, bool incrementCounter, uint8_t flags, uint8_t flagsStart,
+                            uint8_t flagsEnd, uint8_t* out);
+#endif
+
+namespace
+{
+constexpr size_t BLAKE3_BLOCK_LEN = 64;
+constexpr size_t BLAKE3_CHUNK_LEN = 1024;
+
+enum Blake3Flags : uint8_t {
+    CHUNK_START = 1 << 0,
+    CHUNK_END = 1 << 1,
+    PARENT = 1 << 2,
+    ROOT = 1 << 3,
+};
+
+constexpr uint32_t BLAKE3_IV[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+// Message word order for each of the seven rounds
+constexpr uint8_t BLAKE3_SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}, {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1}, {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4}, {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+inline uint32_t loadLittleEndian(const uint8_t* bytes)
+{
+    return uint32_t{bytes[0]} | uint32_t{bytes[1]} << 8 | uint32_t{bytes[2]} << 16 | uint32_t{bytes[3]} << 24;
+}
+
+inline void storeLittleEndian(uint8_t* bytes, const uint32_t value)
+{
+    bytes[0] = static_cast<uint8_t>(value);
+    bytes[1] = static_cast<uint8_t>(value >> 8);
+    bytes[2] = static_cast<uint8_t>(value >> 16);
+    bytes[3] = static_cast<uint8_t>(value >> 24);
+}
+
+// Kernel shared by every instruction set. Ops supplies a vector type holding one 32-bit word from each of DEGREE
+// inputs, arithmetic on it, and loadBlock, which transposes one 64-byte block of every input into 16 message vectors.
+template <typename Ops>
+inline void blake3G(typename Ops::Vec* v, const size_t a, const size_t b, const size_t c, const size_t d,
+                    const typename Ops::Vec x, const typename Ops::Vec y)
+{
+    v[a] = Ops::add(Ops::add(v[a], v[b]), x);
+    v[d] = Ops::rotr16(Ops::bitXor(v[d], v[a]));
+    v[c] = Ops::add(v[c], v[d]);
+    v[b] = Ops::rotr12(Ops::bitXor(v[b], v[c]));
+    v[a] = Ops::add(Ops::add(v[a], v[b]), y);
+    v[d] = Ops::rotr8(Ops::bitXor(v[d], v[a]));
+    v[c] = Ops::add(v[c], v[d]);
+    v[b] = Ops::rotr7(Ops::bitXor(v[b], v[c]));
+}
+
+template <typename Ops>
+inline void blake3HashGroup(const uint8_t* input, const size_t stride, const size_t blocks, const uint32_t key[8],
+                            const uint64_t counter, const bool incrementCounter, const uint8_t flags,
+                            const uint8_t flagsStart, const uint8_t flagsEnd, uint8_t* out)
+{
+    using Vec = typename Ops::Vec;
+    constexpr size_t DEGREE = Ops::DEGREE;
+
+    alignas(64) uint32_t counterLow[DEGREE];
+    alignas(64) uint32_t counterHigh[DEGREE];
+    for (size_t lane = 0; lane < DEGREE; lane++)
+    {
+        const uint64_t laneCounter = counter + (incrementCounter ? lane : 0);
+        counterLow[lane] = static_cast<uint32_t>(laneCounter);
+        counterHigh[lane] = static_cast<uint32_t>(laneCounter >> 32);
+    }
+
+    Vec cv[8];
+    for (size_t i = 0; i < 8; i++)
+    {
+        cv[i] = Ops::set1(key[i]);
+    }
+
+    uint8_t blockFlags = flags | flagsStart;
+    for (size_t block = 0; block < blocks; block++)
+    {
+        if (block + 1 == blocks)
+        {
+            blockFlags |= flagsEnd;
+        }
+
+        Vec message[16];
+        Ops::loadBlock(input + block * BLAKE3_BLOCK_LEN, stride, message);
+
+        Vec v[16] = {cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7]};
+        for (size_t i = 0; i < 4; i++)
+        {
+            v[8 + i] = Ops::set1(BLAKE3_IV[i]);
+        }
+        v[12] = Ops::load(counterLow);
+        v[13] = Ops::load(counterHigh);
+        v[14] = Ops::set1(static_cast<uint32_t>(BLAKE3_BLOCK_LEN));
+        v[15] = Ops::set1(blockFlags);
+        for (const auto& schedule : BLAKE3_SCHEDULE)
+        {
+            blake3G<Ops>(v, 0, 4, 8, 12, message[schedule[0]], message[schedule[1]]);
+            blake3G<Ops>(v, 1, 5, 9, 13, message[schedule[2]], message[schedule[3]]);
+            blake3G<Ops>(v, 2, 6, 10, 14, message[schedule[4]], message[schedule[5]]);
+            blake3G<Ops>(v, 3, 7, 11, 15, message[schedule[6]], message[schedule[7]]);
+            blake3G<Ops>(v, 0, 5, 10, 15, message[schedule[8]], message[schedule[9]]);
+            blake3G<Ops>(v, 1, 6, 11, 12, message[schedule[10]], message[schedule[11]]);
+            blake3G<Ops>(v, 2, 7, 8, 13, message[schedule[12]], message[schedule[13]]);
+            blake3G<Ops>(v, 3, 4, 9, 14, message[schedule[14]], message[schedule[15]]);
+        }
+        for (size_t i = 0; i < 8; i++)
+        {
+            cv[i] = Ops::bitXor(v[i], v[i + 8]);
+        }
+        blockFlags = flags;
+    }
+
+    // Chaining values come out word-major and are written lane-major
+    alignas(64) uint32_t words[8][DEGREE];
+    for (size_t i = 0; i < 8; i++)
+    {
+        Ops::store(words[i], cv[i]);
+    }
+    for (size_t lane = 0; lane < DEGREE; lane++)
+    {
+        for (size_t i = 0; i < 8; i++)
+        {
+            storeLittleEndian(out + lane * 32 + i * 4, words[i][lane]);
+        }
+    }
+}
+
+template <typename Ops>
+inline size_t blake3HashManyWide(const uint8_t* input, const size_t count, const size_t stride, const size_t blocks,
+                                 const uint32_t key[8], const uint64_t counter, const bool incrementCounter,
+                                 const uint8_t flags, const uint8_t flagsStart, const uint8_t flagsEnd, uint8_t* out)
+{
+    size_t done = 0;
+    for (; done + Ops::DEGREE <= count; done += Ops::DEGREE)
+    {
+        blake3HashGroup<Ops>(input + done * stride, stride, blocks, key, counter + (incrementCounter ? done : 0),
+                             incrementCounter, flags, flagsStart, flagsEnd, out + done * 32);
+    }
+    return done;
+}
+} // namespace
+
+#endif // BLAKE3_IMPL_H
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "hash.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// What the filesystem says about a file without reading it. Any write to the file changes at least one of these
+struct FileIdentity {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t mtimeNs = 0;
+    int64_t ctimeNs = 0;
+
+    bool operator==(const FileIdentity&) const = default;
+};
+
+// Identity of a regular file, or nothing for anything else or a path that cannot be stat'ed
+std::optional<FileIdentity> fileIdentity(const std::string& filePath);
+
+struct CompactResult {
+    uint64_t kept = 0;
+    uint64_t dropped = 0;
+};
+
+// Digests of previously hashed files, kept in an append-only file of fixed layout records that is memory mapped for
+// lookups. Entries are keyed by FileIdentity plus the set of algorithms they hold, and several processes can share
+// one cache file: appends take an exclusive flock, reads a shared one, and compaction swaps in a new file that other
+// processes pick up the next time they take the lock.
+class DigestCache {
+    public:
+        explicit DigestCache(const std::string& cachePath);
+        DigestCache(const DigestCache&) = delete;
+        DigestCache& operator=(const DigestCache&) = delete;
+        ~DigestCache();
+
+        // Digests for every requested algorithm if an entry for this exact file version holds all of them
+        std::optional<DigestSet> lookup(const FileIdentity& identity, const std::vector<wc_HashType>& hashesToCalculate);
+        void store(const FileIdentity& identity, const std::string& filePath, const DigestSet& digests);
+        // Forget every digest stored for the file at filePath. Returns false if the file cannot be stat'ed
+        bool invalidate(const std::string& filePath);
+        // Drop every entry
+        void clear();
+        // Rewrite the cache without invalidated or superseded entries and without entries for files that have since
+        // changed or disappeared
+        CompactResult compact();
+
+    private:
+        struct State;
+        std::unique_ptr<State> state;
+};
+
+#endif // CACHE_H
\ No newline at end of file
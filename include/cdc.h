@@ -0,0 +1,78 @@
+#ifndef CDC_H
+#define CDC_H
+
+#include "hash.h"
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+constexpr uint32_t DEFAULT_CDC_AVERAGE_SIZE = 16 * 1024;
+
+// Chunk size limits for content-defined chunking. The average has to be a power of two from 256 bytes to 64 MB
+struct ChunkingParameters {
+    uint32_t minimumSize;
+    uint32_t averageSize;
+    uint32_t maximumSize;
+
+    // A quarter to four times the average, as FastCDC suggests. Throws std::invalid_argument for an unusable average
+    static ChunkingParameters forAverage(uint32_t averageSize);
+};
+
+// Variable-size chunks of one file whose boundaries depend only on the bytes around them, so an insertion moves the
+// chunks after it instead of changing them. A boundary follows every byte where the Gear hash of the 64 bytes up to
+// it has its top bits clear, more of them before the average size and fewer after it (FastCDC's normalized
+// chunking), outside the minimum and maximum sizes.
+struct ContentChunks {
+    std::string path;
+    wc_HashType algorithm = HASH_TYPE_BLAKE3;
+    uint64_t fileSize = 0;
+    size_t digestSize = 0;
+    // End offset of every chunk in order, so chunk i covers [ends[i - 1], ends[i])
+    std::vector<uint64_t> ends;
+    // Every chunk digest back to back, digestSize bytes each
+    std::vector<byte> digests;
+    // Empty on success, otherwise why the file could not be chunked
+    std::string error;
+
+    [[nodiscard]] size_t chunkCount() const { return ends.size(); }
+    [[nodiscard]] uint64_t offset(size_t index) const { return index == 0 ? 0 : ends[index - 1]; }
+    [[nodiscard]] uint64_t length(size_t index) const { return ends[index] - offset(index); }
+    [[nodiscard]] std::span<const byte> digest(size_t index) const { return std::span(digests).subspan(index * digestSize, digestSize); }
+};
+
+// Split a file into content-defined chunks while reading it once, hashing each chunk with algorithm. The boundary
+// scan runs on the same buffers the hashers read, vectorized where the CPU allows. Returns chunks without digests if
+// cancelled.
+ContentChunks chunkFile(const std::string& filePath, wc_HashType algorithm, const ChunkingParameters& parameters, const HashOptions& options, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
+
+// Chunk every file on a work-stealing pool of jobs workers, one file per task. Results are in the order of filePaths
+std::vector<ContentChunks> chunkFiles(const std::vector<std::string>& filePaths, wc_HashType algorithm, const ChunkingParameters& parameters, const HashOptions& options, size_t jobs, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
+
+// Text form: a header line, "algorithm" and "average-size" lines, then for each file a "file SIZE CHUNKS PATH" line
+// followed by an "OFFSET LENGTH DIGEST" line per chunk
+void saveChunkIndex(std::ostream& output, const std::vector<ContentChunks>& files, const ChunkingParameters& parameters);
+
+struct ChunkSharing {
+    uint64_t bytes = 0;
+    // Bytes in chunks that also occur in another file
+    uint64_t sharedBytes = 0;
+    // Bytes in chunks that occurred earlier in the same file and no other
+    uint64_t repeatedBytes = 0;
+};
+
+struct SharedBytesReport {
+    // One entry per file, in the same order
+    std::vector<ChunkSharing> files;
+    uint64_t totalBytes = 0;
+    // Bytes left once every distinct chunk is stored a single time
+    uint64_t uniqueBytes = 0;
+};
+
+// How much of each file is made of chunks found elsewhere, matching chunks by digest and length
+SharedBytesReport compareChunks(const std::vector<ContentChunks>& files);
+
+#endif // CDC_H
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef CDC_IMPL_H
+#define CDC_IMPL_H
+
+// Internals shared by the content-defined chunker and its SIMD boundary scan. Like the BLAKE3 kernels, the scan is
+// built in its own file with flags for its instruction set, so everything here is in an anonymous namespace.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HASHER_HAVE_GEAR_X86
+#endif
+
+// Roll the Gear hash over data, starting from hash, until (hash & mask) == 0 after some byte. Returns how many bytes
+// were consumed, which is all of them if no byte ends a chunk, and leaves hash at its value after the last one.
+// Kernels only scan whole blocks of their lanes and leave the rest, so they may return less without a match.
+#ifdef HASHER_HAVE_GEAR_X86
+size_t gearScanAvx2(const uint8_t* data, size_t length, uint64_t& hash, uint64_t mask);
+#endif
+
+namespace
+{
+// The hash shifts one bit per byte, so it only depends on the last 64 bytes. A scan can start anywhere once it has
+// rolled over the 64 bytes before its start
+constexpr size_t GEAR_WINDOW = 64;
+
+// Random table indexed by byte, fixed so chunk boundaries never change between builds
+constexpr std::array<uint64_t, 256> GEAR_TABLE = []() {
+    std::array<uint64_t, 256> table{};
+    uint64_t state = 0x6a09e667f3bcc908; // splitmix64
+    for (uint64_t &entry : table)
+    {
+        state += 0x9e3779b97f4a7c15;
+        uint64_t value = state;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+        entry = value ^ (value >> 31);
+    }
+    return table;
+}();
+
+inline uint64_t gearRoll(const uint64_t hash, const uint8_t byte)
+{
+    return (hash << 1) + GEAR_TABLE[byte];
+}
+
+inline size_t gearScanPortable(const uint8_t* data, const size_t length, uint64_t& hash, const uint64_t mask)
+{
+    uint64_t value = hash;
+    for (size_t i = 0; i < length; i++)
+    {
+        value = gearRoll(value, data[i]);
+        if ((value & mask) == 0)
+        {
+            hash = value;
+            return i + 1;
+        }
+    }
+    hash = value;
+    return length;
+}
+} // namespace
+
+#endif // CDC_IMPL_H
\ No newline at end of file
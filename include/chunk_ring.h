@@ -0,0 +1,103 @@
+#ifndef CHUNK_RING_H
+#define CHUNK_RING_H
+
+#include "hash.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+// Fixed ring of chunks shared by one reading thread and a set of hashing threads. Each published chunk carries a
+// count of threads still reading it, and the reader only refills a slot once that count has dropped to zero. A ring
+// can be reset for the next file, keeping its chunks unless it needs more of them.
+class ChunkRing {
+    public:
+        struct Chunk {
+            std::span<const byte> data;
+            bool last = false;
+            std::atomic<size_t> readers = 0;
+        };
+
+        ChunkRing() = default;
+        ChunkRing(size_t slotCount, size_t consumerCount) { reset(slotCount, consumerCount); }
+        ChunkRing(const ChunkRing&) = delete;
+        ChunkRing& operator=(const ChunkRing&) = delete;
+
+        // Empty every slot, only allocating when there are more slots than ever before, and return whether it did.
+        // No thread may be using the ring
+        bool reset(size_t slotCount, size_t consumerCount)
+        {
+            const bool grow = slotCount > capacity;
+            if (grow)
+            {
+                chunks = std::make_unique<Chunk[]>(slotCount);
+                capacity = slotCount;
+            }
+            for (size_t i = 0; i < slotCount; i++)
+            {
+                chunks[i].data = {};
+                chunks[i].last = false;
+                chunks[i].readers.store(0);
+            }
+            slots = slotCount;
+            consumerTotal = consumerCount;
+            published.store(0);
+            return grow;
+        }
+
+        [[nodiscard]] size_t slotCount() const { return slots; }
+        [[nodiscard]] size_t consumers() const { return consumerTotal; }
+
+        // Wait until every consumer has released the slot that will hold the given chunk
+        Chunk& acquire(uint64_t sequence)
+        {
+            Chunk& chunk = slot(sequence);
+            for (size_t readers = chunk.readers.load(); readers != 0; readers = chunk.readers.load())
+            {
+                chunk.readers.wait(readers);
+            }
+            return chunk;
+        }
+
+        // Whether every consumer is done with whatever the slot for the given chunk last held
+        [[nodiscard]] bool isFree(uint64_t sequence) { return slot(sequence).readers.load() == 0; }
+
+        void publish(uint64_t sequence)
+        {
+            slot(sequence).readers.store(consumerTotal);
+            published.store(sequence + 1);
+            published.notify_all();
+        }
+
+        // Wait until the given chunk has been published
+        const Chunk& wait(uint64_t sequence)
+        {
+            for (uint64_t count = published.load(); count <= sequence; count = published.load())
+            {
+                published.wait(count);
+            }
+            return slot(sequence);
+        }
+
+        void release(uint64_t sequence)
+        {
+            Chunk& chunk = slot(sequence);
+            if (chunk.readers.fetch_sub(1) == 1)
+            {
+                chunk.readers.notify_one();
+            }
+        }
+
+    private:
+        std::unique_ptr<Chunk[]> chunks;
+        size_t capacity = 0;
+        size_t slots = 0;
+        size_t consumerTotal = 0;
+        std::atomic<uint64_t> published = 0;
+
+        Chunk& slot(uint64_t sequence) { return chunks[sequence % slots]; }
+};
+
+#endif // CHUNK_RING_H
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef CPU_H
+#define CPU_H
+
+// Instruction set extensions usable on this machine, meaning the CPU has them and the operating system saves their
+// registers. Detected once; setting HASHER_CPU_DISABLE to a comma separated list such as "avx512f,avx2" hides
+// features, so the fallback kernels can be exercised on any machine.
+struct CpuFeatures {
+    bool sse41 = false;
+    bool sse42 = false;
+    bool pclmul = false;
+    bool avx2 = false;
+    bool avx512f = false;
+};
+
+const CpuFeatures& cpuFeatures();
+
+#endif // CPU_H
\ No newline at end of file
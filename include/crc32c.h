@@ -0,0 +1,21 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t CRC32C_OUT_LEN = 4;
+
+// CRC-32C (Castagnoli), the checksum iSCSI, ext4 and many storage formats use. Where the CPU has SSE4.2 and PCLMULQDQ
+// it runs the crc32 instruction over three streams at once and folds them together with carry-less multiplies,
+// otherwise it looks up eight bytes at a time in tables. The digest is the CRC big endian, as it is usually printed.
+class Crc32c {
+    public:
+        void update(const uint8_t* input, size_t size);
+        void finalize(uint8_t* output) const;
+
+    private:
+        uint32_t crc = 0xffffffff;
+};
+
+#endif // CRC32C_H
\ No newline at end of file
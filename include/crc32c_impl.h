@@ -0,0 +1,25 @@
+#ifndef CRC32C_IMPL_H
+#define CRC32C_IMPL_H
+
+// Internals shared by the CRC-32C checksum and its SSE4.2 kernel, which is built in its own file with flags for its
+// instruction set, so everything here is in an anonymous namespace.
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HASHER_HAVE_CRC32C_X86
+#endif
+
+// Continue the CRC register crc, before the final inversion, over length bytes of data
+#ifdef HASHER_HAVE_CRC32C_X86
+uint32_t crc32cSse42(uint32_t crc, const uint8_t* data, size_t length);
+#endif
+
+namespace
+{
+// The Castagnoli polynomial, bit reversed since the CRC is computed least significant bit first
+constexpr uint32_t CRC32C_POLYNOMIAL = 0x82f63b78;
+} // namespace
+
+#endif // CRC32C_IMPL_H
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include "hash.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bytes read from each end of a file in the partial hash stage
+constexpr uint64_t DEFAULT_SAMPLE_SIZE = 16 * 1024;
+
+struct DedupOptions {
+    // Only used for the full hash, so a fast algorithm keeps the last stage disk bound
+    wc_HashType algorithm = HASH_TYPE_BLAKE3;
+    uint64_t sampleSize = DEFAULT_SAMPLE_SIZE;
+    // Smaller files are ignored. Empty files are all alike and free anyway
+    uint64_t minimumSize = 1;
+};
+
+struct DuplicateGroup {
+    uint64_t size = 0;
+    std::vector<byte> digest;
+    // Sorted, at least two
+    std::vector<std::string> paths;
+
+    // Space freed by keeping a single copy
+    [[nodiscard]] uint64_t reclaimableBytes() const { return size * (paths.size() - 1); }
+};
+
+struct DedupError {
+    std::string path;
+    std::string message;
+};
+
+struct DedupSummary {
+    // Most reclaimable space first
+    std::vector<DuplicateGroup> groups;
+    std::vector<DedupError> errors;
+    uint64_t files = 0;
+    // Extra names of a file already seen through another hard link, which are never reported as duplicates
+    uint64_t hardLinks = 0;
+    // Files left after each stage: sharing a size, then sharing a size and both ends as well
+    uint64_t sizeCandidates = 0;
+    uint64_t sampleCandidates = 0;
+    uint64_t bytesRead = 0;
+    uint64_t reclaimableBytes = 0;
+    double seconds = 0;
+    bool cancelled = false;
+};
+
+// Find files with identical content under the roots in three stages, each on a work-stealing pool of jobs workers.
+// Listing the tree groups files by size. Files sharing a size have their first and last sampleSize bytes hashed,
+// and only files still alike after that are hashed in full, so unique files cost a stat or a few KB of reads rather
+// than a full read. Files no bigger than both samples are read whole in the second stage and never read again.
+DedupSummary findDuplicates(const std::vector<std::string>& roots, const DedupOptions& dedupOptions, const HashOptions& options, size_t jobs, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
+
+#endif // DEDUP_H
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+// Text encodings for raw digests. Encoding is deferred until a digest is shown or written, so hashing itself never
+// builds strings.
+
+// Write data as lowercase hex to output, which must have room for 2 * data.size() characters
+void encodeHex(std::span<const unsigned char> data, char* output);
+std::string toHex(std::span<const unsigned char> data);
+// Read hex digits of either case into output, which must have room for hex.size() / 2 bytes. Returns false if the
+// text is not an even number of hex digits
+bool decodeHex(std::string_view hex, unsigned char* output);
+
+// Standard base64 alphabet with '=' padding
+constexpr size_t base64Length(size_t size) { return (size + 2) / 3 * 4; }
+void encodeBase64(std::span<const unsigned char> data, char* output);
+std::string toBase64(std::span<const unsigned char> data);
+
+#endif // ENCODING_H
\ No newline at end of file
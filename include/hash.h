@@ -8,8 +8,17 @@
 #define HAVE_BLAKE2
 #define HAVE_BLAKE2B
 
+#include "blake3.h"
+#include "crc32c.h"
+#include "xxh3.h"
+
 #include <wolfssl/wolfcrypt/blake2.h>
 #include <wolfssl/wolfcrypt/hash.h>
+#include <wolfssl/wolfcrypt/md5.h>
+#include <wolfssl/wolfcrypt/sha.h>
+#include <wolfssl/wolfcrypt/sha256.h>
+#include <wolfssl/wolfcrypt/sha512.h>
+#include <wolfssl/wolfcrypt/sha3.h>
 #include <stdexcept>
 #include <string>
 #include <iostream>
@@ -17,24 +26,472 @@
 #include <vector>
 #include <map>
 #include <future>
+#include <optional>
+#include <atomic>
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+
+constexpr size_t BUFFER_SIZE = 1024 * 1024; // 1 MB
+// Upper bound on wc_HashType values, so per-algorithm state fits in fixed arrays and 64-bit masks
+constexpr size_t MAX_ALGORITHMS = 32;
+
+// wc_HashType has no fixed underlying type, and its enumerators all fit in five bits, so only 0 to 31 are values of it;
+// casting anything larger is undefined. Algorithms implemented here rather than by wolfCrypt count down from 31, clear
+// of wolfCrypt's own
+constexpr int HASH_TYPE_LIMIT = 31;
+constexpr wc_HashType HASH_TYPE_BLAKE3 = static_cast<wc_HashType>(HASH_TYPE_LIMIT);
+// Non-cryptographic checksums, for catching accidental corruption at close to memory bandwidth
+constexpr wc_HashType HASH_TYPE_XXH3_64 = static_cast<wc_HashType>(HASH_TYPE_LIMIT - 1);
+constexpr wc_HashType HASH_TYPE_XXH3_128 = static_cast<wc_HashType>(HASH_TYPE_LIMIT - 2);
+constexpr wc_HashType HASH_TYPE_CRC32C = static_cast<wc_HashType>(HASH_TYPE_LIMIT - 3);
+static_assert(WC_HASH_TYPE_MAX < HASH_TYPE_CRC32C, "wolfCrypt hash types reach into the ones taken here");
+static_assert(HASH_TYPE_LIMIT < MAX_ALGORITHMS);
 
 class HashException;
+class DigestCache;
+class HashArena;
+
+// Throws a HashException; lets the header-only hashers below report wolfCrypt errors
+[[noreturn]] void throwHashException(const std::string& errorMessage, int code, wc_HashType algorithm);
+
+// State type and direct wolfCrypt entry points of each algorithm, so TypedHasher calls e.g. wc_Sha256Update itself
+// instead of going through the wc_HashUpdate switch. fields lists the members that make up the running hash, leaving
+// out pointers and settings that initialize fills in, so a state can be saved and later restored into a fresh one.
+// isValid checks a restored state for buffer lengths and indexes that the next update would write out of bounds with.
+template <wc_HashType Algorithm>
+struct HashTraits;
+
+template <>
+struct HashTraits<WC_HASH_TYPE_MD5> {
+    using State = wc_Md5;
+    static constexpr size_t DIGEST_SIZE = WC_MD5_DIGEST_SIZE;
+    static int initialize(State* state) { return wc_InitMd5(state); }
+    static int update(State* state, const byte* data, word32 size) { return wc_Md5Update(state, data, size); }
+    static int finalize(State* state, byte* digest) { return wc_Md5Final(state, digest); }
+    static void release(State* state) { wc_Md5Free(state); }
+    static auto fields(auto& state) { return std::tie(state.digest, state.buffer, state.buffLen, state.loLen, state.hiLen); }
+    static bool isValid(const State& state) { return state.buffLen < WC_MD5_BLOCK_SIZE; }
+};
+
+template <>
+struct HashTraits<WC_HASH_TYPE_SHA> {
+    using State = wc_Sha;
+    static constexpr size_t DIGEST_SIZE = WC_SHA_DIGEST_SIZE;
+    static int initialize(State* state) { return wc_InitSha(state); }
+    static int update(State* state, const byte* data, word32 size) { return wc_ShaUpdate(state, data, size); }
+    static int finalize(State* state, byte* digest) { return wc_ShaFinal(state, digest); }
+    static void release(State* state) { wc_ShaFree(state); }
+    static auto fields(auto& state) { return std::tie(state.digest, state.buffer, state.buffLen, state.loLen, state.hiLen); }
+    static bool isValid(const State& state) { return state.buffLen < WC_SHA_BLOCK_SIZE; }
+};
+
+template <>
+struct HashTraits<WC_HASH_TYPE_SHA256> {
+    using State = wc_Sha256;
+    static constexpr size_t DIGEST_SIZE = WC_SHA256_DIGEST_SIZE;
+    static int initialize(State* state) { return wc_InitSha256(state); }
+    static int update(State* state, const byte* data, word32 size) { return wc_Sha256Update(state, data, size); }
+    static int finalize(State* state, byte* digest) { return wc_Sha256Final(state, digest); }
+    static void release(State* state) { wc_Sha256Free(state); }
+    static auto fields(auto& state) { return std::tie(state.digest, state.buffer, state.buffLen, state.loLen, state.hiLen); }
+    static bool isValid(const State& state) { return state.buffLen < WC_SHA256_BLOCK_SIZE; }
+};
+
+template <>
+struct HashTraits<WC_HASH_TYPE_SHA512> {
+    using State = wc_Sha512;
+    static constexpr size_t DIGEST_SIZE = WC_SHA512_DIGEST_SIZE;
+    static int initialize(State* state) { return wc_InitSha512(state); }
+    static int update(State* state, const byte* data, word32 size) { return wc_Sha512Update(state, data, size); }
+    static int finalize(State* state, byte* digest) { return wc_Sha512Final(state, digest); }
+    static void release(State* state) { wc_Sha512Free(state); }
+    static auto fields(auto& state) { return std::tie(state.digest, state.buffer, state.buffLen, state.loLen, state.hiLen); }
+    static bool isValid(const State& state) { return state.buffLen < WC_SHA512_BLOCK_SIZE; }
+};
+
+template <>
+struct HashTraits<WC_HASH_TYPE_SHA3_256> {
+    using State = wc_Sha3;
+    static constexpr size_t DIGEST_SIZE = WC_SHA3_256_DIGEST_SIZE;
+    static int initialize(State* state) { return wc_InitSha3_256(state, nullptr, INVALID_DEVID); }
+    static int update(State* state, const byte* data, word32 size) { return wc_Sha3_256_Update(state, data, size); }
+    static int finalize(State* state, byte* digest) { return wc_Sha3_256_Final(state, digest); }
+    static void release(State* state) { wc_Sha3_256_Free(state); }
+    static auto fields(auto& state) { return std::tie(state.s, state.t, state.i); }
+    // i indexes the partial block, which holds count words of input
+    static bool isValid(const State& state) { return state.i < WC_SHA3_256_COUNT * 8; }
+};
+
+template <>
+struct HashTraits<WC_HASH_TYPE_SHA3_512> {
+    using State = wc_Sha3;
+    static constexpr size_t DIGEST_SIZE = WC_SHA3_512_DIGEST_SIZE;
+    static int initialize(State* state) { return wc_InitSha3_512(state, nullptr, INVALID_DEVID); }
+    static int update(State* state, const byte* data, word32 size) { return wc_Sha3_512_Update(state, data, size); }
+    static int finalize(State* state, byte* digest) { return wc_Sha3_512_Final(state, digest); }
+    static void release(State* state) { wc_Sha3_512_Free(state); }
+    static auto fields(auto& state) { return std::tie(state.s, state.t, state.i); }
+    // i indexes the partial block, which holds count words of input
+    static bool isValid(const State& state) { return state.i < WC_SHA3_512_COUNT * 8; }
+};
+
+template <>
+struct HashTraits<WC_HASH_TYPE_BLAKE2B> {
+    using State = Blake2b;
+    static constexpr size_t DIGEST_SIZE = 64;
+    static int initialize(State* state) { return wc_InitBlake2b(state, DIGEST_SIZE); }
+    static int update(State* state, const byte* data, word32 size) { return wc_Blake2bUpdate(state, data, size); }
+    static int finalize(State* state, byte* digest) { return wc_Blake2bFinal(state, digest, DIGEST_SIZE); }
+    static void release(State*) {}
+    // Plain data throughout, and its fields are packed so they cannot be bound one by one
+    static auto fields(auto& state) { return std::tie(state); }
+    static bool isValid(const State& state)
+    {
+        return state.S[0].buflen <= 2 * BLAKE2B_BLOCKBYTES && state.digestSz > 0 && state.digestSz <= BLAKE2B_OUTBYTES;
+    }
+};
+
+template <>
+struct HashTraits<HASH_TYPE_BLAKE3> {
+    using State = Blake3;
+    static constexpr size_t DIGEST_SIZE = BLAKE3_OUT_LEN;
+    static int initialize(State*) { return 0; }
+    static int update(State* state, const byte* data, word32 size) { state->update(data, size); return 0; }
+    static int finalize(State* state, byte* digest) { state->finalize(digest, DIGEST_SIZE); return 0; }
+    static void release(State*) {}
+    // Blake3 holds nothing but the running hash
+    static auto fields(auto& state) { return std::tie(state); }
+    static bool isValid(const State& state) { return state.isValid(); }
+};
+
+template <>
+struct HashTraits<HASH_TYPE_XXH3_64> {
+    using State = Xxh3;
+    static constexpr size_t DIGEST_SIZE = XXH3_64_OUT_LEN;
+    static int initialize(State*) { return 0; }
+    static int update(State* state, const byte* data, word32 size) { state->update(data, size); return 0; }
+    static int finalize(State* state, byte* digest) { state->finalize64(digest); return 0; }
+    static void release(State*) {}
+    static auto fields(auto& state) { return std::tie(state); }
+    static bool isValid(const State& state) { return state.isValid(); }
+};
+
+// The same running state as XXH3-64, finished into the wider digest
+template <>
+struct HashTraits<HASH_TYPE_XXH3_128> {
+    using State = Xxh3;
+    static constexpr size_t DIGEST_SIZE = XXH3_128_OUT_LEN;
+    static int initialize(State*) { return 0; }
+    static int update(State* state, const byte* data, word32 size) { state->update(data, size); return 0; }
+    static int finalize(State* state, byte* digest) { state->finalize128(digest); return 0; }
+    static void release(State*) {}
+    static auto fields(auto& state) { return std::tie(state); }
+    static bool isValid(const State& state) { return state.isValid(); }
+};
+
+template <>
+struct HashTraits<HASH_TYPE_CRC32C> {
+    using State = Crc32c;
+    static constexpr size_t DIGEST_SIZE = CRC32C_OUT_LEN;
+    static int initialize(State*) { return 0; }
+    static int update(State* state, const byte* data, word32 size) { state->update(data, size); return 0; }
+    static int finalize(State* state, byte* digest) { state->finalize(digest); return 0; }
+    static void release(State*) {}
+    static auto fields(auto& state) { return std::tie(state); }
+    static bool isValid(const State&) { return true; }
+};
+
+// Hasher for one algorithm fixed at compile time, holding only that algorithm's state and digest
+template <wc_HashType Algorithm>
+class TypedHasher {
+    using Traits = HashTraits<Algorithm>;
+
+    typename Traits::State state{};
+    std::array<byte, Traits::DIGEST_SIZE> digest{};
+    bool finalized = false;
+
+    public:
+        static constexpr wc_HashType ALGORITHM = Algorithm;
+        static constexpr size_t DIGEST_SIZE = Traits::DIGEST_SIZE;
+
+        TypedHasher()
+        {
+            if (const int ret = Traits::initialize(&state); ret != 0)
+            {
+                throwHashException("Failed to initialize hash!", ret, Algorithm);
+            }
+        }
+        TypedHasher(const TypedHasher&) = delete;
+        TypedHasher& operator=(const TypedHasher&) = delete;
+        ~TypedHasher() { Traits::release(&state); }
+
+        // Start over as if newly constructed, keeping the object so a hasher can be reused for the next file
+        void reset()
+        {
+            Traits::release(&state);
+            std::destroy_at(&state);
+            std::construct_at(&state);
+            digest = {};
+            finalized = false;
+            if (const int ret = Traits::initialize(&state); ret != 0)
+            {
+                throwHashException("Failed to initialize hash!", ret, Algorithm);
+            }
+        }
 
+        void updateWithBuffer(const byte* buffer, word32 bufferSize)
+        {
+            if (finalized)
+            {
+                throw std::logic_error("You cannot update a hash after it has been finalized!");
+            }
+            if (const int ret = Traits::update(&state, buffer, bufferSize); ret != 0)
+            {
+                throwHashException("Failed to update hash!", ret, Algorithm);
+            }
+        }
+
+        void finalize()
+        {
+            if (finalized)
+            {
+                throw std::logic_error("You cannot finalize a hash twice!");
+            }
+            finalized = true;
+            if (const int ret = Traits::finalize(&state, digest.data()); ret != 0)
+            {
+                throwHashException("Failed to store digest!", ret, Algorithm);
+            }
+        }
+
+        [[nodiscard]] std::span<const byte> getRawDigest() const
+        {
+            if (!finalized)
+            {
+                throw std::logic_error("You must finalize a hash to get the digest!");
+            }
+            return digest;
+        }
+
+        // Raw bytes of the running state, only meaningful to builds with the same wolfCrypt configuration and byte order
+        [[nodiscard]] std::vector<byte> saveState() const
+        {
+            if (finalized)
+            {
+                throw std::logic_error("You cannot save the state of a finalized hash!");
+            }
+            std::vector<byte> saved;
+            std::apply([&](const auto&... field) {
+                (saved.insert(saved.end(), reinterpret_cast<const byte*>(&field), reinterpret_cast<const byte*>(&field) + sizeof(field)), ...);
+            }, Traits::fields(state));
+            return saved;
+        }
+
+        // Continue from a state saveState returned, as if everything hashed before it had been passed in again. A state
+        // that could not have come from saveState is refused, leaving the hasher reset
+        void restoreState(std::span<const byte> saved)
+        {
+            if (finalized)
+            {
+                throw std::logic_error("You cannot restore the state of a finalized hash!");
+            }
+            std::apply([&](auto&... field) {
+                if ((sizeof(field) + ...) != saved.size())
+                {
+                    throw std::invalid_argument("Saved hash state does not fit this algorithm");
+                }
+                size_t offset = 0;
+                ((std::memcpy(&field, saved.data() + offset, sizeof(field)), offset += sizeof(field)), ...);
+            }, Traits::fields(state));
+            if (!Traits::isValid(state))
+            {
+                reset();
+                throw std::invalid_argument("Saved hash state is corrupt");
+            }
+        }
+};
+
+// Hasher for an algorithm chosen at runtime. Holds exactly one TypedHasher, so it is only as big as the largest
+// algorithm's state, and each call costs one dispatch on the alternative before going straight into wolfCrypt.
 class Hasher {
-    wc_HashAlg hash{};
-    Blake2b blake2bhash{};
-    wc_HashType algorithm;
-    std::vector<byte> digest;
-    bool finalized;
+    using Alternatives = std::variant<TypedHasher<WC_HASH_TYPE_MD5>, TypedHasher<WC_HASH_TYPE_SHA>,
+                                      TypedHasher<WC_HASH_TYPE_SHA256>, TypedHasher<WC_HASH_TYPE_SHA512>,
+                                      TypedHasher<WC_HASH_TYPE_SHA3_256>, TypedHasher<WC_HASH_TYPE_SHA3_512>,
+                                      TypedHasher<WC_HASH_TYPE_BLAKE2B>, TypedHasher<HASH_TYPE_BLAKE3>,
+                                      TypedHasher<HASH_TYPE_XXH3_64>, TypedHasher<HASH_TYPE_XXH3_128>,
+                                      TypedHasher<HASH_TYPE_CRC32C>>;
+
+    Alternatives hasher;
+
+    static Alternatives create(wc_HashType algorithm);
 
     public:
         explicit Hasher(wc_HashType algorithm);
+        void reset();
         void updateWithBuffer(const byte* buffer, word32 bufferSize);
         void finalize();
         [[nodiscard]] std::string getDigest() const;
-        ~Hasher();
+        [[nodiscard]] std::span<const byte> getRawDigest() const;
+        [[nodiscard]] wc_HashType getAlgorithm() const;
+        [[nodiscard]] size_t getDigestSize() const;
+        [[nodiscard]] std::vector<byte> saveState() const;
+        void restoreState(std::span<const byte> saved);
 };
 
+// Raw digests of one file keyed by algorithm, stored inline so a result never touches the heap. Digests are only
+// encoded as text when asked for, and iterate in ascending algorithm order like the map they replace.
+class DigestSet {
+    public:
+        struct Entry {
+            wc_HashType algorithm;
+            std::span<const byte> digest;
+        };
+
+        class Iterator {
+            const DigestSet* set;
+            size_t index;
+
+            public:
+                Iterator(const DigestSet* set, size_t index) : set(set), index(index) {}
+                Entry operator*() const { return set->entry(index); }
+                Iterator& operator++() { index++; return *this; }
+                bool operator==(const Iterator& other) const { return index == other.index; }
+        };
+
+        // Enough for every algorithm at once
+        static constexpr size_t MAX_ENTRIES = 16;
+        static constexpr size_t STORAGE_SIZE = 512;
+
+        // Add or replace the digest for an algorithm. Throws std::length_error once the inline storage is full
+        void set(wc_HashType algorithm, std::span<const byte> digest);
+        [[nodiscard]] bool contains(wc_HashType algorithm) const;
+        // Raw digest for an algorithm, throwing std::out_of_range if it is missing
+        [[nodiscard]] std::span<const byte> at(wc_HashType algorithm) const;
+        [[nodiscard]] std::string hex(wc_HashType algorithm) const;
+        [[nodiscard]] std::string base64(wc_HashType algorithm) const;
+        [[nodiscard]] size_t size() const { return count; }
+        [[nodiscard]] bool empty() const { return count == 0; }
+        [[nodiscard]] Iterator begin() const { return {this, 0}; }
+        [[nodiscard]] Iterator end() const { return {this, count}; }
+        // Hex digests in the form calculateHashes has always returned
+        [[nodiscard]] std::map<wc_HashType, std::string> toHexMap() const;
+        bool operator==(const DigestSet& other) const;
+
+    private:
+        struct Slot {
+            wc_HashType algorithm;
+            uint16_t offset;
+            uint16_t length;
+        };
+
+        std::array<Slot, MAX_ENTRIES> slots{};
+        std::array<byte, STORAGE_SIZE> storage{};
+        uint16_t count = 0;
+        uint16_t used = 0;
+
+        [[nodiscard]] Entry entry(size_t index) const;
+        [[nodiscard]] const Slot* find(wc_HashType algorithm) const;
+};
+
+enum class ReaderBackend {
+    Auto,    // Stream, the backend that survives files changing under it
+    Stream,  // std::ifstream into reusable buffers
+    // Zero-copy windows of a memory mapping, falling back to Stream for pipes and special files. Opt-in only: a file
+    // truncated by someone else while a window of it is hashed raises SIGBUS and ends the process
+    Mmap,
+    IoUring, // Linux io_uring with a read in flight per buffer, falling back to Auto where unavailable
+};
+
+struct AlgorithmProgress {
+    std::atomic<uint64_t> bytesHashed = 0;
+    // Time spent inside the algorithm's update calls
+    std::atomic<uint64_t> hashNanoseconds = 0;
+};
+
+// Live counters for a calculateHashes call. The hashing threads only ever add to them with relaxed atomics, so any
+// thread can read them while the call runs without slowing it down.
+struct HashProgress {
+    // Size of the file once it has been opened, 0 until then
+    std::atomic<uint64_t> totalBytes = 0;
+    std::atomic<uint64_t> bytesRead = 0;
+    // Time the reader spent blocked in reads, and time it spent waiting for the hashers to hand back a buffer
+    std::atomic<uint64_t> ioNanoseconds = 0;
+    std::atomic<uint64_t> stallNanoseconds = 0;
+    std::array<AlgorithmProgress, MAX_ALGORITHMS> algorithms;
+
+    AlgorithmProgress& algorithm(wc_HashType type) { return algorithms[static_cast<size_t>(type) % MAX_ALGORITHMS]; }
+    void reset();
+};
+
+// Where hashing a file stopped: each algorithm's state after the first offset bytes. Passed back in, hashing picks up
+// at offset, so a cancelled run resumes where it left off and a file that has only been appended to since a complete
+// run costs just a read of its new tail. Resuming throws std::runtime_error rather than giving a wrong digest when the
+// file is not the one the checkpoint was saved for, or when its start or the bytes just before offset have changed.
+struct HashCheckpoint {
+    struct Entry {
+        wc_HashType algorithm;
+        std::vector<byte> state;
+    };
+
+    uint64_t offset = 0;
+    std::vector<Entry> states;
+    // Whether offset reached the end of the file, as opposed to hashing being cancelled part way
+    bool complete = false;
+    // Absolute path, device and inode of the file, the last two 0 where the platform has none
+    std::string path;
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    // SHA-256 of up to CHECKPOINT_SAMPLE_SIZE bytes at the start of the file and as many just before offset
+    std::vector<byte> sample;
+
+    static constexpr size_t CHECKPOINT_SAMPLE_SIZE = 4096;
+
+    [[nodiscard]] const Entry* find(wc_HashType algorithm) const;
+    // Ends with a checksum of everything before it, so damaged checkpoints are refused by load
+    void save(std::ostream& output) const;
+    // Throws std::runtime_error if the data is not an intact checkpoint
+    static HashCheckpoint load(std::istream& input);
+};
+
+struct HashOptions {
+    // Hash each algorithm on its own thread, all fed from one shared ring of read buffers
+    bool pipelined = false;
+    // Number of read buffers in flight, letting a reader thread prefetch ahead of the hashers; 0 reads synchronously
+    size_t bufferCount = 4;
+    ReaderBackend reader = ReaderBackend::Auto;
+    // Bypass the page cache with O_DIRECT where the filesystem supports it, so huge batches do not evict everything
+    bool directIo = false;
+    // Back direct and io_uring read buffers with huge pages to cut TLB misses while hashing
+    bool hugePages = false;
+    // When hashing batches of small files, compute their SHA-256 digests together in SIMD lanes (see sha256_mb.h)
+    bool multiBuffer = true;
+    // Checked before a file is opened and updated once it has been hashed; not owned
+    DigestCache* cache = nullptr;
+    // Counters updated as the file is read and hashed; not owned
+    HashProgress* progress = nullptr;
+    // Resumed from when it holds a state for every algorithm and the file is at least offset bytes long, and
+    // overwritten with the state hashing stopped at, whether cancelled or finished; not owned
+    HashCheckpoint* checkpoint = nullptr;
+    // Hashers, buffers, readers and the read-ahead ring reused from earlier files on the same thread instead of
+    // allocated anew (see arena.h); not owned
+    HashArena* arena = nullptr;
+};
+
+std::vector<wc_HashType> supportedAlgorithms();
+std::string_view algorithmName(wc_HashType algorithm);
+std::optional<wc_HashType> algorithmFromName(std::string_view name);
+
+// Raw digests of every requested algorithm, or an empty set if cancelled
+DigestSet calculateDigests(const std::string& filePath, const std::vector<wc_HashType>& hashesToCalculate, const HashOptions& options, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
+// Hex encoded calculateDigests, for callers that want strings
 std::map<wc_HashType, std::string> calculateHashes(const std::string& filePath, const std::vector<wc_HashType>& hashesToCalculate, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
+std::map<wc_HashType, std::string> calculateHashes(const std::string& filePath, const std::vector<wc_HashType>& hashesToCalculate, const HashOptions& options, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
 
 #endif // HASH_H
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs labelled jobs oldest first on a fixed number of workers. Every job gets a cancellation flag of its own, which
+// the work passes on as the shouldCancel of the hashing calls, so dropping one job never disturbs the others and
+// nothing ever has to wait for a superseded job to wind down.
+class JobScheduler {
+    public:
+        using JobId = uint64_t;
+        using Work = std::function<void(const std::atomic<bool>& shouldCancel)>;
+
+        enum class JobState {
+            Queued,
+            Running,
+            Finished,
+            Failed,
+            Cancelled,
+        };
+
+        struct JobStatus {
+            JobId id = 0;
+            std::string label;
+            JobState state = JobState::Queued;
+            // What the work threw, for failed jobs
+            std::string error;
+        };
+
+        // onChange is called from the workers whenever a job starts or ends, so it has to be thread safe
+        explicit JobScheduler(size_t workerCount, std::function<void()> onChange = {});
+        JobScheduler(const JobScheduler&) = delete;
+        JobScheduler& operator=(const JobScheduler&) = delete;
+        ~JobScheduler();
+
+        JobId submit(std::string label, Work work);
+        // A queued job is dropped at once and never runs. A running one has its flag raised and is reported
+        // Cancelled once its work returns. Finished and unknown jobs are left alone
+        void cancel(JobId id);
+        void cancelAll();
+        // Forget a job that has ended, so it drops out of jobs(). Returns false if it is still queued or running
+        bool forget(JobId id);
+        // Cancel every job and wait for the running ones to return. Later submits are cancelled straight away
+        void shutdown();
+
+        [[nodiscard]] std::optional<JobStatus> status(JobId id) const;
+        // Every job not yet forgotten, in submission order
+        [[nodiscard]] std::vector<JobStatus> jobs() const;
+        [[nodiscard]] size_t workerCount() const { return workers.size(); }
+
+    private:
+        struct Job {
+            JobStatus status;
+            Work work;
+            std::atomic<bool> shouldCancel = false;
+        };
+
+        mutable std::mutex mutex;
+        std::condition_variable workAvailable;
+        // Jobs waiting for a worker, and every job not yet forgotten in submission order
+        std::deque<std::shared_ptr<Job>> queue;
+        std::vector<std::shared_ptr<Job>> all;
+        JobId nextId = 1;
+        bool stopping = false;
+        std::function<void()> onChange;
+        std::vector<std::jthread> workers;
+
+        void run();
+        void notifyChange() const;
+};
+
+#endif // JOBS_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef KNOWN_H
+#define KNOWN_H
+
+#include "hash.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+struct KnownBuildSummary {
+    uint64_t digests = 0;
+    // Repeated digests that were only stored once
+    uint64_t duplicates = 0;
+    // Lines without any digest on them
+    uint64_t skippedLines = 0;
+};
+
+// Read-only set of reference digests, such as an NSRL release, kept in a sorted index file that is memory mapped
+// rather than loaded. Digests are grouped by length, so one index can hold MD5, SHA-1, SHA-256 and SHA-512 sized
+// digests from any algorithm. Within a group a table indexed by the first 16 bits narrows a lookup to a small bucket,
+// which interpolation search on the next 8 bytes resolves in a probe or two, since digests are uniformly spread.
+class KnownHashes {
+    public:
+        explicit KnownHashes(const std::string& indexPath);
+        KnownHashes(const KnownHashes&) = delete;
+        KnownHashes& operator=(const KnownHashes&) = delete;
+        ~KnownHashes();
+
+        [[nodiscard]] bool contains(std::span<const byte> digest) const;
+        // Whether any digest of the set is known
+        [[nodiscard]] bool containsAny(const DigestSet& digests) const;
+        [[nodiscard]] uint64_t size() const;
+
+        // Write an index of every digest found in the text lists: sha256sum style lines, NSRL CSV rows or bare
+        // digests. Any run of 32, 40, 64 or 128 hex digits standing on its own counts as a digest
+        static KnownBuildSummary build(const std::vector<std::string>& listPaths, const std::string& indexPath);
+
+    private:
+        struct State;
+        std::unique_ptr<State> state;
+};
+
+#endif // KNOWN_H
\ No newline at end of file
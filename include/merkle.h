@@ -0,0 +1,63 @@
+#ifndef MERKLE_H
+#define MERKLE_H
+
+#include "hash.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+constexpr uint64_t DEFAULT_CHUNK_SIZE = 64 * 1024 * 1024; // 64 MB
+
+// Digests of the fixed-size chunks of one file plus a Merkle root over them. Chunk i covers bytes
+// [i * chunkSize, (i + 1) * chunkSize) and its digest is the plain digest of those bytes, so single chunks can be
+// checked with any other tool. Interior nodes hash 0x01 || left || right, with an odd node carried up a level as is,
+// and the root hashes 0x02 || file size || chunk size (both 64-bit little endian) || top node, which binds the chunk
+// layout into it. An empty file has a single empty chunk.
+struct ChunkManifest {
+    wc_HashType algorithm = WC_HASH_TYPE_SHA256;
+    uint64_t chunkSize = DEFAULT_CHUNK_SIZE;
+    uint64_t fileSize = 0;
+    size_t digestSize = 0;
+    // Every chunk digest back to back, digestSize bytes each
+    std::vector<byte> digests;
+    std::vector<byte> root;
+
+    [[nodiscard]] size_t chunkCount() const { return digestSize == 0 ? 0 : digests.size() / digestSize; }
+    [[nodiscard]] std::span<const byte> chunk(size_t index) const { return std::span(digests).subspan(index * digestSize, digestSize); }
+
+    // Text form: a header line, "algorithm", "chunk-size", "file-size" and "root" lines, then "INDEX DIGEST" per chunk
+    void save(std::ostream& output) const;
+    // Throws std::runtime_error if the text is not a well-formed manifest or its root does not match its chunks
+    static ChunkManifest load(std::istream& input);
+};
+
+struct ChunkVerification {
+    // Chunks whose content differs from the manifest, including chunks that were cut off or added by a size change
+    std::vector<size_t> changedChunks;
+    size_t checkedChunks = 0;
+    uint64_t checkedBytes = 0;
+    // The file is no longer the size the manifest was built for. Checking the whole file then always reports the
+    // affected chunks as well
+    bool sizeChanged = false;
+    // Set if shouldCancel stopped the check, leaving changedChunks empty
+    bool cancelled = false;
+
+    [[nodiscard]] bool ok() const { return changedChunks.empty() && !cancelled; }
+};
+
+// Root of the tree over the manifest's chunk digests
+std::vector<byte> merkleRoot(const ChunkManifest& manifest);
+
+// Hash every chunk of a file on a pool of jobs workers, each reading its own chunks, so even sequential algorithms
+// scale with the number of cores. Returns a manifest without chunks if cancelled.
+ChunkManifest buildChunkManifest(const std::string& filePath, wc_HashType algorithm, uint64_t chunkSize, const HashOptions& options, size_t jobs, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
+
+// Re-hash only the chunks overlapping [offset, offset + length) and compare them with the manifest. The default range
+// covers the whole file, reporting exactly which chunks changed
+ChunkVerification verifyChunkManifest(const std::string& filePath, const ChunkManifest& manifest, const HashOptions& options, size_t jobs, uint64_t offset = 0, uint64_t length = UINT64_MAX, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
+
+#endif // MERKLE_H
\ No newline at end of file
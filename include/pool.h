@@ -0,0 +1,58 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers that each own a deque of tasks. A worker runs its newest task first and, once its own deque
+// is empty, steals the oldest task of another worker, so work spawned deep in a directory tree spreads out without
+// every worker fighting over one shared queue.
+class WorkStealingPool {
+    public:
+        using Task = std::function<void()>;
+
+        explicit WorkStealingPool(size_t workerCount);
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+        ~WorkStealingPool();
+
+        // Queue a task. Tasks submitted from one of this pool's workers go to that worker's own deque
+        void submit(Task task);
+        // Block until every submitted task, including ones those tasks submitted, has run. Rethrows the first
+        // exception a task let escape
+        void wait();
+        [[nodiscard]] size_t workerCount() const { return queues.size(); }
+        // Which of this pool's workers is calling, or workerCount() for any other thread
+        [[nodiscard]] size_t currentWorkerIndex() const;
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::jthread> workers;
+        std::atomic<size_t> nextQueue = 0;
+        // Tasks sitting in a deque, and tasks either queued or still running
+        std::atomic<size_t> queued = 0;
+        std::atomic<size_t> pending = 0;
+
+        std::mutex stateMutex;
+        std::condition_variable workAvailable;
+        std::condition_variable allDone;
+        bool stopping = false;
+        std::exception_ptr failure;
+
+        bool take(size_t worker, Task& task);
+        void run(size_t worker);
+};
+
+#endif // POOL_H
\ No newline at end of file
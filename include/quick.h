@@ -0,0 +1,40 @@
+#ifndef QUICK_H
+#define QUICK_H
+
+#include "hash.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr size_t DEFAULT_QUICK_SAMPLES = 16;
+constexpr uint64_t DEFAULT_QUICK_SAMPLE_SIZE = 64 * 1024;
+
+struct QuickHashOptions {
+    // Evenly spaced blocks between the head and the tail
+    size_t samples = DEFAULT_QUICK_SAMPLES;
+    uint64_t sampleSize = DEFAULT_QUICK_SAMPLE_SIZE;
+};
+
+struct QuickHashResult {
+    // Sampled digests, which never equal the full-content digest of the file, even when covering all of it
+    DigestSet digests;
+    uint64_t fileSize = 0;
+    uint64_t sampledBytes = 0;
+    // The samples would have covered the file, so it was read whole and a differing byte anywhere changes the digest
+    bool complete = false;
+};
+
+// Byte ranges a quick hash reads from a file of fileSize bytes, as (offset, length) in ascending order: the first and
+// last sampleSize bytes plus samples blocks spread evenly between them, or the whole file if they would overlap
+std::vector<std::pair<uint64_t, uint64_t>> quickHashRanges(uint64_t fileSize, const QuickHashOptions& quickOptions);
+
+// Cheap identity check for huge files that hashes only the quickHashRanges of the file, read with positioned reads on
+// a pool of jobs workers. Ranges adding up to more than 64 MB are instead streamed through the hashers in order, so
+// memory use stays bounded however large the samples are. Each digest covers the tag "hasher-quick 1", then the file size, sample size and range count,
+// then every range's offset followed by its bytes, all sizes and offsets 64-bit little endian. Files differing only
+// outside the sampled ranges get the same digest. Returns an empty digest set if cancelled.
+QuickHashResult calculateQuickDigests(const std::string& filePath, const std::vector<wc_HashType>& hashesToCalculate, const QuickHashOptions& quickOptions, const HashOptions& options, size_t jobs, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
+
+#endif // QUICK_H
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef READER_H
+#define READER_H
+
+#include "hash.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+
+class HashArena;
+
+// Source of file data for calculateHashes. Data is read into numbered slots so several reads can be in flight at
+// once; everything is called from a single reading thread.
+class FileReader {
+    protected:
+        std::optional<uint64_t> fileSize;
+        bool atEnd = false;
+
+    public:
+        virtual ~FileReader() = default;
+        // Read the next part of the file into a slot. The data stays valid until the slot is released
+        virtual std::span<const byte> read(size_t slot) = 0;
+        // Called once every hasher is done with the data last read into a slot
+        virtual void release(size_t /*slot*/) {}
+        // Close the file but keep what the next file can use, such as buffers and io_uring rings, returning false if
+        // this reader cannot be opened again. Called when a reader opened with an arena is done
+        virtual bool closeForReuse() { return false; }
+        [[nodiscard]] bool finished() const { return atEnd; }
+        [[nodiscard]] std::optional<uint64_t> size() const { return fileSize; }
+};
+
+// Frees a reader, or parks it in the arena it was opened with so the next file on that arena can reopen it
+struct FileReaderDeleter {
+    HashArena* arena = nullptr;
+    void operator()(FileReader* reader) const;
+};
+using FileReaderPtr = std::unique_ptr<FileReader, FileReaderDeleter>;
+
+// Readers come from options.arena when it holds a closed one of the right kind
+FileReaderPtr openFileReader(const std::string& filePath, const HashOptions& options, size_t slotCount);
+// Reader over at most length bytes starting at offset, for hashing one part of a file. size() is the part of the range
+// the file actually holds. Always reads through mmap or a stream, whatever options asks for
+FileReaderPtr openFileRangeReader(const std::string& filePath, uint64_t offset, uint64_t length, const HashOptions& options, size_t slotCount = 1);
+
+#endif // READER_H
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef SHA256_MB_H
+#define SHA256_MB_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+constexpr size_t SHA256_MB_DIGEST_SIZE = 32;
+
+// Messages compressed side by side on this CPU: 8 with AVX2, otherwise 1, where wolfCrypt's own SHA-256 is the faster
+// choice
+size_t sha256MultiBufferLanes();
+
+// SHA-256 of many independent messages at once, each SIMD lane compressing a block of a different message. A lane
+// that reaches the end of its message is refilled with the next one, so short and long messages mix freely. Each
+// digest is the same bytes wc_Sha256Final gives for that message alone.
+void sha256MultiBuffer(std::span<const std::span<const uint8_t>> messages,
+                       std::span<std::array<uint8_t, SHA256_MB_DIGEST_SIZE>> digests);
+
+#endif // SHA256_MB_H
\ No newline at end of file
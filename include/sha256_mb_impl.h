@@ -0,0 +1,138 @@
+#ifndef SHA256_MB_IMPL_H
+#define SHA256_MB_IMPL_H
+
+// Internals shared by the multi-buffer SHA-256 engine and its SIMD kernels. Like the BLAKE3 kernels, each one is built
+// in its own file with flags for its instruction set, so everything here is in an anonymous namespace.
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HASHER_HAVE_SHA256_MB_X86
+#endif
+
+// Compress one 64-byte block per lane into the lanes' states. state holds word i of lane l at state[i * LANES + l],
+// so each word of every lane loads as one vector.
+#ifdef HASHER_HAVE_SHA256_MB_X86
+void sha256CompressAvx2(uint32_t state[8 * 8], const uint8_t* const blocks[8]);
+#endif
+
+namespace
+{
+constexpr size_t SHA256_BLOCK_LEN = 64;
+
+constexpr uint32_t SHA256_IV[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+constexpr uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+// Kernel shared by every instruction set. Ops supplies a vector of LANES 32-bit words, one per message, and loads the
+// sixteen big endian message words of every lane's block.
+template <typename Ops>
+inline void sha256CompressLanes(uint32_t* state, const uint8_t* const* blocks)
+{
+    using Vec = typename Ops::Vec;
+    constexpr size_t LANES = Ops::LANES;
+
+    Vec w[16];
+    Ops::loadMessage(blocks, w);
+
+    // Message word t, expanding the schedule in place once past the sixteen loaded words
+    auto word = [&](const size_t t) -> Vec {
+        if (t >= 16)
+        {
+            const Vec w15 = w[(t - 15) & 15];
+            const Vec w2 = w[(t - 2) & 15];
+            const Vec s0 = Ops::bitXor(Ops::bitXor(Ops::template rotr<7>(w15), Ops::template rotr<18>(w15)),
+                                       Ops::template shr<3>(w15));
+            const Vec s1 = Ops::bitXor(Ops::bitXor(Ops::template rotr<17>(w2), Ops::template rotr<19>(w2)),
+                                       Ops::template shr<10>(w2));
+            w[t & 15] = Ops::add(Ops::add(w[t & 15], s0), Ops::add(w[(t - 7) & 15], s1));
+        }
+        return w[t & 15];
+    };
+
+    // Rather than shifting all eight working variables every round, each round is passed them in rotated order and
+    // only writes the two that change
+    auto round = [&](const Vec a, const Vec b, const Vec c, Vec &d, const Vec e, const Vec f, const Vec g, Vec &h,
+                     const size_t t) {
+        const Vec sigma1 = Ops::bitXor(Ops::bitXor(Ops::template rotr<6>(e), Ops::template rotr<11>(e)),
+                                       Ops::template rotr<25>(e));
+        const Vec choose = Ops::bitXor(Ops::bitAnd(e, f), Ops::andNot(e, g));
+        const Vec t1 = Ops::add(Ops::add(Ops::add(h, sigma1), Ops::add(choose, Ops::set1(SHA256_K[t]))), word(t));
+        const Vec sigma0 = Ops::bitXor(Ops::bitXor(Ops::template rotr<2>(a), Ops::template rotr<13>(a)),
+                                       Ops::template rotr<22>(a));
+        const Vec majority = Ops::bitOr(Ops::bitAnd(a, b), Ops::bitAnd(c, Ops::bitOr(a, b)));
+        d = Ops::add(d, t1);
+        h = Ops::add(t1, Ops::add(sigma0, majority));
+    };
+
+    Vec a = Ops::load(state);
+    Vec b = Ops::load(state + LANES);
+    Vec c = Ops::load(state + 2 * LANES);
+    Vec d = Ops::load(state + 3 * LANES);
+    Vec e = Ops::load(state + 4 * LANES);
+    Vec f = Ops::load(state + 5 * LANES);
+    Vec g = Ops::load(state + 6 * LANES);
+    Vec h = Ops::load(state + 7 * LANES);
+    for (size_t t = 0; t < 64; t += 8)
+    {
+        round(a, b, c, d, e, f, g, h, t);
+        round(h, a, b, c, d, e, f, g, t + 1);
+        round(g, h, a, b, c, d, e, f, t + 2);
+        round(f, g, h, a, b, c, d, e, t + 3);
+        round(e, f, g, h, a, b, c, d, t + 4);
+        round(d, e, f, g, h, a, b, c, t + 5);
+        round(c, d, e, f, g, h, a, b, t + 6);
+        round(b, c, d, e, f, g, h, a, t + 7);
+    }
+
+    const Vec v[8] = {a, b, c, d, e, f, g, h};
+    for (size_t i = 0; i < 8; i++)
+    {
+        Ops::store(state + i * LANES, Ops::add(Ops::load(state + i * LANES), v[i]));
+    }
+}
+
+// A single lane of plain integers, for CPUs without a SIMD kernel
+struct Sha256Scalar
+{
+    using Vec = uint32_t;
+    static constexpr size_t LANES = 1;
+
+    static Vec load(const uint32_t* words) { return *words; }
+    static void store(uint32_t* words, const Vec value) { *words = value; }
+    static Vec set1(const uint32_t value) { return value; }
+    static Vec add(const Vec a, const Vec b) { return a + b; }
+    static Vec bitXor(const Vec a, const Vec b) { return a ^ b; }
+    static Vec bitAnd(const Vec a, const Vec b) { return a & b; }
+    static Vec bitOr(const Vec a, const Vec b) { return a | b; }
+    static Vec andNot(const Vec a, const Vec b) { return ~a & b; }
+    template <int Bits>
+    static Vec rotr(const Vec value) { return std::rotr(value, Bits); }
+    template <int Bits>
+    static Vec shr(const Vec value) { return value >> Bits; }
+
+    static void loadMessage(const uint8_t* const* blocks, Vec message[16])
+    {
+        const uint8_t* block = blocks[0];
+        for (size_t i = 0; i < 16; i++)
+        {
+            message[i] = uint32_t{block[4 * i]} << 24 | uint32_t{block[4 * i + 1]} << 16 |
+                         uint32_t{block[4 * i + 2]} << 8 | uint32_t{block[4 * i + 3]};
+        }
+    }
+};
+} // namespace
+
+#endif // SHA256_MB_IMPL_H
\ No newline at end of file
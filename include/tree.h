@@ -0,0 +1,56 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include "hash.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+class WorkStealingPool;
+
+// Files at least this big get a pool task of their own instead of joining a batch of small files
+constexpr uint64_t LARGE_FILE_SIZE = 64 * BUFFER_SIZE;
+
+struct FileHashResult {
+    std::string path;
+    uint64_t size = 0;
+    DigestSet digests;
+    // Empty on success, otherwise why the file (or a directory that could not be listed) was skipped
+    std::string error;
+};
+
+struct TreeSummary {
+    uint64_t files = 0;
+    uint64_t failed = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    // Times a worker's arena had nothing to reuse (see arena.h), which mostly happens on a worker's first files. It
+    // counts arena misses, not heap allocations: listing the tree and reporting results allocate regardless
+    uint64_t arenaMisses = 0;
+};
+
+// Hash every regular file under the given roots, which may be files or directories, on a work-stealing pool of
+// jobs workers. Directories are listed in parallel, small files are hashed in batches and large ones on their own.
+// onResult is called from the worker threads as each file finishes, so it has to do its own locking.
+TreeSummary hashTree(const std::vector<std::string>& roots, const std::vector<wc_HashType>& hashesToCalculate, const HashOptions& options, size_t jobs, const std::function<void(const FileHashResult&)>& onResult, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
+
+// What walkDirectoryTree calls back with. Calls come from the pool's workers, so each callback does its own locking
+struct DirectoryWalkCallbacks {
+    // The regular files of one directory, once it has been listed
+    std::function<void(std::span<const std::filesystem::directory_entry>)> onFiles;
+    // A directory that could not be listed, or only in part
+    std::function<void(const std::filesystem::path&, const std::error_code&)> onError;
+    // Checked before each directory is listed; once it returns true no more are
+    std::function<bool()> isCancelled;
+};
+
+// List directory and every directory under it on pool, each one as a task of its own. Symlinked directories are not
+// followed, which also keeps link cycles from walking forever. callbacks must outlive the walk, i.e. pool.wait().
+void walkDirectoryTree(WorkStealingPool& pool, const std::filesystem::path& directory, const DirectoryWalkCallbacks& callbacks);
+
+#endif // TREE_H
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "hash.h"
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// One line of a checksum manifest as written by sha256sum, sha512sum, b2sum and friends
+struct ChecksumEntry {
+    std::string path;
+    wc_HashType algorithm = WC_HASH_TYPE_SHA256;
+    std::vector<byte> digest;
+    // 1-based line in the manifest
+    size_t line = 0;
+};
+
+struct ChecksumManifest {
+    std::vector<ChecksumEntry> entries;
+    // Lines that are neither entries nor blank or comments
+    size_t malformedLines = 0;
+};
+
+// Parse "DIGEST  PATH" and "DIGEST *PATH" lines, including the backslash escaped form GNU tools use for names with
+// newlines, and BSD style "ALGORITHM (PATH) = DIGEST" lines. Untagged lines use algorithm if given, otherwise the
+// algorithm the manifest's name suggests (SHA256SUMS, release.b2 and the like), otherwise the one the digest length
+// suggests: MD5, SHA1, SHA256 or SHA512.
+ChecksumManifest parseChecksumManifest(std::istream& input, const std::string& manifestName, std::optional<wc_HashType> algorithm = std::nullopt);
+
+enum class ChecksumStatus {
+    Ok,
+    Failed,  // The digest differs, or the file could not be read
+    Missing, // There is no such file
+};
+
+struct ChecksumResult {
+    const ChecksumEntry* entry = nullptr;
+    ChecksumStatus status = ChecksumStatus::Ok;
+    // Why a file could not be read
+    std::string error;
+};
+
+struct VerifySummary {
+    uint64_t ok = 0;
+    uint64_t failed = 0;
+    uint64_t missing = 0;
+    // Set if stopOnFailure ended the run before every entry was checked
+    bool stopped = false;
+};
+
+// Check every entry on a work-stealing pool of jobs workers, hashing each file with only the algorithm its entry
+// names. Relative paths are resolved against baseDirectory, or the working directory if it is empty. onResult is
+// called from the worker threads as each file finishes, so it has to do its own locking. With stopOnFailure, the
+// first failed or missing file stops every worker and no further entries are started.
+VerifySummary verifyChecksums(const ChecksumManifest& manifest, const std::string& baseDirectory, const HashOptions& options, size_t jobs, bool stopOnFailure, const std::function<void(const ChecksumResult&)>& onResult, std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel = std::nullopt);
+
+#endif // VERIFY_H
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef XXH3_H
+#define XXH3_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t XXH3_64_OUT_LEN = 8;
+constexpr size_t XXH3_128_OUT_LEN = 16;
+
+// XXH3 from xxHash 0.8 with the default secret and seed, a fast non-cryptographic hash for checking data against
+// accidental damage, not tampering. One running state gives both the 64-bit and the 128-bit digest. Inputs over 240
+// bytes are folded 64 bytes at a time with the widest SIMD kernel the CPU supports (SSE2, AVX2 or AVX-512). Digests
+// are written big endian, as xxhsum prints them.
+class Xxh3 {
+    public:
+        Xxh3();
+        void update(const uint8_t* input, size_t size);
+        void finalize64(uint8_t* output) const;
+        void finalize128(uint8_t* output) const;
+        // Whether the buffered length and stripe position are ones update can leave, for a state restored from raw bytes
+        [[nodiscard]] bool isValid() const;
+
+    private:
+        // Inputs up to 240 bytes are hashed whole by other means, so nothing is folded until more than this is in
+        static constexpr size_t INTERNAL_BUFFER_SIZE = 256;
+
+        std::array<uint64_t, 8> acc;
+        std::array<uint8_t, INTERNAL_BUFFER_SIZE> buffer{};
+        // The last stripe folded, for a final stripe that reaches back before the buffered bytes
+        std::array<uint8_t, 64> previousStripe{};
+        uint64_t totalLength = 0;
+        uint32_t bufferLength = 0;
+        uint32_t stripeInBlock = 0;
+
+        void accumulate(const uint8_t* input, size_t stripes);
+        // Accumulators once the buffered bytes and the final stripe are folded in, for inputs over 240 bytes
+        [[nodiscard]] std::array<uint64_t, 8> finalAccumulators() const;
+};
+
+#endif // XXH3_H
\ No newline at end of file
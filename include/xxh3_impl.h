@@ -0,0 +1,153 @@
+#ifndef XXH3_IMPL_H
+#define XXH3_IMPL_H
+
+// Internals shared by the XXH3 hasher and its SIMD kernels. Like the BLAKE3 kernels, each one is built in its own
+// file with flags for its instruction set, so everything here is in an anonymous namespace.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HASHER_HAVE_XXH3_X86
+#endif
+
+// Fold stripes 64-byte stripes of input into the eight accumulators, the first one using the secret at stripe
+// stripeInBlock of its block. Every full block of stripes is followed by a scramble. Returns the stripe of the block
+// the next call starts at.
+#ifdef HASHER_HAVE_XXH3_X86
+size_t xxh3AccumulateSse2(uint64_t acc[8], const uint8_t* input, size_t stripes, size_t stripeInBlock);
+size_t xxh3AccumulateAvx2(uint64_t acc[8], const uint8_t* input, size_t stripes, size_t stripeInBlock);
+size_t xxh3AccumulateAvx512(uint64_t acc[8], const uint8_t* input, size_t stripes, size_t stripeInBlock);
+#endif
+
+namespace
+{
+constexpr size_t XXH3_STRIPE_LEN = 64;
+constexpr size_t XXH3_SECRET_SIZE = 192;
+// Each stripe of a block uses the secret 8 bytes further on, so a block is as many stripes as that allows
+constexpr size_t XXH3_STRIPES_PER_BLOCK = (XXH3_SECRET_SIZE - XXH3_STRIPE_LEN) / 8;
+constexpr size_t XXH3_SCRAMBLE_OFFSET = XXH3_SECRET_SIZE - XXH3_STRIPE_LEN;
+
+constexpr uint32_t XXH_PRIME32_1 = 0x9E3779B1;
+constexpr uint32_t XXH_PRIME32_2 = 0x85EBCA77;
+constexpr uint32_t XXH_PRIME32_3 = 0xC2B2AE3D;
+constexpr uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87;
+constexpr uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4F;
+constexpr uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9;
+constexpr uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63;
+constexpr uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5;
+
+// The default secret of xxHash, which every digest here is keyed with
+alignas(64) constexpr uint8_t XXH3_SECRET[XXH3_SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d,
+    0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0,
+    0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21, 0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0,
+    0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b,
+    0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac,
+    0xd8, 0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51,
+    0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83, 0x34,
+    0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb, 0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49,
+    0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8,
+    0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b,
+    0x40, 0x7e,
+};
+
+inline uint64_t xxh3Read64(const uint8_t* bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; i++)
+    {
+        value |= uint64_t{bytes[i]} << (8 * i);
+    }
+    return value;
+}
+
+inline void xxh3AccumulateStripe(uint64_t* acc, const uint8_t* input, const uint8_t* secret)
+{
+    for (size_t i = 0; i < 8; i++)
+    {
+        const uint64_t data = xxh3Read64(input + 8 * i);
+        const uint64_t key = data ^ xxh3Read64(secret + 8 * i);
+        acc[i ^ 1] += data;
+        acc[i] += (key & 0xffffffff) * (key >> 32);
+    }
+}
+
+inline void xxh3Scramble(uint64_t* acc, const uint8_t* secret)
+{
+    for (size_t i = 0; i < 8; i++)
+    {
+        uint64_t value = acc[i];
+        value ^= value >> 47;
+        value ^= xxh3Read64(secret + 8 * i);
+        acc[i] = value * XXH_PRIME32_1;
+    }
+}
+
+inline size_t xxh3AccumulatePortable(uint64_t* acc, const uint8_t* input, const size_t stripes, size_t stripeInBlock)
+{
+    for (size_t i = 0; i < stripes; i++)
+    {
+        xxh3AccumulateStripe(acc, input + i * XXH3_STRIPE_LEN, XXH3_SECRET + stripeInBlock * 8);
+        if (++stripeInBlock == XXH3_STRIPES_PER_BLOCK)
+        {
+            xxh3Scramble(acc, XXH3_SECRET + XXH3_SCRAMBLE_OFFSET);
+            stripeInBlock = 0;
+        }
+    }
+    return stripeInBlock;
+}
+
+// Kernel shared by every instruction set. Ops supplies a vector of LANES 64-bit accumulators and the few operations
+// a stripe needs, each of which works within 128-bit halves so the pairs of accumulators swapped stay together.
+template <typename Ops>
+inline size_t xxh3AccumulateVector(uint64_t* acc, const uint8_t* input, const size_t stripes, size_t stripeInBlock)
+{
+    constexpr size_t VECTORS = 8 / Ops::LANES;
+    constexpr size_t VECTOR_BYTES = Ops::LANES * 8;
+    typename Ops::Vec accumulators[VECTORS];
+    for (size_t v = 0; v < VECTORS; v++)
+    {
+        accumulators[v] = Ops::load(acc + v * Ops::LANES);
+    }
+
+    for (size_t i = 0; i < stripes; i++)
+    {
+        const uint8_t* stripe = input + i * XXH3_STRIPE_LEN;
+        const uint8_t* secret = XXH3_SECRET + stripeInBlock * 8;
+        for (size_t v = 0; v < VECTORS; v++)
+        {
+            const typename Ops::Vec data = Ops::load(stripe + v * VECTOR_BYTES);
+            const typename Ops::Vec key = Ops::bitXor(data, Ops::load(secret + v * VECTOR_BYTES));
+            // Low half of each keyed word times its high half, plus the data of the neighbouring lane
+            const typename Ops::Vec product = Ops::multiplyLow32(key, Ops::highHalves(key));
+            accumulators[v] = Ops::add(accumulators[v], Ops::add(product, Ops::swapPairs(data)));
+        }
+
+        if (++stripeInBlock == XXH3_STRIPES_PER_BLOCK)
+        {
+            const uint8_t* scrambleSecret = XXH3_SECRET + XXH3_SCRAMBLE_OFFSET;
+            const typename Ops::Vec prime = Ops::set1(XXH_PRIME32_1);
+            for (size_t v = 0; v < VECTORS; v++)
+            {
+                typename Ops::Vec value = Ops::bitXor(accumulators[v], Ops::shiftRight47(accumulators[v]));
+                value = Ops::bitXor(value, Ops::load(scrambleSecret + v * VECTOR_BYTES));
+                // A 64 by 32-bit multiply out of the two 32 by 32-bit halves
+                const typename Ops::Vec low = Ops::multiplyLow32(value, prime);
+                const typename Ops::Vec high = Ops::multiplyLow32(Ops::highHalves(value), prime);
+                accumulators[v] = Ops::add(low, Ops::shiftLeft32(high));
+            }
+            stripeInBlock = 0;
+        }
+    }
+
+    for (size_t v = 0; v < VECTORS; v++)
+    {
+        Ops::store(acc + v * Ops::LANES, accumulators[v]);
+    }
+    return stripeInBlock;
+}
+} // namespace
+
+#endif // XXH3_IMPL_H
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "allocation_count.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// In a translation unit of its own, so the compiler never sees a replaced operator delete inlined next to the
+// operator new it pairs with
+
+static std::atomic<uint64_t> allocations = 0;
+
+uint64_t heapAllocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(const std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(std::max<std::size_t>(size, 1)))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(const std::size_t size, const std::align_val_t alignment)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto align = static_cast<std::size_t>(alignment);
+#ifdef _MSC_VER
+    void *memory = _aligned_malloc(std::max<std::size_t>(size, 1), align);
+#else
+    // aligned_alloc wants a size that is a multiple of the alignment
+    void *memory = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align);
+#endif
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+#ifdef _MSC_VER
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void operator delete(void *memory, std::size_t, const std::align_val_t alignment) noexcept
+{
+    operator delete(memory, alignment);
+}
\ No newline at end of file
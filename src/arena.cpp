@@ -0,0 +1,131 @@
+#include "arena.h"
+#include "reader.h"
+
+#include <algorithm>
+
+double HashArena::Stats::missesPerFile() const
+{
+    return this->files > 0 ? static_cast<double>(this->misses) / static_cast<double>(this->files) : 0.0;
+}
+
+HashArena::Stats &HashArena::Stats::operator+=(const Stats &other)
+{
+    this->files += other.files;
+    this->misses += other.misses;
+    return *this;
+}
+
+HashArena::HashArena()
+{
+    // Room for every algorithm and reader up front, so handing them out and back never grows the lists
+    this->activeHashers.reserve(MAX_ALGORITHMS);
+    this->idleReaders.reserve(MAX_IDLE_READERS);
+}
+
+// Out of line, where FileReader is complete
+HashArena::~HashArena() = default;
+
+const std::vector<Hasher *> &HashArena::hashers(const std::span<const wc_HashType> algorithms)
+{
+    this->activeHashers.clear();
+    for (const wc_HashType algorithm : algorithms)
+    {
+        std::unique_ptr<Hasher> &hasher = this->idleHashers[static_cast<size_t>(algorithm) % MAX_ALGORITHMS];
+        // Asked for twice
+        if (hasher && std::ranges::find(this->activeHashers, hasher.get()) != this->activeHashers.end())
+        {
+            continue;
+        }
+        if (hasher)
+        {
+            hasher->reset();
+        }
+        else
+        {
+            hasher = std::make_unique<Hasher>(algorithm);
+            this->counters.misses++;
+        }
+        this->activeHashers.push_back(hasher.get());
+    }
+    return this->activeHashers;
+}
+
+std::span<byte> HashArena::readBuffer(const size_t slot)
+{
+    if (slot >= this->readBuffers.size())
+    {
+        this->readBuffers.resize(slot + 1);
+    }
+    std::unique_ptr<byte[]> &buffer = this->readBuffers[slot];
+    if (!buffer)
+    {
+        buffer = std::make_unique_for_overwrite<byte[]>(BUFFER_SIZE);
+        this->counters.misses++;
+    }
+    return {buffer.get(), BUFFER_SIZE};
+}
+
+std::vector<byte> &HashArena::fileBuffer(const size_t index, const size_t capacity)
+{
+    if (index >= this->fileBuffers.size())
+    {
+        this->fileBuffers.resize(index + 1);
+    }
+    std::vector<byte> &buffer = this->fileBuffers[index];
+    buffer.clear();
+    if (buffer.capacity() < capacity)
+    {
+        buffer.reserve(capacity);
+        this->counters.misses++;
+    }
+    return buffer;
+}
+
+ChunkRing &HashArena::chunkRing(const size_t slotCount, const size_t consumerCount)
+{
+    if (this->ring.reset(slotCount, consumerCount))
+    {
+        this->counters.misses++;
+    }
+    return this->ring;
+}
+
+std::vector<std::span<const uint8_t>> &HashArena::batchMessages()
+{
+    this->messages.clear();
+    return this->messages;
+}
+
+std::vector<std::array<uint8_t, SHA256_MB_DIGEST_SIZE>> &HashArena::batchDigests(const size_t count)
+{
+    if (count > this->digests.capacity())
+    {
+        this->counters.misses++;
+    }
+    this->digests.resize(count);
+    return this->digests;
+}
+
+std::unique_ptr<FileReader> HashArena::takeReader(const std::type_info &type)
+{
+    const auto match = std::ranges::find_if(this->idleReaders, [&](const std::unique_ptr<FileReader> &reader) {
+        return typeid(*reader) == type;
+    });
+    if (match == this->idleReaders.end())
+    {
+        this->counters.misses++;
+        return nullptr;
+    }
+    std::unique_ptr<FileReader> reader = std::move(*match);
+    this->idleReaders.erase(match);
+    return reader;
+}
+
+void HashArena::parkReader(std::unique_ptr<FileReader> reader)
+{
+    // Past the limit the reader is simply freed
+    if (this->idleReaders.size() < MAX_IDLE_READERS)
+    {
+        this->idleReaders.push_back(std::move(reader));
+    }
+}
\ No newline at end of file
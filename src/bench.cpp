@@ -0,0 +1,738 @@
+#include "allocation_count.h"
+#include "arena.h"
+#include "hash.h"
+#include "tree.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static constexpr std::string_view PROGRAM_NAME = "hasher-bench";
+static constexpr double MEGABYTE = 1024.0 * 1024.0;
+
+// Buffer sizes for the update micro-benchmarks and file sizes for the end-to-end ones
+static constexpr size_t MICRO_SIZES[] = {
+    4 * 1024, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024,
+};
+static constexpr uint64_t MACRO_SIZES[] = {
+    4 * 1024, 1024 * 1024, 64 * 1024 * 1024, 256 * 1024 * 1024, 1024 * 1024 * 1024,
+};
+// Directory of small files for the tree benchmarks
+static constexpr size_t SMALL_FILE_COUNT = 4096;
+static constexpr size_t SMALL_FILE_SIZE = 4 * 1024;
+
+struct Options
+{
+    bool micro = true;
+    bool macro = true;
+    std::vector<wc_HashType> algorithms;
+    double minTime = 0.5;
+    uint64_t maxFileSize = 256 * 1024 * 1024;
+    fs::path directory = fs::temp_directory_path() / "hasher-bench";
+    bool keepFiles = false;
+    ReaderBackend reader = ReaderBackend::Auto;
+    std::string outputPath;
+    std::string baselinePath;
+    double threshold = 10.0;
+};
+
+struct Result
+{
+    std::string name;
+    uint64_t bytes = 0;
+    uint64_t iterations = 0;
+    double seconds = 0;
+    double megabytesPerSecond = 0;
+};
+
+static void printUsage()
+{
+    std::cout << std::format("Usage: {} [OPTION]...\n", PROGRAM_NAME)
+              << "Benchmark the hashing engine and print the results as JSON.\n"
+                 "Micro-benchmarks time Hasher::updateWithBuffer per algorithm for buffers of 4 KB to 64 MB;\n"
+                 "macro-benchmarks time calculateHashes on generated files with a cold and a warm page cache,\n"
+                 "and hashTree on a directory of small files with and without multi-buffer SHA-256.\n"
+                 "Exits with status 1 if hashing those files again with a warmed arena allocates.\n"
+                 "\n"
+                 "      --micro               only run the micro-benchmarks\n"
+                 "      --macro               only run the macro-benchmarks\n"
+                 "  -a, --algorithm NAME      benchmark NAME; may be repeated (default: all)\n"
+                 "  -t, --min-time SECONDS    minimum time spent on each case (default: 0.5)\n"
+                 "      --max-file-size MB    largest generated file for macro-benchmarks (default: 256)\n"
+                 "      --dir DIR             where to generate files (default: a temporary directory)\n"
+                 "      --keep-files          leave the generated files behind for the next run\n"
+                 "      --reader BACKEND      reader for macro-benchmarks: auto, stream, mmap or io_uring\n"
+                 "  -o, --output FILE         write the JSON to FILE instead of standard output\n"
+                 "  -c, --compare FILE        compare against a baseline written by -o and flag regressions\n"
+                 "      --threshold PERCENT   slowdown counted as a regression (default: 10)\n"
+                 "  -h, --help                display this help and exit\n";
+}
+
+static std::optional<Options> parseArguments(const int argc, char *argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view argument = argv[i];
+
+        // Fetch the value of an option taking one, either "--opt value" or "--opt=value"
+        auto takeValue = [&](const std::string_view shortName,
+                             const std::string_view longName) -> std::optional<std::string> {
+            if (argument == shortName || argument == longName)
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::invalid_argument(std::format("option '{}' requires an argument", argument));
+                }
+                return argv[++i];
+            }
+            if (argument.starts_with(longName) && argument.size() > longName.size() &&
+                argument[longName.size()] == '=')
+            {
+                return std::string(argument.substr(longName.size() + 1));
+            }
+            return std::nullopt;
+        };
+
+        auto toNumber = [](const std::string &value, const std::string_view what) {
+            try
+            {
+                const double number = std::stod(value);
+                if (number >= 0)
+                {
+                    return number;
+                }
+            }
+            catch (const std::exception &)
+            {
+            }
+            throw std::invalid_argument(std::format("invalid {} '{}'", what, value));
+        };
+
+        if (argument == "-h" || argument == "--help")
+        {
+            printUsage();
+            return std::nullopt;
+        }
+        if (argument == "--micro")
+        {
+            options.macro = false;
+        }
+        else if (argument == "--macro")
+        {
+            options.micro = false;
+        }
+        else if (argument == "--keep-files")
+        {
+            options.keepFiles = true;
+        }
+        else if (const auto name = takeValue("-a", "--algorithm"))
+        {
+            const auto algorithm = algorithmFromName(*name);
+            if (!algorithm)
+            {
+                throw std::invalid_argument(std::format("unknown algorithm '{}'", *name));
+            }
+            options.algorithms.push_back(*algorithm);
+        }
+        else if (const auto minTime = takeValue("-t", "--min-time"))
+        {
+            options.minTime = toNumber(*minTime, "time");
+        }
+        else if (const auto maxFileSize = takeValue("--max-file-size", "--max-file-size"))
+        {
+            options.maxFileSize = static_cast<uint64_t>(toNumber(*maxFileSize, "size") * MEGABYTE);
+        }
+        else if (const auto directory = takeValue("--dir", "--dir"))
+        {
+            options.directory = *directory;
+        }
+        else if (const auto reader = takeValue("--reader", "--reader"))
+        {
+            if (*reader == "auto")
+            {
+                options.reader = ReaderBackend::Auto;
+            }
+            else if (*reader == "stream")
+            {
+                options.reader = ReaderBackend::Stream;
+            }
+            else if (*reader == "mmap")
+            {
+                options.reader = ReaderBackend::Mmap;
+            }
+            else if (*reader == "io_uring")
+            {
+                options.reader = ReaderBackend::IoUring;
+            }
+            else
+            {
+                throw std::invalid_argument(std::format("unknown reader '{}'", *reader));
+            }
+        }
+        else if (const auto output = takeValue("-o", "--output"))
+        {
+            options.outputPath = *output;
+        }
+        else if (const auto baseline = takeValue("-c", "--compare"))
+        {
+            options.baselinePath = *baseline;
+        }
+        else if (const auto threshold = takeValue("--threshold", "--threshold"))
+        {
+            options.threshold = toNumber(*threshold, "threshold");
+        }
+        else
+        {
+            throw std::invalid_argument(std::format("unrecognized argument '{}'", argument));
+        }
+    }
+
+    if (options.algorithms.empty())
+    {
+        options.algorithms = supportedAlgorithms();
+    }
+    return options;
+}
+
+static std::string formatSize(const uint64_t bytes)
+{
+    if (bytes >= 1024 * 1024 * 1024 && bytes % (1024 * 1024 * 1024) == 0)
+    {
+        return std::format("{}GB", bytes / (1024 * 1024 * 1024));
+    }
+    if (bytes >= 1024 * 1024 && bytes % (1024 * 1024) == 0)
+    {
+        return std::format("{}MB", bytes / (1024 * 1024));
+    }
+    if (bytes >= 1024 && bytes % 1024 == 0)
+    {
+        return std::format("{}KB", bytes / 1024);
+    }
+    return std::format("{}B", bytes);
+}
+
+static void fillRandom(std::vector<byte> &buffer, std::mt19937_64 &generator)
+{
+    for (size_t i = 0; i + sizeof(uint64_t) <= buffer.size(); i += sizeof(uint64_t))
+    {
+        const uint64_t value = generator();
+        std::copy_n(reinterpret_cast<const byte *>(&value), sizeof(value), buffer.data() + i);
+    }
+}
+
+// Evict a file from the page cache so the next read has to go to the device. Returns false where that is not
+// possible, in which case cold runs are skipped
+static bool dropFromPageCache(const fs::path &path)
+{
+#if (defined(__unix__) || defined(__APPLE__)) && defined(POSIX_FADV_DONTNEED)
+    const int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+    // Dirty pages cannot be dropped, so flush the freshly generated file first
+    fdatasync(descriptor);
+    const bool dropped = posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(descriptor);
+    return dropped;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+static std::vector<Result> runMicro(const Options &options)
+{
+    std::vector<Result> results;
+    std::mt19937_64 generator(42);
+
+    for (const size_t size : MICRO_SIZES)
+    {
+        std::vector<byte> buffer(size);
+        fillRandom(buffer, generator);
+
+        for (const wc_HashType algorithm : options.algorithms)
+        {
+            Hasher hasher(algorithm);
+            // One untimed update so lazy setup inside the algorithm does not count
+            hasher.updateWithBuffer(buffer.data(), static_cast<word32>(buffer.size()));
+
+            Result result;
+            result.name = std::format("micro/{}/{}", algorithmName(algorithm), formatSize(size));
+            const auto start = std::chrono::steady_clock::now();
+            do
+            {
+                hasher.updateWithBuffer(buffer.data(), static_cast<word32>(buffer.size()));
+                result.iterations++;
+                result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } while (result.seconds < options.minTime);
+            hasher.finalize();
+
+            result.bytes = result.iterations * size;
+            result.megabytesPerSecond = static_cast<double>(result.bytes) / MEGABYTE / result.seconds;
+            std::cerr << std::format("{:<32} {:>10.1f} MB/s", result.name, result.megabytesPerSecond) << std::endl;
+            results.push_back(result);
+        }
+    }
+    return results;
+}
+
+static fs::path generateFile(const Options &options, const uint64_t size)
+{
+    const fs::path path = options.directory / std::format("bench-{}.bin", formatSize(size));
+    std::error_code error;
+    if (fs::file_size(path, error) == size && !error)
+    {
+        return path;
+    }
+
+    std::cerr << std::format("Generating {}", path.string()) << std::endl;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    std::mt19937_64 generator(size);
+    std::vector<byte> block(std::min<uint64_t>(size, BUFFER_SIZE));
+    for (uint64_t written = 0; written < size; written += block.size())
+    {
+        fillRandom(block, generator);
+        file.write(reinterpret_cast<const char *>(block.data()),
+                   static_cast<std::streamsize>(std::min<uint64_t>(block.size(), size - written)));
+    }
+    if (!file)
+    {
+        throw std::runtime_error(std::format("Failed to write {}", path.string()));
+    }
+    return path;
+}
+
+static std::vector<Result> runMacro(const Options &options)
+{
+    struct Configuration
+    {
+        std::string_view name;
+        HashOptions hashOptions;
+    };
+    const Configuration configurations[] = {
+        {"sync", {.bufferCount = 0, .reader = options.reader}},
+        {"readahead", {.reader = options.reader}},
+        {"pipelined", {.pipelined = true, .reader = options.reader}},
+    };
+
+    fs::create_directories(options.directory);
+    std::vector<Result> results;
+
+    for (const uint64_t size : MACRO_SIZES)
+    {
+        if (size > options.maxFileSize)
+        {
+            continue;
+        }
+        const fs::path path = generateFile(options, size);
+
+        for (const bool cold : {true, false})
+        {
+            if (cold && !dropFromPageCache(path))
+            {
+                std::cerr << std::format("Cannot drop {} from the page cache, skipping cold runs", path.string())
+                          << std::endl;
+                continue;
+            }
+
+            for (const Configuration &configuration : configurations)
+            {
+                Result result;
+                result.name =
+                    std::format("macro/{}/{}/{}", configuration.name, formatSize(size), cold ? "cold" : "warm");
+
+                // Each run is timed on its own so cold runs can evict the file between them, and the median is kept
+                std::vector<double> runs;
+                double total = 0;
+                if (!cold)
+                {
+                    calculateHashes(path.string(), options.algorithms, configuration.hashOptions);
+                }
+                do
+                {
+                    if (cold)
+                    {
+                        dropFromPageCache(path);
+                    }
+                    const auto start = std::chrono::steady_clock::now();
+                    calculateHashes(path.string(), options.algorithms, configuration.hashOptions);
+                    runs.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                    total += runs.back();
+                } while (total < options.minTime || runs.size() < 3);
+
+                std::ranges::sort(runs);
+                result.iterations = runs.size();
+                result.seconds = runs[runs.size() / 2];
+                result.bytes = size;
+                result.megabytesPerSecond = static_cast<double>(size) / MEGABYTE / result.seconds;
+                std::cerr << std::format("{:<32} {:>10.1f} MB/s", result.name, result.megabytesPerSecond) << std::endl;
+                results.push_back(result);
+            }
+        }
+
+        if (!options.keepFiles)
+        {
+            std::error_code error;
+            fs::remove(path, error);
+        }
+    }
+    return results;
+}
+
+// Heap allocations per file of hashing the files again and again with one arena, counted after a first pass has
+// filled it. Every reader backend is tried, so one that still allocates per file shows up here
+static bool checkArenaSteadyState(const Options &options, const std::vector<std::string> &paths)
+{
+    struct Configuration
+    {
+        std::string_view name;
+        HashOptions hashOptions;
+    };
+    const Configuration configurations[] = {
+        {"stream", {.reader = ReaderBackend::Stream}},
+        {"mmap", {.reader = ReaderBackend::Mmap}},
+        {"io_uring", {.reader = ReaderBackend::IoUring}},
+        {"direct", {.directIo = true}},
+    };
+
+    bool allocationFree = true;
+    for (const Configuration &configuration : configurations)
+    {
+        HashArena arena;
+        HashOptions hashOptions = configuration.hashOptions;
+        hashOptions.arena = &arena;
+        for (const std::string &path : paths)
+        {
+            calculateDigests(path, options.algorithms, hashOptions);
+        }
+
+        const uint64_t before = heapAllocationCount();
+        for (const std::string &path : paths)
+        {
+            calculateDigests(path, options.algorithms, hashOptions);
+        }
+        const uint64_t allocations = heapAllocationCount() - before;
+        std::cerr << std::format("{:<32} {:>8.4f} heap allocations/file",
+                                 std::format("arena/steady/{}", configuration.name),
+                                 static_cast<double>(allocations) / static_cast<double>(paths.size()))
+                  << std::endl;
+        allocationFree = allocationFree && allocations == 0;
+    }
+    return allocationFree;
+}
+
+// Time hashTree over a directory of small files on a single worker, so the result is files hashed per second rather
+// than how many cores the machine has. Clears allocationFree if hashing with a warmed arena allocated
+static std::vector<Result> runSmallFiles(const Options &options, bool &allocationFree)
+{
+    const fs::path directory = options.directory / std::format("small-{}", formatSize(SMALL_FILE_SIZE));
+    fs::create_directories(directory);
+    std::mt19937_64 generator(SMALL_FILE_COUNT);
+    std::vector<byte> contents(SMALL_FILE_SIZE);
+    for (size_t i = 0; i < SMALL_FILE_COUNT; i++)
+    {
+        const fs::path path = directory / std::format("{}.bin", i);
+        std::error_code error;
+        if (fs::file_size(path, error) == SMALL_FILE_SIZE && !error)
+        {
+            continue;
+        }
+        fillRandom(contents, generator);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(contents.data()), static_cast<std::streamsize>(contents.size()));
+        if (!file)
+        {
+            throw std::runtime_error(std::format("Failed to write {}", path.string()));
+        }
+    }
+
+    std::vector<Result> results;
+    for (const bool multiBuffer : {false, true})
+    {
+        const HashOptions hashOptions{.reader = options.reader, .multiBuffer = multiBuffer};
+        uint64_t arenaMisses = 0;
+        uint64_t allocations = 0;
+        auto run = [&]() {
+            const uint64_t before = heapAllocationCount();
+            arenaMisses =
+                hashTree({directory.string()}, options.algorithms, hashOptions, 1, [](const FileHashResult &) {})
+                    .arenaMisses;
+            allocations = heapAllocationCount() - before;
+        };
+
+        Result result;
+        result.name = std::format("macro/tree/{}/{}x{}", multiBuffer ? "multi-buffer" : "one-at-a-time",
+                                  SMALL_FILE_COUNT, formatSize(SMALL_FILE_SIZE));
+        std::vector<double> runs;
+        double total = 0;
+        run();
+        do
+        {
+            const auto start = std::chrono::steady_clock::now();
+            run();
+            runs.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            total += runs.back();
+        } while (total < options.minTime || runs.size() < 3);
+
+        std::ranges::sort(runs);
+        result.iterations = runs.size();
+        result.seconds = runs[runs.size() / 2];
+        result.bytes = SMALL_FILE_COUNT * SMALL_FILE_SIZE;
+        result.megabytesPerSecond = static_cast<double>(result.bytes) / MEGABYTE / result.seconds;
+        // Each run starts with an empty arena, so misses come from the worker's first files. Heap allocations also
+        // include listing the directory and reporting every result, which no arena covers
+        std::cerr << std::format("{:<32} {:>10.1f} MB/s {:>10.0f} files/s {:>8.4f} arena misses/file {:>8.2f} heap "
+                                 "allocations/file",
+                                 result.name, result.megabytesPerSecond, SMALL_FILE_COUNT / result.seconds,
+                                 static_cast<double>(arenaMisses) / SMALL_FILE_COUNT,
+                                 static_cast<double>(allocations) / SMALL_FILE_COUNT)
+                  << std::endl;
+        results.push_back(result);
+    }
+
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < SMALL_FILE_COUNT; i++)
+    {
+        paths.push_back((directory / std::format("{}.bin", i)).string());
+    }
+    allocationFree = checkArenaSteadyState(options, paths);
+
+    if (!options.keepFiles)
+    {
+        std::error_code error;
+        fs::remove_all(directory, error);
+    }
+    return results;
+}
+
+static std::string escapeJson(const std::string_view text)
+{
+    std::string escaped;
+    for (const char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+static std::string toJson(const std::vector<Result> &results)
+{
+    std::string json = "{\n";
+    json += std::format("  \"buffer_size\": {},\n", BUFFER_SIZE);
+    json += std::format("  \"hardware_threads\": {},\n", std::thread::hardware_concurrency());
+    json += "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result &result = results[i];
+        json += std::format("    {{\"name\": \"{}\", \"bytes\": {}, \"iterations\": {}, \"seconds\": {:.6f}, "
+                            "\"mb_per_second\": {:.3f}}}{}\n",
+                            escapeJson(result.name), result.bytes, result.iterations, result.seconds,
+                            result.megabytesPerSecond, i + 1 < results.size() ? "," : "");
+    }
+    json += "  ]\n}\n";
+    return json;
+}
+
+// Pull name and throughput out of every result object in a baseline. Only understands what toJson writes, give or
+// take whitespace and key order, which is all a baseline ever is
+static std::map<std::string, double> readBaseline(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error(std::format("Cannot open baseline {}", path));
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const std::string json = contents.str();
+
+    auto findValue = [&](const std::string_view object, const std::string_view key) -> std::optional<std::string> {
+        const size_t keyStart = object.find(std::format("\"{}\"", key));
+        if (keyStart == std::string_view::npos)
+        {
+            return std::nullopt;
+        }
+        size_t valueStart = object.find(':', keyStart);
+        if (valueStart == std::string_view::npos)
+        {
+            return std::nullopt;
+        }
+        valueStart = object.find_first_not_of(" \t\r\n", valueStart + 1);
+        if (valueStart == std::string_view::npos)
+        {
+            return std::nullopt;
+        }
+        if (object[valueStart] == '"')
+        {
+            const size_t valueEnd = object.find('"', valueStart + 1);
+            return std::string(object.substr(valueStart + 1, valueEnd - valueStart - 1));
+        }
+        const size_t valueEnd = object.find_first_of(",}\r\n ", valueStart);
+        return std::string(object.substr(valueStart, valueEnd - valueStart));
+    };
+
+    std::map<std::string, double> baseline;
+    const size_t resultsStart = json.find("\"results\"");
+    for (size_t start = json.find('{', resultsStart); resultsStart != std::string::npos && start != std::string::npos;
+         start = json.find('{', start + 1))
+    {
+        const size_t end = json.find('}', start);
+        if (end == std::string::npos)
+        {
+            break;
+        }
+        const std::string_view object(json.data() + start, end - start + 1);
+        const auto name = findValue(object, "name");
+        const auto speed = findValue(object, "mb_per_second");
+        if (name && speed)
+        {
+            try
+            {
+                baseline[*name] = std::stod(*speed);
+            }
+            catch (const std::exception &)
+            {
+                // Skip malformed entries rather than failing the whole comparison
+            }
+        }
+    }
+    return baseline;
+}
+
+// Print every case next to its baseline and return how many got slower by more than the threshold
+static size_t compare(const std::vector<Result> &results, const std::map<std::string, double> &baseline,
+                      const double threshold)
+{
+    size_t regressions = 0;
+    std::cerr << std::format("\n{:<32} {:>12} {:>12} {:>9}", "case", "baseline", "current", "change") << std::endl;
+    for (const Result &result : results)
+    {
+        const auto entry = baseline.find(result.name);
+        if (entry == baseline.end() || entry->second <= 0)
+        {
+            std::cerr << std::format("{:<32} {:>12} {:>12.1f} {:>9}", result.name, "-", result.megabytesPerSecond,
+                                     "new")
+                      << std::endl;
+            continue;
+        }
+
+        const double change = (result.megabytesPerSecond - entry->second) / entry->second * 100;
+        const bool regressed = change < -threshold;
+        regressions += regressed ? 1 : 0;
+        std::cerr << std::format("{:<32} {:>12.1f} {:>12.1f} {:>8.1f}%{}", result.name, entry->second,
+                                 result.megabytesPerSecond, change, regressed ? "  REGRESSION" : "")
+                  << std::endl;
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+    std::optional<Options> parsed;
+    try
+    {
+        parsed = parseArguments(argc, argv);
+    }
+    catch (const std::invalid_argument &exception)
+    {
+        std::cerr << std::format("{}: {}\nTry '{} --help' for more information.", PROGRAM_NAME, exception.what(),
+                                 PROGRAM_NAME)
+                  << std::endl;
+        return 2;
+    }
+    if (!parsed)
+    {
+        return 0;
+    }
+    const Options &options = *parsed;
+
+    try
+    {
+        // Read the baseline first so a typo in its path does not cost a whole run
+        std::map<std::string, double> baseline;
+        if (!options.baselinePath.empty())
+        {
+            baseline = readBaseline(options.baselinePath);
+        }
+
+        std::vector<Result> results;
+        bool allocationFree = true;
+        if (options.micro)
+        {
+            results = runMicro(options);
+        }
+        if (options.macro)
+        {
+            const std::vector<Result> macro = runMacro(options);
+            results.insert(results.end(), macro.begin(), macro.end());
+            const std::vector<Result> tree = runSmallFiles(options, allocationFree);
+            results.insert(results.end(), tree.begin(), tree.end());
+        }
+
+        const std::string json = toJson(results);
+        if (options.outputPath.empty())
+        {
+            std::cout << json << std::flush;
+        }
+        else
+        {
+            std::ofstream output(options.outputPath, std::ios::binary | std::ios::trunc);
+            output << json;
+            if (!output)
+            {
+                throw std::runtime_error(std::format("Failed to write {}", options.outputPath));
+            }
+        }
+
+        if (!options.baselinePath.empty())
+        {
+            const size_t regressions = compare(results, baseline, options.threshold);
+            if (regressions > 0)
+            {
+                std::cerr << std::format("{}: {} regression(s) beyond {}%", PROGRAM_NAME, regressions,
+                                         options.threshold)
+                          << std::endl;
+                return 1;
+            }
+        }
+
+        if (!allocationFree)
+        {
+            std::cerr << std::format("{}: hashing allocated after warm-up", PROGRAM_NAME) << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::exception &exception)
+    {
+        std::cerr << std::format("{}: {}", PROGRAM_NAME, exception.what()) << std::endl;
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,538 @@
+#include "blake3.h"
+#include "blake3_impl.h"
+#include "cpu.h"
+#include "pool.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+// Largest SIMD degree of any kernel, which bounds how many chaining values a subtree is reduced to at once
+constexpr size_t MAX_SIMD_DEGREE = 16;
+// Smallest share of an update worth handing to another thread
+constexpr size_t MIN_PARALLEL_PIECE = 128 * 1024;
+
+// The portable compression function, used for single blocks and whatever the SIMD kernels leave over
+void compress(const uint32_t cv[8], const uint8_t block[BLAKE3_BLOCK_LEN], const uint8_t blockLength,
+              const uint64_t counter, const uint8_t flags, uint32_t out[16])
+{
+    uint32_t message[16];
+    for (size_t i = 0; i < 16; i++)
+    {
+        message[i] = loadLittleEndian(block + i * 4);
+    }
+
+    uint32_t v[16] = {cv[0],        cv[1],        cv[2],        cv[3],
+                      cv[4],        cv[5],        cv[6],        cv[7],
+                      BLAKE3_IV[0], BLAKE3_IV[1], BLAKE3_IV[2], BLAKE3_IV[3],
+                      static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), blockLength, flags};
+
+    auto g = [&](const size_t a, const size_t b, const size_t c, const size_t d, const uint32_t x, const uint32_t y) {
+        v[a] = v[a] + v[b] + x;
+        v[d] = std::rotr(v[d] ^ v[a], 16);
+        v[c] = v[c] + v[d];
+        v[b] = std::rotr(v[b] ^ v[c], 12);
+        v[a] = v[a] + v[b] + y;
+        v[d] = std::rotr(v[d] ^ v[a], 8);
+        v[c] = v[c] + v[d];
+        v[b] = std::rotr(v[b] ^ v[c], 7);
+    };
+    for (const auto &schedule : BLAKE3_SCHEDULE)
+    {
+        g(0, 4, 8, 12, message[schedule[0]], message[schedule[1]]);
+        g(1, 5, 9, 13, message[schedule[2]], message[schedule[3]]);
+        g(2, 6, 10, 14, message[schedule[4]], message[schedule[5]]);
+        g(3, 7, 11, 15, message[schedule[6]], message[schedule[7]]);
+        g(0, 5, 10, 15, message[schedule[8]], message[schedule[9]]);
+        g(1, 6, 11, 12, message[schedule[10]], message[schedule[11]]);
+        g(2, 7, 8, 13, message[schedule[12]], message[schedule[13]]);
+        g(3, 4, 9, 14, message[schedule[14]], message[schedule[15]]);
+    }
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        out[i] = v[i] ^ v[i + 8];
+        out[i + 8] = v[i + 8] ^ cv[i];
+    }
+}
+
+void compressInPlace(uint32_t cv[8], const uint8_t block[BLAKE3_BLOCK_LEN], const uint8_t blockLength,
+                     const uint64_t counter, const uint8_t flags)
+{
+    uint32_t out[16];
+    compress(cv, block, blockLength, counter, flags, out);
+    std::copy_n(out, 8, cv);
+}
+
+void storeCv(const uint32_t cv[8], uint8_t out[BLAKE3_OUT_LEN])
+{
+    for (size_t i = 0; i < 8; i++)
+    {
+        storeLittleEndian(out + i * 4, cv[i]);
+    }
+}
+
+// Everything needed to compress the last block of a node, either into a chaining value or, for the root, into output
+struct Output
+{
+    std::array<uint32_t, 8> cv;
+    std::array<uint8_t, BLAKE3_BLOCK_LEN> block;
+    uint8_t blockLength;
+    uint64_t counter;
+    uint8_t flags;
+
+    void chainingValue(uint8_t out[BLAKE3_OUT_LEN]) const
+    {
+        std::array<uint32_t, 8> result = this->cv;
+        compressInPlace(result.data(), this->block.data(), this->blockLength, this->counter, this->flags);
+        storeCv(result.data(), out);
+    }
+
+    void rootBytes(uint8_t *out, size_t size) const
+    {
+        for (uint64_t outputBlock = 0; size > 0; outputBlock++)
+        {
+            uint32_t words[16];
+            compress(this->cv.data(), this->block.data(), this->blockLength, outputBlock, this->flags | ROOT, words);
+            uint8_t bytes[BLAKE3_BLOCK_LEN];
+            for (size_t i = 0; i < 16; i++)
+            {
+                storeLittleEndian(bytes + i * 4, words[i]);
+            }
+            const size_t take = std::min(size, sizeof(bytes));
+            std::memcpy(out, bytes, take);
+            out += take;
+            size -= take;
+        }
+    }
+};
+
+Output parentOutput(const uint8_t block[BLAKE3_BLOCK_LEN])
+{
+    Output output{};
+    std::copy_n(BLAKE3_IV, 8, output.cv.begin());
+    std::memcpy(output.block.data(), block, BLAKE3_BLOCK_LEN);
+    output.blockLength = BLAKE3_BLOCK_LEN;
+    output.flags = PARENT;
+    return output;
+}
+
+uint8_t startFlag(const Blake3::ChunkState &chunk)
+{
+    return chunk.blocksCompressed == 0 ? CHUNK_START : 0;
+}
+
+Blake3::ChunkState newChunk(const uint64_t counter)
+{
+    Blake3::ChunkState chunk;
+    std::copy_n(BLAKE3_IV, 8, chunk.cv.begin());
+    chunk.counter = counter;
+    return chunk;
+}
+
+size_t fillBuffer(Blake3::ChunkState &chunk, const uint8_t *input, const size_t size)
+{
+    const size_t take = std::min(chunk.buffer.size() - chunk.bufferLength, size);
+    std::memcpy(chunk.buffer.data() + chunk.bufferLength, input, take);
+    chunk.bufferLength += static_cast<uint8_t>(take);
+    return take;
+}
+
+// Add input to a chunk, which must not overflow it. The last block is always kept back in the buffer, since only
+// finalizing the chunk knows whether it needs the CHUNK_END flag
+void updateChunk(Blake3::ChunkState &chunk, const uint8_t *input, size_t size)
+{
+    if (chunk.bufferLength > 0)
+    {
+        const size_t take = fillBuffer(chunk, input, size);
+        input += take;
+        size -= take;
+        if (size > 0)
+        {
+            compressInPlace(chunk.cv.data(), chunk.buffer.data(), BLAKE3_BLOCK_LEN, chunk.counter, startFlag(chunk));
+            chunk.blocksCompressed++;
+            chunk.bufferLength = 0;
+            chunk.buffer.fill(0);
+        }
+    }
+
+    while (size > BLAKE3_BLOCK_LEN)
+    {
+        compressInPlace(chunk.cv.data(), input, BLAKE3_BLOCK_LEN, chunk.counter, startFlag(chunk));
+        chunk.blocksCompressed++;
+        input += BLAKE3_BLOCK_LEN;
+        size -= BLAKE3_BLOCK_LEN;
+    }
+
+    fillBuffer(chunk, input, size);
+}
+
+Output chunkOutput(const Blake3::ChunkState &chunk)
+{
+    return {chunk.cv, chunk.buffer, chunk.bufferLength, chunk.counter,
+            static_cast<uint8_t>(startFlag(chunk) | CHUNK_END)};
+}
+
+size_t simdDegree()
+{
+#ifdef HASHER_HAVE_BLAKE3_X86
+    const CpuFeatures &cpu = cpuFeatures();
+    if (cpu.avx512f)
+    {
+        return 16;
+    }
+    if (cpu.avx2)
+    {
+        return 8;
+    }
+    if (cpu.sse41)
+    {
+        return 4;
+    }
+#endif
+    return 1;
+}
+
+// Hash evenly spaced inputs with the widest kernels available, finishing any remainder with the portable code
+void hashMany(const uint8_t *input, const size_t count, const size_t stride, const size_t blocks,
+              const uint64_t counter, const bool incrementCounter, const uint8_t flags, const uint8_t flagsStart,
+              const uint8_t flagsEnd, uint8_t *out)
+{
+    size_t done = 0;
+
+#ifdef HASHER_HAVE_BLAKE3_X86
+    const CpuFeatures &cpu = cpuFeatures();
+    auto run = [&](const auto kernel) {
+        done += kernel(input + done * stride, count - done, stride, blocks, BLAKE3_IV,
+                       counter + (incrementCounter ? done : 0), incrementCounter, flags, flagsStart, flagsEnd,
+                       out + done * BLAKE3_OUT_LEN);
+    };
+    if (cpu.avx512f)
+    {
+        run(blake3HashManyAvx512);
+    }
+    if (cpu.avx2)
+    {
+        run(blake3HashManyAvx2);
+    }
+    if (cpu.sse41)
+    {
+        run(blake3HashManySse41);
+    }
+#endif
+
+    for (; done < count; done++)
+    {
+        uint32_t cv[8];
+        std::copy_n(BLAKE3_IV, 8, cv);
+        const uint8_t *blockInput = input + done * stride;
+        uint8_t blockFlags = flags | flagsStart;
+        for (size_t block = 0; block < blocks; block++)
+        {
+            if (block + 1 == blocks)
+            {
+                blockFlags |= flagsEnd;
+            }
+            compressInPlace(cv, blockInput + block * BLAKE3_BLOCK_LEN, BLAKE3_BLOCK_LEN,
+                            counter + (incrementCounter ? done : 0), blockFlags);
+            blockFlags = flags;
+        }
+        storeCv(cv, out + done * BLAKE3_OUT_LEN);
+    }
+}
+
+// Chaining values of up to simdDegree() chunks, the last of which may be partial. Returns how many were written
+size_t compressChunks(const uint8_t *input, const size_t size, const uint64_t chunkCounter, uint8_t *out)
+{
+    const size_t wholeChunks = size / BLAKE3_CHUNK_LEN;
+    hashMany(input, wholeChunks, BLAKE3_CHUNK_LEN, BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN, chunkCounter, true, 0,
+             CHUNK_START, CHUNK_END, out);
+    if (size == wholeChunks * BLAKE3_CHUNK_LEN)
+    {
+        return wholeChunks;
+    }
+
+    Blake3::ChunkState chunk = newChunk(chunkCounter + wholeChunks);
+    updateChunk(chunk, input + wholeChunks * BLAKE3_CHUNK_LEN, size - wholeChunks * BLAKE3_CHUNK_LEN);
+    chunkOutput(chunk).chainingValue(out + wholeChunks * BLAKE3_OUT_LEN);
+    return wholeChunks + 1;
+}
+
+// Combine pairs of adjacent chaining values into their parents, passing an odd one through. Returns the new count
+size_t compressParents(const uint8_t *cvs, const size_t count, uint8_t *out)
+{
+    const size_t parents = count / 2;
+    hashMany(cvs, parents, BLAKE3_BLOCK_LEN, 1, 0, false, PARENT, 0, 0, out);
+    if (count % 2 != 0)
+    {
+        std::memcpy(out + parents * BLAKE3_OUT_LEN, cvs + parents * BLAKE3_BLOCK_LEN, BLAKE3_OUT_LEN);
+        return parents + 1;
+    }
+    return parents;
+}
+
+// Length of the left subtree of a node covering size bytes: the largest power of two number of whole chunks that
+// leaves at least one byte for the right
+size_t leftSubtreeLength(const size_t size)
+{
+    const size_t wholeChunks = (size - 1) / BLAKE3_CHUNK_LEN;
+    return std::bit_floor(wholeChunks) * BLAKE3_CHUNK_LEN;
+}
+
+// Reduce a subtree to at most simdDegree() (and at least two, given more than one chunk) chaining values, recursing
+// until each part is small enough for one call into the kernels. Returns how many were written
+size_t compressSubtreeWide(const uint8_t *input, const size_t size, const uint64_t chunkCounter, uint8_t *out)
+{
+    const size_t degree = simdDegree();
+    if (size <= degree * BLAKE3_CHUNK_LEN)
+    {
+        return compressChunks(input, size, chunkCounter, out);
+    }
+
+    const size_t leftLength = leftSubtreeLength(size);
+    // With no SIMD a subtree still has to come back as two values, so make room for that
+    const size_t width = leftLength > BLAKE3_CHUNK_LEN ? std::max<size_t>(degree, 2) : degree;
+    std::array<uint8_t, 2 * MAX_SIMD_DEGREE * BLAKE3_OUT_LEN> cvs;
+    const size_t leftCount = compressSubtreeWide(input, leftLength, chunkCounter, cvs.data());
+    const size_t rightCount = compressSubtreeWide(input + leftLength, size - leftLength,
+                                                  chunkCounter + leftLength / BLAKE3_CHUNK_LEN,
+                                                  cvs.data() + width * BLAKE3_OUT_LEN);
+
+    // A single chunk on the left means the whole subtree was only two chunks, which are already the two children
+    if (leftCount == 1)
+    {
+        std::memcpy(out, cvs.data(), 2 * BLAKE3_OUT_LEN);
+        return 2;
+    }
+    return compressParents(cvs.data(), leftCount + rightCount, out);
+}
+
+// The two children of the root of a subtree of more than one chunk
+void compressSubtreeToParentNode(const uint8_t *input, const size_t size, const uint64_t chunkCounter,
+                                 uint8_t out[2 * BLAKE3_OUT_LEN])
+{
+    std::array<uint8_t, MAX_SIMD_DEGREE * BLAKE3_OUT_LEN> cvs;
+    size_t count = compressSubtreeWide(input, size, chunkCounter, cvs.data());
+    while (count > 2)
+    {
+        std::array<uint8_t, MAX_SIMD_DEGREE * BLAKE3_OUT_LEN / 2> parents;
+        count = compressParents(cvs.data(), count, parents.data());
+        std::memcpy(cvs.data(), parents.data(), count * BLAKE3_OUT_LEN);
+    }
+    std::memcpy(out, cvs.data(), 2 * BLAKE3_OUT_LEN);
+}
+
+// Helper threads for hashing a single large input. Only one update uses them at a time; any other that wants them
+// meanwhile, say from a folder being hashed one file per core, simply hashes on its own thread.
+struct ParallelHashing
+{
+    std::mutex mutex;
+    WorkStealingPool pool;
+
+    explicit ParallelHashing(const size_t workers) : pool(workers)
+    {
+    }
+};
+
+ParallelHashing *parallelHashing()
+{
+    static const size_t threads = std::thread::hardware_concurrency();
+    if (threads < 2)
+    {
+        return nullptr;
+    }
+    // The calling thread hashes a piece of its own, so one fewer helper than there are cores
+    static ParallelHashing parallel(threads - 1);
+    return &parallel;
+}
+
+// Same result as compressSubtreeToParentNode, with the subtree split into equal power of two pieces that are hashed
+// on several threads and then joined pairwise. Returns false without doing anything if that is not worth it
+bool compressSubtreeInParallel(const uint8_t *input, const size_t size, const uint64_t chunkCounter,
+                               uint8_t out[2 * BLAKE3_OUT_LEN])
+{
+    if (size < 2 * MIN_PARALLEL_PIECE)
+    {
+        return false;
+    }
+    ParallelHashing *parallel = parallelHashing();
+    if (parallel == nullptr)
+    {
+        return false;
+    }
+    std::unique_lock lock(parallel->mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        return false;
+    }
+
+    // size is a power of two number of chunks here, so halving it keeps every piece a complete subtree
+    constexpr size_t MAX_PIECES = 64;
+    size_t pieces = std::bit_floor(std::min({parallel->pool.workerCount() + 1, size / MIN_PARALLEL_PIECE, MAX_PIECES}));
+    const size_t pieceLength = size / pieces;
+    std::array<std::array<uint8_t, BLAKE3_OUT_LEN>, MAX_PIECES> cvs;
+
+    auto hashPiece = [&](const size_t piece) {
+        uint8_t children[2 * BLAKE3_OUT_LEN];
+        compressSubtreeToParentNode(input + piece * pieceLength, pieceLength,
+                                    chunkCounter + piece * (pieceLength / BLAKE3_CHUNK_LEN), children);
+        parentOutput(children).chainingValue(cvs[piece].data());
+    };
+    for (size_t piece = 1; piece < pieces; piece++)
+    {
+        parallel->pool.submit([&hashPiece, piece]() { hashPiece(piece); });
+    }
+    hashPiece(0);
+    parallel->pool.wait();
+
+    for (; pieces > 2; pieces /= 2)
+    {
+        for (size_t i = 0; i < pieces / 2; i++)
+        {
+            uint8_t block[BLAKE3_BLOCK_LEN];
+            std::memcpy(block, cvs[2 * i].data(), BLAKE3_OUT_LEN);
+            std::memcpy(block + BLAKE3_OUT_LEN, cvs[2 * i + 1].data(), BLAKE3_OUT_LEN);
+            parentOutput(block).chainingValue(cvs[i].data());
+        }
+    }
+    std::memcpy(out, cvs[0].data(), BLAKE3_OUT_LEN);
+    std::memcpy(out + BLAKE3_OUT_LEN, cvs[1].data(), BLAKE3_OUT_LEN);
+    return true;
+}
+} // namespace
+
+Blake3::Blake3() : chunk(newChunk(0))
+{
+}
+
+bool Blake3::isValid() const
+{
+    // After every update the stack holds one chaining value per set bit of the number of completed chunks
+    return this->chunk.bufferLength <= this->chunk.buffer.size() && this->chunk.length() <= BLAKE3_CHUNK_LEN &&
+           this->chunk.counter < (uint64_t{1} << MAX_DEPTH) &&
+           this->cvStackLength == static_cast<size_t>(std::popcount(this->chunk.counter));
+}
+
+// Merge completed subtrees until the stack holds one chaining value per set bit of the chunk count. The newest value
+// is never merged here, because it might turn out to be the root and need the ROOT flag instead
+void Blake3::mergeCvStack(const uint64_t totalChunks)
+{
+    const size_t targetLength = std::popcount(totalChunks);
+    while (this->cvStackLength > targetLength)
+    {
+        uint8_t block[BLAKE3_BLOCK_LEN];
+        std::memcpy(block, this->cvStack[this->cvStackLength - 2].data(), BLAKE3_OUT_LEN);
+        std::memcpy(block + BLAKE3_OUT_LEN, this->cvStack[this->cvStackLength - 1].data(), BLAKE3_OUT_LEN);
+        parentOutput(block).chainingValue(this->cvStack[this->cvStackLength - 2].data());
+        this->cvStackLength--;
+    }
+}
+
+void Blake3::pushCv(const uint8_t *cv, const uint64_t chunkCounter)
+{
+    this->mergeCvStack(chunkCounter);
+    std::memcpy(this->cvStack[this->cvStackLength].data(), cv, BLAKE3_OUT_LEN);
+    this->cvStackLength++;
+}
+
+void Blake3::update(const uint8_t *input, size_t size)
+{
+    // Top up a partially filled chunk first
+    if (this->chunk.length() > 0)
+    {
+        const size_t take = std::min(BLAKE3_CHUNK_LEN - this->chunk.length(), size);
+        updateChunk(this->chunk, input, take);
+        input += take;
+        size -= take;
+        if (size == 0)
+        {
+            return;
+        }
+
+        uint8_t cv[BLAKE3_OUT_LEN];
+        chunkOutput(this->chunk).chainingValue(cv);
+        this->pushCv(cv, this->chunk.counter);
+        this->chunk = newChunk(this->chunk.counter + 1);
+    }
+
+    // Hash the biggest complete subtrees the input allows, each aligned to its own size in the tree. At least one
+    // byte is always kept back for the chunk state, since the last chunk must be finalized differently
+    while (size > BLAKE3_CHUNK_LEN)
+    {
+        size_t subtreeLength = std::bit_floor(size);
+        const uint64_t bytesSoFar = this->chunk.counter * BLAKE3_CHUNK_LEN;
+        while (((subtreeLength - 1) & bytesSoFar) != 0)
+        {
+            subtreeLength /= 2;
+        }
+        const uint64_t subtreeChunks = subtreeLength / BLAKE3_CHUNK_LEN;
+
+        if (subtreeLength <= BLAKE3_CHUNK_LEN)
+        {
+            ChunkState single = newChunk(this->chunk.counter);
+            updateChunk(single, input, subtreeLength);
+            uint8_t cv[BLAKE3_OUT_LEN];
+            chunkOutput(single).chainingValue(cv);
+            this->pushCv(cv, single.counter);
+        }
+        else
+        {
+            uint8_t children[2 * BLAKE3_OUT_LEN];
+            if (!compressSubtreeInParallel(input, subtreeLength, this->chunk.counter, children))
+            {
+                compressSubtreeToParentNode(input, subtreeLength, this->chunk.counter, children);
+            }
+            this->pushCv(children, this->chunk.counter);
+            this->pushCv(children + BLAKE3_OUT_LEN, this->chunk.counter + subtreeChunks / 2);
+        }
+        this->chunk.counter += subtreeChunks;
+        input += subtreeLength;
+        size -= subtreeLength;
+    }
+
+    if (size > 0)
+    {
+        updateChunk(this->chunk, input, size);
+        this->mergeCvStack(this->chunk.counter);
+    }
+}
+
+void Blake3::finalize(uint8_t *output, const size_t outputSize) const
+{
+    if (this->cvStackLength == 0)
+    {
+        chunkOutput(this->chunk).rootBytes(output, outputSize);
+        return;
+    }
+
+    // Fold the stack from the newest value down, the last node formed being the root
+    Output node{};
+    size_t remaining;
+    if (this->chunk.length() > 0)
+    {
+        remaining = this->cvStackLength;
+        node = chunkOutput(this->chunk);
+    }
+    else
+    {
+        remaining = this->cvStackLength - 2;
+        uint8_t block[BLAKE3_BLOCK_LEN];
+        std::memcpy(block, this->cvStack[remaining].data(), BLAKE3_OUT_LEN);
+        std::memcpy(block + BLAKE3_OUT_LEN, this->cvStack[remaining + 1].data(), BLAKE3_OUT_LEN);
+        node = parentOutput(block);
+    }
+    while (remaining > 0)
+    {
+        remaining--;
+        uint8_t block[BLAKE3_BLOCK_LEN];
+        std::memcpy(block, this->cvStack[remaining].data(), BLAKE3_OUT_LEN);
+        node.chainingValue(block + BLAKE3_OUT_LEN);
+        node = parentOutput(block);
+    }
+    node.rootBytes(output, outputSize);
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "blake3_impl.h"
+
+#ifdef HASHER_HAVE_BLAKE3_X86
+#include <immintrin.h>
+
+namespace
+{
+struct Avx2
+{
+    using Vec = __m256i;
+    static constexpr size_t DEGREE = 8;
+
+    static Vec add(const Vec a, const Vec b)
+    {
+        return _mm256_add_epi32(a, b);
+    }
+
+    static Vec bitXor(const Vec a, const Vec b)
+    {
+        return _mm256_xor_si256(a, b);
+    }
+
+    static Vec set1(const uint32_t value)
+    {
+        return _mm256_set1_epi32(static_cast<int>(value));
+    }
+
+    static Vec load(const uint32_t *words)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words));
+    }
+
+    static void store(uint32_t *words, const Vec value)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words), value);
+    }
+
+    // Rotations by whole bytes are a single byte shuffle, which works within each 128-bit half
+    static Vec rotr16(const Vec value)
+    {
+        return _mm256_shuffle_epi8(value, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2, 13, 12,
+                                                          15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+    }
+
+    static Vec rotr12(const Vec value)
+    {
+        return _mm256_or_si256(_mm256_srli_epi32(value, 12), _mm256_slli_epi32(value, 20));
+    }
+
+    static Vec rotr8(const Vec value)
+    {
+        return _mm256_shuffle_epi8(value, _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1, 12, 15,
+                                                          14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+    }
+
+    static Vec rotr7(const Vec value)
+    {
+        return _mm256_or_si256(_mm256_srli_epi32(value, 7), _mm256_slli_epi32(value, 25));
+    }
+
+    // Every input sits a fixed stride after the previous one, so each message word is a single gather
+    static void loadBlock(const uint8_t *input, const size_t stride, Vec message[16])
+    {
+        const int step = static_cast<int>(stride);
+        const Vec offsets = _mm256_setr_epi32(0, step, 2 * step, 3 * step, 4 * step, 5 * step, 6 * step, 7 * step);
+        for (size_t word = 0; word < 16; word++)
+        {
+            message[word] = _mm256_i32gather_epi32(reinterpret_cast<const int *>(input + word * 4), offsets, 1);
+        }
+    }
+};
+} // namespace
+
+size_t blake3HashManyAvx2(const uint8_t *input, const size_t count, const size_t stride, const size_t blocks,
+                          const uint32_t key[8], const uint64_t counter, const bool incrementCounter,
+                          const uint8_t flags, const uint8_t flagsStart, const uint8_t flagsEnd, uint8_t *out)
+{
+    return blake3HashManyWide<Avx2>(input, count, stride, blocks, key, counter, incrementCounter, flags, flagsStart,
+                                    flagsEnd, out);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "blake3_impl.h"
+
+#ifdef HASHER_HAVE_BLAKE3_X86
+#include <immintrin.h>
+
+namespace
+{
+struct Avx512
+{
+    using Vec = __m512i;
+    static constexpr size_t DEGREE = 16;
+
+    static Vec add(const Vec a, const Vec b)
+    {
+        return _mm512_add_epi32(a, b);
+    }
+
+    static Vec bitXor(const Vec a, const Vec b)
+    {
+        return _mm512_xor_si512(a, b);
+    }
+
+    static Vec set1(const uint32_t value)
+    {
+        return _mm512_set1_epi32(static_cast<int>(value));
+    }
+
+    static Vec load(const uint32_t *words)
+    {
+        return _mm512_loadu_si512(words);
+    }
+
+    static void store(uint32_t *words, const Vec value)
+    {
+        _mm512_storeu_si512(words, value);
+    }
+
+    // AVX-512 has a native rotate. The masked forms avoid GCC warning about the undefined source of the plain ones
+    static Vec rotr16(const Vec value)
+    {
+        return _mm512_mask_ror_epi32(value, 0xffff, value, 16);
+    }
+
+    static Vec rotr12(const Vec value)
+    {
+        return _mm512_mask_ror_epi32(value, 0xffff, value, 12);
+    }
+
+    static Vec rotr8(const Vec value)
+    {
+        return _mm512_mask_ror_epi32(value, 0xffff, value, 8);
+    }
+
+    static Vec rotr7(const Vec value)
+    {
+        return _mm512_mask_ror_epi32(value, 0xffff, value, 7);
+    }
+
+    // Every input sits a fixed stride after the previous one, so each message word is a single gather
+    static void loadBlock(const uint8_t *input, const size_t stride, Vec message[16])
+    {
+        const Vec offsets = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                               _mm512_set1_epi32(static_cast<int>(stride)));
+        for (size_t word = 0; word < 16; word++)
+        {
+            message[word] = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xffff, offsets, input + word * 4, 1);
+        }
+    }
+};
+} // namespace
+
+size_t blake3HashManyAvx512(const uint8_t *input, const size_t count, const size_t stride, const size_t blocks,
+                            const uint32_t key[8], const uint64_t counter, const bool incrementCounter,
+                            const uint8_t flags, const uint8_t flagsStart, const uint8_t flagsEnd, uint8_t *out)
+{
+    return blake3HashManyWide<Avx512>(input, count, stride, blocks, key, counter, incrementCounter, flags, flagsStart,
+                                      flagsEnd, out);
+}
+#endif
\ No newline at end of file
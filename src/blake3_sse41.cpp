@@ -0,0 +1,89 @@
+#include "blake3_impl.h"
+
+#ifdef HASHER_HAVE_BLAKE3_X86
+#include <immintrin.h>
+
+namespace
+{
+struct Sse41
+{
+    using Vec = __m128i;
+    static constexpr size_t DEGREE = 4;
+
+    static Vec add(const Vec a, const Vec b)
+    {
+        return _mm_add_epi32(a, b);
+    }
+
+    static Vec bitXor(const Vec a, const Vec b)
+    {
+        return _mm_xor_si128(a, b);
+    }
+
+    static Vec set1(const uint32_t value)
+    {
+        return _mm_set1_epi32(static_cast<int>(value));
+    }
+
+    static Vec load(const uint32_t *words)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(words));
+    }
+
+    static void store(uint32_t *words, const Vec value)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(words), value);
+    }
+
+    // Rotations by whole bytes are a single byte shuffle
+    static Vec rotr16(const Vec value)
+    {
+        return _mm_shuffle_epi8(value, _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+    }
+
+    static Vec rotr12(const Vec value)
+    {
+        return _mm_or_si128(_mm_srli_epi32(value, 12), _mm_slli_epi32(value, 20));
+    }
+
+    static Vec rotr8(const Vec value)
+    {
+        return _mm_shuffle_epi8(value, _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+    }
+
+    static Vec rotr7(const Vec value)
+    {
+        return _mm_or_si128(_mm_srli_epi32(value, 7), _mm_slli_epi32(value, 25));
+    }
+
+    // Load 16 bytes from each of the four inputs at a time and transpose them as a 4x4 matrix of words
+    static void loadBlock(const uint8_t *input, const size_t stride, Vec message[16])
+    {
+        for (size_t quarter = 0; quarter < 4; quarter++)
+        {
+            Vec rows[4];
+            for (size_t lane = 0; lane < 4; lane++)
+            {
+                rows[lane] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + lane * stride + quarter * 16));
+            }
+            const Vec low01 = _mm_unpacklo_epi32(rows[0], rows[1]);
+            const Vec low23 = _mm_unpacklo_epi32(rows[2], rows[3]);
+            const Vec high01 = _mm_unpackhi_epi32(rows[0], rows[1]);
+            const Vec high23 = _mm_unpackhi_epi32(rows[2], rows[3]);
+            message[quarter * 4] = _mm_unpacklo_epi64(low01, low23);
+            message[quarter * 4 + 1] = _mm_unpackhi_epi64(low01, low23);
+            message[quarter * 4 + 2] = _mm_unpacklo_epi64(high01, high23);
+            message[quarter * 4 + 3] = _mm_unpackhi_epi64(high01, high23);
+        }
+    }
+};
+} // namespace
+
+size_t blake3HashManySse41(const uint8_t *input, const size_t count, const size_t stride, const size_t blocks,
+                           const uint32_t key[8], const uint64_t counter, const bool incrementCounter,
+                           const uint8_t flags, const uint8_t flagsStart, const uint8_t flagsEnd, uint8_t *out)
+{
+    return blake3HashManyWide<Sse41>(input, count, stride, blocks, key, counter, incrementCounter, flags, flagsStart,
+                                     flagsEnd, out);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,654 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HASHER_HAVE_DIGEST_CACHE
+#endif
+
+#ifdef HASHER_HAVE_DIGEST_CACHE
+namespace
+{
+constexpr char CACHE_MAGIC[8] = {'H', 'S', 'H', 'C', 'A', 'C', 'H', 'E'};
+// 3 since BLAKE3, XXH3 and CRC-32C moved to wc_HashType values in range
+constexpr uint32_t CACHE_VERSION = 3;
+// Keep the mapping a little ahead of the file so appends do not force a remap on every lookup
+constexpr size_t MAPPING_GROWTH = 16 * 1024 * 1024;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+// Records start 8 byte aligned with this header. It is followed by the digests, each a length byte and the raw
+// digest for every algorithm bit in ascending order, then the path of the file, then padding to a multiple of 8
+struct RecordHeader
+{
+    uint32_t length;
+    uint32_t checksum; // FNV-1a of everything after this field, so a torn append is never read back
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtimeNs;
+    int64_t ctimeNs;
+    uint64_t algorithms; // One bit per wc_HashType; 0 marks every earlier record of the file as invalid
+    uint32_t digestBytes;
+    uint32_t pathBytes;
+};
+static_assert(sizeof(RecordHeader) == 64);
+
+uint32_t recordChecksum(const std::span<const byte> data)
+{
+    uint32_t hash = 2166136261u;
+    for (const byte value : data)
+    {
+        hash = (hash ^ value) * 16777619u;
+    }
+    return hash;
+}
+
+uint64_t algorithmBit(const wc_HashType algorithm)
+{
+    return uint64_t{1} << static_cast<unsigned>(algorithm);
+}
+
+// Serialize one record, with no digests for an invalidation marker
+std::vector<byte> makeRecord(const FileIdentity &identity, const std::string &filePath, const DigestSet &hashes)
+{
+    std::vector<byte> digests;
+    uint64_t algorithms = 0;
+    // DigestSet keeps the algorithms in ascending order, matching the bit order readers expect
+    for (const auto &[algorithm, raw] : hashes)
+    {
+        if (static_cast<size_t>(algorithm) >= MAX_ALGORITHMS || raw.size() > 255)
+        {
+            throw std::invalid_argument(
+                std::format("Cannot cache digest for algorithm {}", static_cast<int>(algorithm)));
+        }
+        algorithms |= algorithmBit(algorithm);
+        digests.push_back(static_cast<byte>(raw.size()));
+        digests.insert(digests.end(), raw.begin(), raw.end());
+    }
+
+    RecordHeader header{};
+    header.device = identity.device;
+    header.inode = identity.inode;
+    header.size = identity.size;
+    header.mtimeNs = identity.mtimeNs;
+    header.ctimeNs = identity.ctimeNs;
+    header.algorithms = algorithms;
+    header.digestBytes = static_cast<uint32_t>(digests.size());
+    header.pathBytes = static_cast<uint32_t>(filePath.size());
+    header.length = static_cast<uint32_t>((sizeof(RecordHeader) + digests.size() + filePath.size() + 7) / 8 * 8);
+
+    std::vector<byte> record(header.length, 0);
+    std::memcpy(record.data(), &header, sizeof(header));
+    std::ranges::copy(digests, record.begin() + sizeof(RecordHeader));
+    std::memcpy(record.data() + sizeof(RecordHeader) + digests.size(), filePath.data(), filePath.size());
+
+    header.checksum = recordChecksum(std::span(record).subspan(offsetof(RecordHeader, device)));
+    std::memcpy(record.data(), &header, sizeof(header));
+    return record;
+}
+
+struct NodeKey
+{
+    uint64_t device;
+    uint64_t inode;
+
+    bool operator==(const NodeKey &) const = default;
+};
+
+struct NodeKeyHash
+{
+    size_t operator()(const NodeKey &key) const
+    {
+        return std::hash<uint64_t>()(key.inode * 0x9e3779b97f4a7c15ull ^ key.device);
+    }
+};
+} // namespace
+
+std::optional<FileIdentity> fileIdentity(const std::string &filePath)
+{
+    struct stat status{};
+    if (stat(filePath.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        return std::nullopt;
+    }
+
+#ifdef __APPLE__
+    const timespec &modified = status.st_mtimespec;
+    const timespec &changed = status.st_ctimespec;
+#else
+    const timespec &modified = status.st_mtim;
+    const timespec &changed = status.st_ctim;
+#endif
+    return FileIdentity{
+        .device = static_cast<uint64_t>(status.st_dev),
+        .inode = static_cast<uint64_t>(status.st_ino),
+        .size = static_cast<uint64_t>(status.st_size),
+        .mtimeNs = static_cast<int64_t>(modified.tv_sec) * 1000000000 + modified.tv_nsec,
+        .ctimeNs = static_cast<int64_t>(changed.tv_sec) * 1000000000 + changed.tv_nsec,
+    };
+}
+
+struct DigestCache::State
+{
+    std::string path;
+    int descriptor = -1;
+    // Which file the descriptor refers to, to notice when another process swaps in a compacted one
+    uint64_t openDevice = 0;
+    uint64_t openInode = 0;
+
+    const byte *mapping = nullptr;
+    size_t mappedSize = 0;
+    // End of the last valid record indexed, and how many records that covers
+    uint64_t scanned = sizeof(FileHeader);
+    uint64_t records = 0;
+    std::unordered_map<NodeKey, std::vector<uint64_t>, NodeKeyHash> index;
+
+    std::mutex mutex;
+
+    void openFile()
+    {
+        this->descriptor = open(this->path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (this->descriptor < 0)
+        {
+            throw std::system_error(errno, std::system_category(), "Failed to open digest cache");
+        }
+
+        while (flock(this->descriptor, LOCK_EX) != 0)
+        {
+            if (errno != EINTR)
+            {
+                throw std::system_error(errno, std::system_category(), "Failed to lock digest cache");
+            }
+        }
+
+        struct stat status{};
+        fstat(this->descriptor, &status);
+        this->openDevice = static_cast<uint64_t>(status.st_dev);
+        this->openInode = static_cast<uint64_t>(status.st_ino);
+
+        FileHeader header{};
+        if (status.st_size == 0)
+        {
+            std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+            header.version = CACHE_VERSION;
+            const bool written = pwrite(this->descriptor, &header, sizeof(header), 0) == sizeof(header);
+            flock(this->descriptor, LOCK_UN);
+            if (!written)
+            {
+                throw std::system_error(errno, std::system_category(), "Failed to write digest cache");
+            }
+            return;
+        }
+
+        const bool valid = pread(this->descriptor, &header, sizeof(header), 0) == sizeof(header) &&
+                           std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0;
+        flock(this->descriptor, LOCK_UN);
+        if (!valid)
+        {
+            throw std::runtime_error(std::format("{} is not a digest cache", this->path));
+        }
+        if (header.version != CACHE_VERSION)
+        {
+            throw std::runtime_error(std::format(
+                "{} was written by another version of the digest cache, remove it to start over", this->path));
+        }
+    }
+
+    void closeFile()
+    {
+        if (this->mapping != nullptr)
+        {
+            munmap(const_cast<byte *>(this->mapping), this->mappedSize);
+        }
+        if (this->descriptor >= 0)
+        {
+            close(this->descriptor);
+        }
+        this->mapping = nullptr;
+        this->mappedSize = 0;
+        this->descriptor = -1;
+        this->scanned = sizeof(FileHeader);
+        this->records = 0;
+        this->index.clear();
+    }
+
+    // flock the cache file, reopening it first if another process replaced it
+    void lock(const int operation)
+    {
+        while (true)
+        {
+            if (flock(this->descriptor, operation) != 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::system_category(), "Failed to lock digest cache");
+            }
+
+            struct stat status{};
+            if (stat(this->path.c_str(), &status) == 0 && static_cast<uint64_t>(status.st_dev) == this->openDevice &&
+                static_cast<uint64_t>(status.st_ino) == this->openInode)
+            {
+                return;
+            }
+            flock(this->descriptor, LOCK_UN);
+            this->closeFile();
+            this->openFile();
+        }
+    }
+
+    void unlock() const
+    {
+        flock(this->descriptor, LOCK_UN);
+    }
+
+    void remap(const size_t size)
+    {
+        if (this->mapping != nullptr)
+        {
+            munmap(const_cast<byte *>(this->mapping), this->mappedSize);
+            this->mapping = nullptr;
+            this->mappedSize = 0;
+        }
+        const size_t capacity = size + MAPPING_GROWTH;
+        void *mapping = mmap(nullptr, capacity, PROT_READ, MAP_SHARED, this->descriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::system_error(errno, std::system_category(), "Failed to map digest cache");
+        }
+        this->mapping = static_cast<const byte *>(mapping);
+        this->mappedSize = capacity;
+    }
+
+    [[nodiscard]] const RecordHeader &record(const uint64_t offset)
+    {
+        if (offset + sizeof(RecordHeader) > this->mappedSize ||
+            offset + reinterpret_cast<const RecordHeader *>(this->mapping + offset)->length > this->mappedSize)
+        {
+            this->remap(this->scanned);
+        }
+        return *reinterpret_cast<const RecordHeader *>(this->mapping + offset);
+    }
+
+    // Index records appended since the last scan. Needs the file lock, so a half written record is never read
+    void refresh()
+    {
+        struct stat status{};
+        if (fstat(this->descriptor, &status) != 0)
+        {
+            throw std::system_error(errno, std::system_category(), "Failed to stat digest cache");
+        }
+        const auto size = static_cast<uint64_t>(status.st_size);
+        if (size <= this->scanned)
+        {
+            return;
+        }
+        if (size > this->mappedSize)
+        {
+            this->remap(size);
+        }
+
+        uint64_t offset = this->scanned;
+        while (offset + sizeof(RecordHeader) <= size)
+        {
+            const auto &header = *reinterpret_cast<const RecordHeader *>(this->mapping + offset);
+            if (header.length < sizeof(RecordHeader) || header.length % 8 != 0 || offset + header.length > size ||
+                sizeof(RecordHeader) + header.digestBytes + header.pathBytes > header.length)
+            {
+                break;
+            }
+            const std::span body(this->mapping + offset + offsetof(RecordHeader, device),
+                                 header.length - offsetof(RecordHeader, device));
+            if (recordChecksum(body) != header.checksum)
+            {
+                break;
+            }
+
+            const NodeKey key{header.device, header.inode};
+            if (header.algorithms == 0)
+            {
+                this->index.erase(key);
+            }
+            else
+            {
+                this->index[key].push_back(offset);
+            }
+            this->records++;
+            offset += header.length;
+        }
+        this->scanned = offset;
+    }
+
+    void append(const std::vector<byte> &record)
+    {
+        this->lock(LOCK_EX);
+        try
+        {
+            this->refresh();
+            // Cut off whatever a process that died mid-append left behind
+            struct stat status{};
+            if (fstat(this->descriptor, &status) == 0 && static_cast<uint64_t>(status.st_size) > this->scanned)
+            {
+                if (ftruncate(this->descriptor, static_cast<off_t>(this->scanned)) != 0)
+                {
+                    throw std::system_error(errno, std::system_category(), "Failed to repair digest cache");
+                }
+            }
+
+            size_t written = 0;
+            while (written < record.size())
+            {
+                const ssize_t result = pwrite(this->descriptor, record.data() + written, record.size() - written,
+                                              static_cast<off_t>(this->scanned + written));
+                if (result < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (result <= 0)
+                {
+                    throw std::system_error(errno, std::system_category(), "Failed to write digest cache");
+                }
+                written += static_cast<size_t>(result);
+            }
+        }
+        catch (...)
+        {
+            this->unlock();
+            throw;
+        }
+        // Read our own record back through the index like any other
+        this->refresh();
+        this->unlock();
+    }
+
+    // Write the given records to a new file and swap it in for the cache. Needs the exclusive lock
+    void replace(const std::vector<uint64_t> &offsets)
+    {
+        const std::string temporaryPath = std::format("{}.{}.tmp", this->path, getpid());
+        const int temporary = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (temporary < 0)
+        {
+            throw std::system_error(errno, std::system_category(), "Failed to create digest cache");
+        }
+
+        FileHeader header{};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        std::vector<byte> contents(sizeof(header));
+        std::memcpy(contents.data(), &header, sizeof(header));
+        for (const uint64_t offset : offsets)
+        {
+            const RecordHeader &record = this->record(offset);
+            const byte *start = reinterpret_cast<const byte *>(&record);
+            contents.insert(contents.end(), start, start + record.length);
+        }
+
+        const bool written =
+            write(temporary, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size()) &&
+            fsync(temporary) == 0;
+        close(temporary);
+        if (!written || rename(temporaryPath.c_str(), this->path.c_str()) != 0)
+        {
+            const int error = errno;
+            unlink(temporaryPath.c_str());
+            throw std::system_error(error, std::system_category(), "Failed to replace digest cache");
+        }
+    }
+};
+
+DigestCache::DigestCache(const std::string &cachePath) : state(std::make_unique<State>())
+{
+    this->state->path = cachePath;
+    this->state->openFile();
+    this->state->lock(LOCK_SH);
+    this->state->refresh();
+    this->state->unlock();
+}
+
+DigestCache::~DigestCache()
+{
+    this->state->closeFile();
+}
+
+std::optional<DigestSet> DigestCache::lookup(
+    const FileIdentity &identity, const std::vector<wc_HashType> &hashesToCalculate)
+{
+    uint64_t wanted = 0;
+    for (const wc_HashType algorithm : hashesToCalculate)
+    {
+        if (static_cast<size_t>(algorithm) >= MAX_ALGORITHMS)
+        {
+            return std::nullopt;
+        }
+        wanted |= algorithmBit(algorithm);
+    }
+
+    std::lock_guard lock(this->state->mutex);
+
+    auto search = [&]() -> std::optional<DigestSet> {
+        const auto entry = this->state->index.find({identity.device, identity.inode});
+        if (entry == this->state->index.end())
+        {
+            return std::nullopt;
+        }
+
+        // Newest first, since an older record of the same file can only be less complete
+        for (const uint64_t offset : entry->second | std::views::reverse)
+        {
+            const RecordHeader &record = this->state->record(offset);
+            const FileIdentity recorded{record.device, record.inode, record.size, record.mtimeNs, record.ctimeNs};
+            if (recorded != identity || (record.algorithms & wanted) != wanted)
+            {
+                continue;
+            }
+
+            DigestSet hashes;
+            const byte *digest = reinterpret_cast<const byte *>(&record) + sizeof(RecordHeader);
+            const byte *digestsEnd = digest + record.digestBytes;
+            for (unsigned bit = 0; bit < MAX_ALGORITHMS && digest < digestsEnd; bit++)
+            {
+                if ((record.algorithms & (uint64_t{1} << bit)) == 0)
+                {
+                    continue;
+                }
+                const size_t length = *digest++;
+                if (digest + length > digestsEnd)
+                {
+                    break;
+                }
+                if ((wanted & (uint64_t{1} << bit)) != 0)
+                {
+                    hashes.set(static_cast<wc_HashType>(bit), {digest, length});
+                }
+                digest += length;
+            }
+            if (hashes.size() == static_cast<size_t>(std::popcount(wanted)))
+            {
+                return hashes;
+            }
+        }
+        return std::nullopt;
+    };
+
+    if (auto hashes = search())
+    {
+        return hashes;
+    }
+
+    // Another process may have hashed the file since we last looked
+    this->state->lock(LOCK_SH);
+    try
+    {
+        this->state->refresh();
+    }
+    catch (...)
+    {
+        this->state->unlock();
+        throw;
+    }
+    this->state->unlock();
+    return search();
+}
+
+void DigestCache::store(const FileIdentity &identity, const std::string &filePath, const DigestSet &hashes)
+{
+    if (hashes.empty())
+    {
+        return;
+    }
+    const std::vector<byte> record = makeRecord(identity, std::filesystem::absolute(filePath).string(), hashes);
+
+    std::lock_guard lock(this->state->mutex);
+    this->state->append(record);
+}
+
+bool DigestCache::invalidate(const std::string &filePath)
+{
+    const std::optional<FileIdentity> identity = fileIdentity(filePath);
+    if (!identity)
+    {
+        return false;
+    }
+    const std::vector<byte> record = makeRecord(*identity, std::filesystem::absolute(filePath).string(), {});
+
+    std::lock_guard lock(this->state->mutex);
+    this->state->append(record);
+    return true;
+}
+
+void DigestCache::clear()
+{
+    std::lock_guard lock(this->state->mutex);
+    this->state->lock(LOCK_EX);
+    try
+    {
+        this->state->replace({});
+    }
+    catch (...)
+    {
+        this->state->unlock();
+        throw;
+    }
+    this->state->closeFile();
+    this->state->openFile();
+}
+
+CompactResult DigestCache::compact()
+{
+    std::lock_guard lock(this->state->mutex);
+    this->state->lock(LOCK_EX);
+
+    CompactResult result;
+    try
+    {
+        this->state->refresh();
+
+        std::vector<uint64_t> kept;
+        for (const std::vector<uint64_t> &offsets : this->state->index | std::views::values)
+        {
+            std::vector<uint64_t> keptAlgorithms;
+            for (const uint64_t offset : offsets | std::views::reverse)
+            {
+                const RecordHeader &record = this->state->record(offset);
+                if (std::ranges::find(keptAlgorithms, record.algorithms) != keptAlgorithms.end())
+                {
+                    continue;
+                }
+                const std::string path(reinterpret_cast<const char *>(&record) + sizeof(RecordHeader) +
+                                           record.digestBytes,
+                                       record.pathBytes);
+                const FileIdentity recorded{record.device, record.inode, record.size, record.mtimeNs,
+                                            record.ctimeNs};
+                if (fileIdentity(path) != recorded)
+                {
+                    continue;
+                }
+                keptAlgorithms.push_back(record.algorithms);
+                kept.push_back(offset);
+            }
+        }
+        std::ranges::sort(kept);
+
+        this->state->replace(kept);
+        result.kept = kept.size();
+        result.dropped = this->state->records - kept.size();
+    }
+    catch (...)
+    {
+        this->state->unlock();
+        throw;
+    }
+
+    // Closing the old file also drops our lock on it
+    this->state->closeFile();
+    this->state->openFile();
+    this->state->lock(LOCK_SH);
+    this->state->refresh();
+    this->state->unlock();
+    return result;
+}
+#else
+std::optional<FileIdentity> fileIdentity(const std::string & /*filePath*/)
+{
+    return std::nullopt;
+}
+
+struct DigestCache::State
+{
+};
+
+DigestCache::DigestCache(const std::string & /*cachePath*/)
+{
+    throw std::runtime_error("The digest cache is not supported on this platform");
+}
+
+DigestCache::~DigestCache() = default;
+
+std::optional<DigestSet> DigestCache::lookup(const FileIdentity &, const std::vector<wc_HashType> &)
+{
+    return std::nullopt;
+}
+
+void DigestCache::store(const FileIdentity &, const std::string &, const DigestSet &)
+{
+}
+
+bool DigestCache::invalidate(const std::string &)
+{
+    return false;
+}
+
+void DigestCache::clear()
+{
+}
+
+CompactResult DigestCache::compact()
+{
+    return {};
+}
+#endif
\ No newline at end of file
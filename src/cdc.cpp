@@ -0,0 +1,329 @@
+#include "cdc.h"
+#include "cdc_impl.h"
+#include "cpu.h"
+#include "encoding.h"
+#include "pool.h"
+#include "reader.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+
+namespace
+{
+constexpr uint32_t MIN_AVERAGE_SIZE = 256;
+constexpr uint32_t MAX_AVERAGE_SIZE = 64 * 1024 * 1024;
+// Normalized chunking: chunks shorter than the average need this many more hash bits clear, longer ones this many
+// fewer, which pulls chunk sizes towards the average
+constexpr int NORMALIZATION = 2;
+
+// The top bits depend on the whole 64 byte window, the low ones only on the last few bytes
+uint64_t topBits(const int count)
+{
+    return ~uint64_t{0} << (64 - count);
+}
+
+bool isCancelled(const std::optional<std::reference_wrapper<const std::atomic<bool>>> &shouldCancel)
+{
+    return shouldCancel && shouldCancel->get().load();
+}
+
+// Roll the hash over data with the fastest scan available, finishing what a kernel leaves with the portable one
+size_t gearScan(const uint8_t *data, const size_t length, uint64_t &hash, const uint64_t mask)
+{
+    size_t done = 0;
+#ifdef HASHER_HAVE_GEAR_X86
+    if (cpuFeatures().avx2)
+    {
+        done = gearScanAvx2(data, length, hash, mask);
+        if (done > 0 && (hash & mask) == 0)
+        {
+            return done;
+        }
+    }
+#endif
+    return done + gearScanPortable(data + done, length - done, hash, mask);
+}
+
+// Turns the stream of read buffers into chunks, carrying a chunk and the hash over from one buffer to the next
+class Chunker
+{
+    const ChunkingParameters &parameters;
+    const uint64_t smallMask;
+    const uint64_t largeMask;
+    ContentChunks &chunks;
+    // Hashers cannot be reassigned, so each chunk gets a fresh one emplaced
+    std::optional<Hasher> hasher;
+    uint64_t chunkStart = 0;
+    uint64_t position = 0;
+    uint64_t hash = 0;
+    // Whether hash covers the 64 bytes before position. Bytes inside the minimum size are never scanned, so the hash
+    // is picked up again from the window before the scan starts
+    bool hashReady = false;
+    // Last bytes of the previous buffers, for a window that starts before the current one
+    std::array<uint8_t, GEAR_WINDOW> history{};
+
+    void endChunk()
+    {
+        this->hasher->finalize();
+        const std::span<const byte> digest = this->hasher->getRawDigest();
+        this->chunks.digests.insert(this->chunks.digests.end(), digest.begin(), digest.end());
+        this->chunks.ends.push_back(this->position);
+        this->chunkStart = this->position;
+        this->hasher.emplace(this->chunks.algorithm);
+        this->hashReady = false;
+    }
+
+    // Hash of the window ending just before data[offset]
+    [[nodiscard]] uint64_t windowHash(const std::span<const byte> data, const size_t offset) const
+    {
+        const size_t fromData = std::min(offset, GEAR_WINDOW);
+        uint64_t value = 0;
+        for (size_t i = fromData; i < GEAR_WINDOW; i++)
+        {
+            value = gearRoll(value, this->history[i]);
+        }
+        for (size_t i = offset - fromData; i < offset; i++)
+        {
+            value = gearRoll(value, data[i]);
+        }
+        return value;
+    }
+
+    void consume(const std::span<const byte> data)
+    {
+        this->hasher->updateWithBuffer(data.data(), static_cast<word32>(data.size()));
+        this->position += data.size();
+    }
+
+    void remember(const std::span<const byte> data)
+    {
+        if (data.size() >= GEAR_WINDOW)
+        {
+            std::memcpy(this->history.data(), data.data() + data.size() - GEAR_WINDOW, GEAR_WINDOW);
+            return;
+        }
+        std::memmove(this->history.data(), this->history.data() + data.size(), GEAR_WINDOW - data.size());
+        std::memcpy(this->history.data() + GEAR_WINDOW - data.size(), data.data(), data.size());
+    }
+
+  public:
+    Chunker(const ChunkingParameters &parameters, ContentChunks &chunks)
+        : parameters(parameters),
+          smallMask(topBits(std::countr_zero(parameters.averageSize) + NORMALIZATION)),
+          largeMask(topBits(std::countr_zero(parameters.averageSize) - NORMALIZATION)), chunks(chunks)
+    {
+        this->hasher.emplace(chunks.algorithm);
+    }
+
+    void update(const std::span<const byte> data)
+    {
+        size_t offset = 0;
+        while (offset < data.size())
+        {
+            const uint64_t length = this->position - this->chunkStart;
+            const size_t available = data.size() - offset;
+            if (length < this->parameters.minimumSize)
+            {
+                const size_t skipped =
+                    static_cast<size_t>(std::min<uint64_t>(this->parameters.minimumSize - length, available));
+                this->consume(data.subspan(offset, skipped));
+                offset += skipped;
+                continue;
+            }
+
+            if (!this->hashReady)
+            {
+                this->hash = this->windowHash(data, offset);
+                this->hashReady = true;
+            }
+            const bool small = length < this->parameters.averageSize;
+            const uint64_t mask = small ? this->smallMask : this->largeMask;
+            const uint64_t limit = small ? this->parameters.averageSize : this->parameters.maximumSize;
+            const size_t scanned = gearScan(data.data() + offset,
+                                            static_cast<size_t>(std::min<uint64_t>(limit - length, available)),
+                                            this->hash, mask);
+            this->consume(data.subspan(offset, scanned));
+            offset += scanned;
+            if ((this->hash & mask) == 0 || this->position - this->chunkStart == this->parameters.maximumSize)
+            {
+                this->endChunk();
+            }
+        }
+        this->remember(data);
+    }
+
+    void finish()
+    {
+        if (this->position > this->chunkStart)
+        {
+            this->endChunk();
+        }
+    }
+};
+
+struct ChunkReference
+{
+    const byte *digest;
+    uint64_t length;
+    size_t file;
+    size_t index;
+};
+} // namespace
+
+ChunkingParameters ChunkingParameters::forAverage(const uint32_t averageSize)
+{
+    if (!std::has_single_bit(averageSize) || averageSize < MIN_AVERAGE_SIZE || averageSize > MAX_AVERAGE_SIZE)
+    {
+        throw std::invalid_argument(
+            std::format("average chunk size must be a power of two from {} to {} bytes", MIN_AVERAGE_SIZE,
+                        MAX_AVERAGE_SIZE));
+    }
+    return {.minimumSize = averageSize / 4, .averageSize = averageSize, .maximumSize = averageSize * 4};
+}
+
+ContentChunks chunkFile(const std::string &filePath, const wc_HashType algorithm,
+                        const ChunkingParameters &parameters, const HashOptions &options,
+                        const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+{
+    ContentChunks chunks;
+    chunks.path = filePath;
+    chunks.algorithm = algorithm;
+    chunks.digestSize = Hasher(algorithm).getDigestSize();
+
+    Chunker chunker(parameters, chunks);
+    const FileReaderPtr reader = openFileReader(filePath, options, 1);
+    do
+    {
+        if (isCancelled(shouldCancel))
+        {
+            chunks.digests.clear();
+            return chunks;
+        }
+        const std::span<const byte> data = reader->read(0);
+        chunker.update(data);
+        chunks.fileSize += data.size();
+        if (options.progress != nullptr)
+        {
+            options.progress->bytesRead.fetch_add(data.size(), std::memory_order_relaxed);
+            options.progress->algorithm(algorithm).bytesHashed.fetch_add(data.size(), std::memory_order_relaxed);
+        }
+        reader->release(0);
+    } while (!reader->finished());
+    chunker.finish();
+    return chunks;
+}
+
+std::vector<ContentChunks> chunkFiles(const std::vector<std::string> &filePaths, const wc_HashType algorithm,
+                                      const ChunkingParameters &parameters, const HashOptions &options,
+                                      const size_t jobs,
+                                      const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+{
+    std::vector<ContentChunks> results(filePaths.size());
+    WorkStealingPool pool(std::max<size_t>(jobs, 1));
+    for (size_t i = 0; i < filePaths.size(); i++)
+    {
+        pool.submit([&, i]() {
+            try
+            {
+                results[i] = chunkFile(filePaths[i], algorithm, parameters, options, shouldCancel);
+            }
+            catch (const std::exception &exception)
+            {
+                results[i].path = filePaths[i];
+                results[i].algorithm = algorithm;
+                results[i].error = exception.what();
+            }
+        });
+    }
+    pool.wait();
+    return results;
+}
+
+void saveChunkIndex(std::ostream &output, const std::vector<ContentChunks> &files,
+                    const ChunkingParameters &parameters)
+{
+    output << "hasher-cdc-index 1\n";
+    output << std::format("algorithm {}\n", algorithmName(files.empty() ? HASH_TYPE_BLAKE3 : files.front().algorithm));
+    output << std::format("average-size {}\n", parameters.averageSize);
+    for (const ContentChunks &file : files)
+    {
+        if (!file.error.empty())
+        {
+            continue;
+        }
+        output << std::format("file {} {} {}\n", file.fileSize, file.chunkCount(), file.path);
+        for (size_t i = 0; i < file.chunkCount(); i++)
+        {
+            output << std::format("{} {} {}\n", file.offset(i), file.length(i), toHex(file.digest(i)));
+        }
+    }
+}
+
+SharedBytesReport compareChunks(const std::vector<ContentChunks> &files)
+{
+    SharedBytesReport report;
+    report.files.resize(files.size());
+
+    std::vector<ChunkReference> references;
+    for (size_t file = 0; file < files.size(); file++)
+    {
+        const ContentChunks &chunks = files[file];
+        report.files[file].bytes = chunks.fileSize;
+        report.totalBytes += chunks.fileSize;
+        // Chunks without digests were cancelled and cannot be matched
+        if (!chunks.error.empty() || chunks.digests.size() != chunks.chunkCount() * chunks.digestSize)
+        {
+            report.uniqueBytes += chunks.fileSize;
+            continue;
+        }
+        for (size_t index = 0; index < chunks.chunkCount(); index++)
+        {
+            references.push_back({chunks.digest(index).data(), chunks.length(index), file, index});
+        }
+    }
+
+    // Equal chunks end up next to each other, in file and then chunk order
+    const size_t digestSize = files.empty() ? 0 : files.front().digestSize;
+    std::ranges::sort(references, [&](const ChunkReference &left, const ChunkReference &right) {
+        const int order = std::memcmp(left.digest, right.digest, digestSize);
+        if (order != 0)
+        {
+            return order < 0;
+        }
+        return std::tie(left.length, left.file, left.index) < std::tie(right.length, right.file, right.index);
+    });
+
+    for (size_t first = 0; first < references.size();)
+    {
+        size_t last = first + 1;
+        while (last < references.size() && references[last].length == references[first].length &&
+               std::memcmp(references[last].digest, references[first].digest, digestSize) == 0)
+        {
+            last++;
+        }
+
+        report.uniqueBytes += references[first].length;
+        const bool shared = references[last - 1].file != references[first].file;
+        for (size_t i = first; i < last; i++)
+        {
+            ChunkSharing &sharing = report.files[references[i].file];
+            if (shared)
+            {
+                sharing.sharedBytes += references[i].length;
+            }
+            else if (i > first)
+            {
+                sharing.repeatedBytes += references[i].length;
+            }
+        }
+        first = last;
+    }
+    return report;
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "cdc_impl.h"
+
+#ifdef HASHER_HAVE_GEAR_X86
+#include <immintrin.h>
+
+
+namespace
+{
+// Bytes each lane covers per block. Every lane but the first rolls over the 64 bytes before its span to pick up the
+// hash there, so longer spans waste less on that, but more on rescanning a block once a lane finds a boundary
+constexpr size_t LANE_SPAN = 512;
+constexpr size_t LANES = 4;
+constexpr size_t BLOCK = LANES * LANE_SPAN;
+
+// Table entries for the byte at offset in each lane. Scalar loads beat a gather here by a wide margin
+__m256i gearLanes(const uint8_t *const starts[LANES], const size_t offset)
+{
+    return _mm256_set_epi64x(static_cast<long long>(GEAR_TABLE[starts[3][offset]]),
+                             static_cast<long long>(GEAR_TABLE[starts[2][offset]]),
+                             static_cast<long long>(GEAR_TABLE[starts[1][offset]]),
+                             static_cast<long long>(GEAR_TABLE[starts[0][offset]]));
+}
+} // namespace
+
+// Four lanes roll the hash over four consecutive spans of a block at once, which hides the latency of the single
+// dependency chain a scalar scan is stuck on. Matches are only collected while rolling, and a block holding one is
+// rescanned by the portable scan to find the first
+size_t gearScanAvx2(const uint8_t *data, const size_t length, uint64_t &hash, const uint64_t mask)
+{
+    const __m256i maskVector = _mm256_set1_epi64x(static_cast<long long>(mask));
+    const __m256i zero = _mm256_setzero_si256();
+    size_t done = 0;
+
+    while (length - done >= BLOCK)
+    {
+        const uint8_t *block = data + done;
+
+        // Warm every lane but the first up over the bytes before its span. The bytes before the block may not be in
+        // data, so the first lane starts from hash instead and just repeats the second lane's warm up meanwhile
+        const uint8_t *const warmStarts[LANES] = {block + LANE_SPAN - GEAR_WINDOW, block + LANE_SPAN - GEAR_WINDOW,
+                                                  block + 2 * LANE_SPAN - GEAR_WINDOW,
+                                                  block + 3 * LANE_SPAN - GEAR_WINDOW};
+        __m256i lanes = _mm256_setzero_si256();
+        for (size_t offset = 0; offset < GEAR_WINDOW; offset++)
+        {
+            lanes = _mm256_add_epi64(_mm256_add_epi64(lanes, lanes), gearLanes(warmStarts, offset));
+        }
+        lanes = _mm256_blend_epi32(lanes, _mm256_set1_epi64x(static_cast<long long>(hash)), 0x03);
+
+        const uint8_t *const starts[LANES] = {block, block + LANE_SPAN, block + 2 * LANE_SPAN,
+                                              block + 3 * LANE_SPAN};
+        __m256i matches = _mm256_setzero_si256();
+        for (size_t offset = 0; offset < LANE_SPAN; offset++)
+        {
+            lanes = _mm256_add_epi64(_mm256_add_epi64(lanes, lanes), gearLanes(starts, offset));
+            matches = _mm256_or_si256(matches, _mm256_cmpeq_epi64(_mm256_and_si256(lanes, maskVector), zero));
+        }
+
+        if (_mm256_testz_si256(matches, matches) == 0)
+        {
+            return done + gearScanPortable(block, BLOCK, hash, mask);
+        }
+        hash = static_cast<uint64_t>(_mm256_extract_epi64(lanes, 3));
+        done += BLOCK;
+    }
+    return done;
+}
+#endif
\ No newline at end of file
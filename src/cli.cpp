@@ -0,0 +1,1253 @@
+#include "cache.h"
+#include "cdc.h"
+#include "dedup.h"
+#include "encoding.h"
+#include "hash.h"
+#include "known.h"
+#include "merkle.h"
+#include "quick.h"
+#include "tree.h"
+#include "verify.h"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static constexpr std::string_view PROGRAM_NAME = "hasher-cli";
+
+enum class CacheCommand
+{
+    None,
+    Invalidate, // Drop the cached digests of the given files instead of hashing them
+    Compact,
+    Clear,
+};
+
+struct Options
+{
+    std::vector<wc_HashType> algorithms;
+    unsigned int jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> listFiles;
+    std::vector<std::string> operands;
+    bool nullSeparated = false;
+    bool recursive = false;
+    bool summary = false;
+    std::string cachePath;
+    CacheCommand cacheCommand = CacheCommand::None;
+    HashOptions hashOptions;
+    // Chunk manifest to write for, or check, the one FILE given
+    std::string manifestPath;
+    std::string verifyManifestPath;
+    uint64_t chunkSize = DEFAULT_CHUNK_SIZE;
+    uint64_t rangeOffset = 0;
+    uint64_t rangeLength = UINT64_MAX;
+    // Hash state to resume the one FILE from and save afterwards
+    std::string checkpointPath;
+    // sha256sum style manifests to verify instead of hashing FILEs
+    std::vector<std::string> checkManifests;
+    bool failFast = false;
+    bool quiet = false;
+    // Whether -a was given rather than the sha256 default
+    bool explicitAlgorithm = false;
+    // Index of reference digests to mark files against, or to build from the FILE lists
+    std::string knownPath;
+    std::string buildKnownPath;
+    bool unknownOnly = false;
+    // Report files with identical content instead of printing digests
+    bool duplicates = false;
+    DedupOptions dedupOptions;
+    // Split files into content-defined chunks and report what they share instead of printing digests
+    bool contentChunks = false;
+    uint32_t cdcAverageSize = DEFAULT_CDC_AVERAGE_SIZE;
+    std::string cdcIndexPath;
+    // Hash a sample of each file rather than all of it
+    bool quick = false;
+    QuickHashOptions quickOptions;
+};
+
+static void printUsage()
+{
+    std::cout << std::format("Usage: {} [OPTION]... [FILE]...\n", PROGRAM_NAME)
+              << "Print digests of each FILE as 'ALGORITHM  DIGEST  PATH' lines, in completion order.\n"
+                 "FILE may be a glob pattern (*, ? and [...]). With no FILE, or when FILE is -,\n"
+                 "read the paths to hash from standard input, one per line.\n"
+                 "Files are hashed on a work-stealing pool, with large files scheduled on their own.\n"
+                 "\n"
+                 "  -a, --algorithm NAME  hash with NAME; may be repeated (default: sha256)\n"
+                 "                        md5, sha1, sha256, sha512, sha3-256, sha3-512, blake2b, blake3, the\n"
+                 "                        non-cryptographic checksums xxh3, xxh128 and crc32c, or all\n"
+                 "  -j, --jobs N          hash up to N files concurrently (default: hardware threads)\n"
+                 "  -r, --recursive       hash every file under directories\n"
+                 "  -s, --summary         print a summary of files, bytes, throughput and arena misses to stderr\n"
+                 "  -p, --pipeline        hash each algorithm of a file on its own thread\n"
+                 "  -b, --buffers N       read buffers in flight per file (default: 4, 0 reads synchronously)\n"
+                 "      --reader BACKEND  how files are read: auto, stream, mmap or io_uring (default: auto);\n"
+                 "                        mmap is never picked unless asked for, since a file truncated while\n"
+                 "                        mapped kills the process\n"
+                 "      --direct          read with O_DIRECT, bypassing the page cache where supported\n"
+                 "      --huge-pages      use huge pages for direct and io_uring read buffers\n"
+                 "      --no-multi-buffer hash the SHA-256 of small files one at a time instead of eight at once\n"
+                 "  -c, --cache FILE      reuse digests of unchanged files from the digest cache FILE\n"
+                 "      --invalidate      drop the cached digests of each FILE instead of hashing it\n"
+                 "      --compact         rewrite the cache without stale entries, then exit\n"
+                 "      --clear-cache     drop every cached digest, then exit\n"
+                 "  -m, --manifest FILE   hash the one FILE in chunks on every job and write a manifest of\n"
+                 "                        chunk digests and their Merkle root to FILE (- for stdout)\n"
+                 "      --chunk-size SIZE chunk size for --manifest, with an optional K, M or G suffix (default: 64M)\n"
+                 "      --verify-manifest FILE\n"
+                 "                        re-hash the chunks of the one FILE and list those that differ from the\n"
+                 "                        manifest FILE\n"
+                 "      --range START:LENGTH\n"
+                 "                        only verify the chunks overlapping LENGTH bytes from START\n"
+                 "      --checkpoint FILE continue hashing the one FILE from the hash state saved in FILE, then save\n"
+                 "                        the state reached; interrupting saves it too, so an interrupted run or a\n"
+                 "                        file that has only been appended to is not read again from the start\n"
+                 "  -C, --check FILE      verify the files listed in the sha256sum, sha512sum or b2sum style\n"
+                 "                        manifest FILE, printing 'PATH: OK', 'FAILED' or 'MISSING' as each\n"
+                 "                        finishes; may be repeated. -a sets the algorithm of untagged lines\n"
+                 "      --fail-fast       stop verifying at the first failed or missing file\n"
+                 "  -q, --quiet           only print files that did not verify\n"
+                 "  -k, --known INDEX     start each line with KNOWN or UNKNOWN, depending on whether any digest of\n"
+                 "                        the file is in the known hash INDEX\n"
+                 "      --unknown-only    with --known, only print files none of whose digests are known\n"
+                 "      --build-known INDEX\n"
+                 "                        write a known hash INDEX of every digest in the lists given as FILEs,\n"
+                 "                        such as sha256sum output or NSRL CSV files, then exit\n"
+                 "  -D, --duplicates      list groups of files under each FILE with identical content, with the\n"
+                 "                        space a single copy would free; only files sharing a size are sampled\n"
+                 "                        at both ends, and only those still alike are hashed in full with the\n"
+                 "                        -a algorithm (default: blake3)\n"
+                 "      --quick           hash only the size, head, tail and --samples evenly spaced blocks of each\n"
+                 "                        FILE; digests are printed as ALGORITHM-SAMPLED, as they are not digests\n"
+                 "                        of the full content and only tell apart files that differ in the samples\n"
+                 "      --samples N       blocks sampled between the head and tail by --quick (default: 16)\n"
+                 "      --sample-size SIZE\n"
+                 "                        bytes per sample for --quick (default: 64K) and at each end of a file\n"
+                 "                        for --duplicates (default: 16K)\n"
+                 "      --min-size SIZE   ignore files smaller than SIZE with --duplicates (default: 1)\n"
+                 "      --cdc             split each FILE into content-defined chunks, hashed with the -a algorithm\n"
+                 "                        (default: blake3), and report how many bytes each shares with the others\n"
+                 "      --cdc-average SIZE\n"
+                 "                        average chunk size for --cdc, a power of two (default: 16K)\n"
+                 "      --cdc-index FILE  also write the offset, length and digest of every chunk to FILE\n"
+                 "  -l, --list FILE       read paths to hash from FILE, one per line (- for stdin)\n"
+                 "  -z, --zero            paths in lists and stdin are NUL separated\n"
+                 "  -h, --help            display this help and exit\n";
+}
+
+// Byte count with an optional binary K, M or G suffix
+static uint64_t parseSize(const std::string_view text, const std::string_view what)
+{
+    size_t used = 0;
+    uint64_t value = 0;
+    try
+    {
+        value = std::stoull(std::string(text), &used);
+    }
+    catch (const std::exception &)
+    {
+        throw std::invalid_argument(std::format("invalid {} '{}'", what, text));
+    }
+
+    const std::string_view suffix = text.substr(used);
+    int shift = 0;
+    if (suffix == "K" || suffix == "k")
+    {
+        shift = 10;
+    }
+    else if (suffix == "M" || suffix == "m")
+    {
+        shift = 20;
+    }
+    else if (suffix == "G" || suffix == "g")
+    {
+        shift = 30;
+    }
+    else if (!suffix.empty() || text.starts_with('-'))
+    {
+        throw std::invalid_argument(std::format("invalid {} '{}'", what, text));
+    }
+    if (value > UINT64_MAX >> shift)
+    {
+        throw std::invalid_argument(std::format("{} '{}' is too large", what, text));
+    }
+    return value << shift;
+}
+
+static std::optional<Options> parseArguments(const int argc, char *argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view argument = argv[i];
+
+        // Fetch the value of an option taking one, either "--opt value" or "--opt=value"
+        auto takeValue = [&](const std::string_view shortName,
+                             const std::string_view longName) -> std::optional<std::string> {
+            if (argument == shortName || argument == longName)
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::invalid_argument(std::format("option '{}' requires an argument", argument));
+                }
+                return argv[++i];
+            }
+            if (argument.starts_with(longName) && argument.size() > longName.size() &&
+                argument[longName.size()] == '=')
+            {
+                return std::string(argument.substr(longName.size() + 1));
+            }
+            return std::nullopt;
+        };
+
+        if (argument == "-h" || argument == "--help")
+        {
+            printUsage();
+            return std::nullopt;
+        }
+        if (argument == "-z" || argument == "--zero")
+        {
+            options.nullSeparated = true;
+        }
+        else if (argument == "-r" || argument == "--recursive")
+        {
+            options.recursive = true;
+        }
+        else if (argument == "-s" || argument == "--summary")
+        {
+            options.summary = true;
+        }
+        else if (argument == "--fail-fast")
+        {
+            options.failFast = true;
+        }
+        else if (argument == "-q" || argument == "--quiet")
+        {
+            options.quiet = true;
+        }
+        else if (argument == "-D" || argument == "--duplicates")
+        {
+            options.duplicates = true;
+            options.recursive = true;
+        }
+        else if (argument == "--quick")
+        {
+            options.quick = true;
+        }
+        else if (argument == "--cdc")
+        {
+            options.contentChunks = true;
+        }
+        else if (argument == "--unknown-only")
+        {
+            options.unknownOnly = true;
+        }
+        else if (argument == "--invalidate")
+        {
+            options.cacheCommand = CacheCommand::Invalidate;
+        }
+        else if (argument == "--compact")
+        {
+            options.cacheCommand = CacheCommand::Compact;
+        }
+        else if (argument == "--clear-cache")
+        {
+            options.cacheCommand = CacheCommand::Clear;
+        }
+        else if (argument == "-p" || argument == "--pipeline")
+        {
+            options.hashOptions.pipelined = true;
+        }
+        else if (argument == "--direct")
+        {
+            options.hashOptions.directIo = true;
+        }
+        else if (argument == "--huge-pages")
+        {
+            options.hashOptions.hugePages = true;
+        }
+        else if (argument == "--no-multi-buffer")
+        {
+            options.hashOptions.multiBuffer = false;
+        }
+        else if (const auto name = takeValue("-a", "--algorithm"))
+        {
+            if (*name == "all")
+            {
+                const std::vector<wc_HashType> all = supportedAlgorithms();
+                options.algorithms.insert(options.algorithms.end(), all.begin(), all.end());
+                continue;
+            }
+            const auto algorithm = algorithmFromName(*name);
+            if (!algorithm)
+            {
+                throw std::invalid_argument(std::format("unknown algorithm '{}'", *name));
+            }
+            options.algorithms.push_back(*algorithm);
+        }
+        else if (const auto jobs = takeValue("-j", "--jobs"))
+        {
+            try
+            {
+                options.jobs = static_cast<unsigned int>(std::stoul(*jobs));
+            }
+            catch (const std::exception &)
+            {
+                options.jobs = 0;
+            }
+            if (options.jobs == 0)
+            {
+                throw std::invalid_argument(std::format("invalid number of jobs '{}'", *jobs));
+            }
+        }
+        else if (const auto buffers = takeValue("-b", "--buffers"))
+        {
+            try
+            {
+                options.hashOptions.bufferCount = std::stoul(*buffers);
+            }
+            catch (const std::exception &)
+            {
+                throw std::invalid_argument(std::format("invalid number of buffers '{}'", *buffers));
+            }
+        }
+        else if (const auto reader = takeValue("--reader", "--reader"))
+        {
+            if (*reader == "auto")
+            {
+                options.hashOptions.reader = ReaderBackend::Auto;
+            }
+            else if (*reader == "stream")
+            {
+                options.hashOptions.reader = ReaderBackend::Stream;
+            }
+            else if (*reader == "mmap")
+            {
+                options.hashOptions.reader = ReaderBackend::Mmap;
+            }
+            else if (*reader == "io_uring")
+            {
+                options.hashOptions.reader = ReaderBackend::IoUring;
+            }
+            else
+            {
+                throw std::invalid_argument(std::format("unknown reader '{}'", *reader));
+            }
+        }
+        else if (const auto cache = takeValue("-c", "--cache"))
+        {
+            options.cachePath = *cache;
+        }
+        else if (const auto manifest = takeValue("-m", "--manifest"))
+        {
+            options.manifestPath = *manifest;
+        }
+        else if (const auto manifest = takeValue("--verify-manifest", "--verify-manifest"))
+        {
+            options.verifyManifestPath = *manifest;
+        }
+        else if (const auto size = takeValue("--chunk-size", "--chunk-size"))
+        {
+            options.chunkSize = parseSize(*size, "chunk size");
+            if (options.chunkSize == 0)
+            {
+                throw std::invalid_argument("chunk size must not be zero");
+            }
+        }
+        else if (const auto range = takeValue("--range", "--range"))
+        {
+            const size_t colon = range->find(':');
+            if (colon == std::string::npos)
+            {
+                throw std::invalid_argument(std::format("invalid range '{}'", *range));
+            }
+            options.rangeOffset = parseSize(std::string_view(*range).substr(0, colon), "range start");
+            options.rangeLength = parseSize(std::string_view(*range).substr(colon + 1), "range length");
+        }
+        else if (const auto manifest = takeValue("-C", "--check"))
+        {
+            options.checkManifests.push_back(*manifest);
+        }
+        else if (const auto checkpoint = takeValue("--checkpoint", "--checkpoint"))
+        {
+            options.checkpointPath = *checkpoint;
+        }
+        else if (const auto size = takeValue("--sample-size", "--sample-size"))
+        {
+            options.dedupOptions.sampleSize = parseSize(*size, "sample size");
+            if (options.dedupOptions.sampleSize == 0)
+            {
+                throw std::invalid_argument("sample size must not be zero");
+            }
+            options.quickOptions.sampleSize = options.dedupOptions.sampleSize;
+        }
+        else if (const auto samples = takeValue("--samples", "--samples"))
+        {
+            try
+            {
+                options.quickOptions.samples = std::stoul(*samples);
+            }
+            catch (const std::exception &)
+            {
+                throw std::invalid_argument(std::format("invalid number of samples '{}'", *samples));
+            }
+        }
+        else if (const auto size = takeValue("--min-size", "--min-size"))
+        {
+            options.dedupOptions.minimumSize = parseSize(*size, "minimum size");
+        }
+        else if (const auto size = takeValue("--cdc-average", "--cdc-average"))
+        {
+            const uint64_t average = parseSize(*size, "average chunk size");
+            options.cdcAverageSize = static_cast<uint32_t>(std::min<uint64_t>(average, UINT32_MAX));
+            ChunkingParameters::forAverage(options.cdcAverageSize);
+        }
+        else if (const auto index = takeValue("--cdc-index", "--cdc-index"))
+        {
+            options.cdcIndexPath = *index;
+        }
+        else if (const auto known = takeValue("-k", "--known"))
+        {
+            options.knownPath = *known;
+        }
+        else if (const auto known = takeValue("--build-known", "--build-known"))
+        {
+            options.buildKnownPath = *known;
+        }
+        else if (const auto list = takeValue("-l", "--list"))
+        {
+            options.listFiles.push_back(*list);
+        }
+        else if (argument.size() > 1 && argument.starts_with('-'))
+        {
+            throw std::invalid_argument(std::format("unrecognized option '{}'", argument));
+        }
+        else
+        {
+            options.operands.emplace_back(argument);
+        }
+    }
+
+    if (options.cacheCommand != CacheCommand::None && options.cachePath.empty())
+    {
+        throw std::invalid_argument("cache commands need a cache given with --cache");
+    }
+
+    if (!options.manifestPath.empty() && !options.verifyManifestPath.empty())
+    {
+        throw std::invalid_argument("--manifest and --verify-manifest cannot be combined");
+    }
+    if ((!options.manifestPath.empty() || !options.verifyManifestPath.empty()) && options.operands.size() != 1)
+    {
+        throw std::invalid_argument("chunk manifests need exactly one FILE");
+    }
+    if (!options.checkpointPath.empty() && options.operands.size() != 1)
+    {
+        throw std::invalid_argument("--checkpoint needs exactly one FILE");
+    }
+    if (!options.checkManifests.empty() && (!options.operands.empty() || !options.listFiles.empty()))
+    {
+        throw std::invalid_argument("--check takes the files to verify from its manifests, not as FILE operands");
+    }
+
+    if (!options.buildKnownPath.empty() && options.operands.empty())
+    {
+        throw std::invalid_argument("--build-known needs the hash lists to read as FILEs");
+    }
+    if (options.unknownOnly && options.knownPath.empty())
+    {
+        throw std::invalid_argument("--unknown-only needs an index given with --known");
+    }
+
+    options.explicitAlgorithm = !options.algorithms.empty();
+    if (options.algorithms.empty())
+    {
+        options.algorithms.push_back(WC_HASH_TYPE_SHA256);
+    }
+    if (options.explicitAlgorithm)
+    {
+        options.dedupOptions.algorithm = options.algorithms.front();
+    }
+    if (!options.cdcIndexPath.empty() && !options.contentChunks)
+    {
+        throw std::invalid_argument("--cdc-index needs --cdc");
+    }
+    // Sampled digests would never match a list of full-content digests, and must not end up in the cache
+    if (options.quick && (!options.knownPath.empty() || !options.cachePath.empty()))
+    {
+        throw std::invalid_argument("--quick cannot be combined with --known or --cache");
+    }
+
+    // Drop repeated algorithms while keeping the order they were given in
+    std::vector<wc_HashType> unique;
+    for (wc_HashType algorithm : options.algorithms)
+    {
+        if (std::ranges::find(unique, algorithm) == unique.end())
+        {
+            unique.push_back(algorithm);
+        }
+    }
+    options.algorithms = std::move(unique);
+
+    return options;
+}
+
+static bool hasWildcard(const std::string_view text)
+{
+    return text.find_first_of("*?[") != std::string_view::npos;
+}
+
+// Match a single path component against a shell style pattern
+static bool matchesPattern(const std::string_view pattern, const std::string_view text)
+{
+    size_t p = 0, t = 0;
+    size_t starPattern = std::string_view::npos, starText = 0;
+
+    while (t < text.size())
+    {
+        if (p < pattern.size() && pattern[p] == '*')
+        {
+            starPattern = p++;
+            starText = t;
+            continue;
+        }
+
+        const size_t classEnd = p + 2 < pattern.size() ? pattern.find(']', p + 2) : std::string_view::npos;
+        if (p < pattern.size() && pattern[p] == '[' && classEnd != std::string_view::npos)
+        {
+            const bool negate = pattern[p + 1] == '!' || pattern[p + 1] == '^';
+            bool matched = false;
+            for (size_t i = p + 1 + (negate ? 1 : 0); i < classEnd; i++)
+            {
+                if (i + 2 < classEnd && pattern[i + 1] == '-')
+                {
+                    matched |= text[t] >= pattern[i] && text[t] <= pattern[i + 2];
+                    i += 2;
+                }
+                else
+                {
+                    matched |= text[t] == pattern[i];
+                }
+            }
+            if (matched != negate)
+            {
+                p = classEnd + 1;
+                t++;
+                continue;
+            }
+        }
+        else if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t]))
+        {
+            p++;
+            t++;
+            continue;
+        }
+
+        // Backtrack to the last star and let it swallow one more character
+        if (starPattern == std::string_view::npos)
+        {
+            return false;
+        }
+        p = starPattern + 1;
+        t = ++starText;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*')
+    {
+        p++;
+    }
+    return p == pattern.size();
+}
+
+// Expand a glob one path component at a time, since shells on Windows leave that to the program
+static std::vector<std::string> expandGlob(const std::string &pattern)
+{
+    const fs::path patternPath(pattern);
+    std::vector<fs::path> matches = {patternPath.root_path()};
+
+    for (const fs::path &component : patternPath.relative_path())
+    {
+        const std::string componentText = component.string();
+        std::vector<fs::path> next;
+
+        for (const fs::path &base : matches)
+        {
+            if (!hasWildcard(componentText))
+            {
+                next.push_back(base / component);
+                continue;
+            }
+
+            std::error_code error;
+            const fs::path directory = base.empty() ? fs::path(".") : base;
+            for (const fs::directory_entry &entry : fs::directory_iterator(directory, error))
+            {
+                const std::string name = entry.path().filename().string();
+                // Hidden entries are only matched by patterns that ask for them
+                if (name.starts_with('.') && !componentText.starts_with('.'))
+                {
+                    continue;
+                }
+                if (matchesPattern(componentText, name))
+                {
+                    next.push_back(base / name);
+                }
+            }
+        }
+        matches = std::move(next);
+    }
+
+    std::vector<std::string> expanded;
+    for (const fs::path &match : matches)
+    {
+        if (fs::exists(match))
+        {
+            expanded.push_back(match.string());
+        }
+    }
+    std::ranges::sort(expanded);
+    return expanded;
+}
+
+// The 'ALGORITHM  DIGEST  PATH' lines of a file, marked KNOWN or UNKNOWN when there is an index to match against
+static std::string formatDigestLines(const Options &options, const std::optional<bool> isKnown,
+                                     const DigestSet &digests, const std::string &path)
+{
+    std::string status;
+    if (isKnown)
+    {
+        if (*isKnown && options.unknownOnly)
+        {
+            return {};
+        }
+        status = *isKnown ? "KNOWN    " : "UNKNOWN  ";
+    }
+
+    std::string lines;
+    for (wc_HashType algorithm : options.algorithms)
+    {
+        lines += std::format("{}{}  {}  {}\n", status, algorithmName(algorithm), digests.hex(algorithm), path);
+    }
+    return lines;
+}
+
+// Write the chunk manifest of a file, printing its root like any other digest
+static int writeManifest(const Options &options, const std::string &path)
+{
+    const ChunkManifest manifest =
+        buildChunkManifest(path, options.algorithms.front(), options.chunkSize, options.hashOptions, options.jobs);
+
+    if (options.manifestPath == "-")
+    {
+        manifest.save(std::cout);
+    }
+    else
+    {
+        std::ofstream output(options.manifestPath, std::ios::binary);
+        manifest.save(output);
+        if (!output.flush())
+        {
+            std::cerr << std::format("{}: {}: Cannot write manifest", PROGRAM_NAME, options.manifestPath) << std::endl;
+            return 1;
+        }
+        std::cout << std::format("{}  {}  {}", algorithmName(manifest.algorithm), toHex(manifest.root), path)
+                  << std::endl;
+    }
+    return 0;
+}
+
+// Check a file against its chunk manifest, listing every chunk that changed
+static int verifyManifest(const Options &options, const std::string &path)
+{
+    std::ifstream input(options.verifyManifestPath, std::ios::binary);
+    if (!input)
+    {
+        std::cerr << std::format("{}: {}: Cannot open manifest", PROGRAM_NAME, options.verifyManifestPath)
+                  << std::endl;
+        return 1;
+    }
+    const ChunkManifest manifest = ChunkManifest::load(input);
+
+    const ChunkVerification verification = verifyChunkManifest(path, manifest, options.hashOptions, options.jobs,
+                                                               options.rangeOffset, options.rangeLength);
+    const uint64_t fileSize = fs::file_size(path);
+    if (verification.sizeChanged)
+    {
+        std::cout << std::format("{}: size changed from {} to {} bytes", path, manifest.fileSize, fileSize)
+                  << std::endl;
+    }
+    for (const size_t chunk : verification.changedChunks)
+    {
+        const uint64_t offset = chunk * manifest.chunkSize;
+        const uint64_t end = std::min(offset + manifest.chunkSize, std::max(fileSize, manifest.fileSize));
+        std::cout << std::format("{}: chunk {} (bytes {}-{}) changed", path, chunk, offset, end - 1) << std::endl;
+    }
+    std::cout << std::format("{}: {}, {} of {} chunks checked", path, verification.ok() ? "OK" : "FAILED",
+                             verification.checkedChunks, manifest.chunkCount())
+              << std::endl;
+    return verification.ok() ? 0 : 1;
+}
+
+// Verify every manifest, streaming a line per file in completion order like sha256sum --check
+static int verifyChecksumManifests(const Options &options, const HashOptions &hashOptions)
+{
+    // Only an algorithm given on the command line overrides what the manifests themselves suggest
+    const std::optional<wc_HashType> algorithm =
+        options.explicitAlgorithm ? std::optional(options.algorithms.front()) : std::nullopt;
+    std::mutex outputMutex;
+    bool hadError = false;
+
+    for (const std::string &manifestPath : options.checkManifests)
+    {
+        std::ifstream input(manifestPath, std::ios::binary);
+        if (!input)
+        {
+            std::cerr << std::format("{}: {}: Cannot open manifest", PROGRAM_NAME, manifestPath) << std::endl;
+            hadError = true;
+            continue;
+        }
+        const ChecksumManifest manifest = parseChecksumManifest(input, manifestPath, algorithm);
+
+        const VerifySummary summary = verifyChecksums(
+            manifest, {}, hashOptions, options.jobs, options.failFast, [&](const ChecksumResult &result) {
+                if (options.quiet && result.status == ChecksumStatus::Ok)
+                {
+                    return;
+                }
+                constexpr std::string_view STATUS_NAMES[] = {"OK", "FAILED", "MISSING"};
+                std::string line = std::format("{}: {}", result.entry->path,
+                                               STATUS_NAMES[static_cast<size_t>(result.status)]);
+                if (!result.error.empty())
+                {
+                    line += std::format(" ({})", result.error);
+                }
+
+                std::lock_guard lock(outputMutex);
+                std::cout << line << '\n' << std::flush;
+            });
+
+        if (manifest.malformedLines > 0)
+        {
+            std::cerr << std::format("{}: {}: {} improperly formatted lines", PROGRAM_NAME, manifestPath,
+                                     manifest.malformedLines)
+                      << std::endl;
+        }
+        if (summary.failed > 0 || summary.missing > 0)
+        {
+            std::cerr << std::format("{}: {}: {} of {} files FAILED, {} MISSING{}", PROGRAM_NAME, manifestPath,
+                                     summary.failed, manifest.entries.size(), summary.missing,
+                                     summary.stopped ? ", stopped at the first failure" : "")
+                      << std::endl;
+        }
+        hadError |= summary.failed > 0 || summary.missing > 0 || manifest.malformedLines > 0 ||
+                    manifest.entries.empty();
+        if (options.failFast && hadError)
+        {
+            break;
+        }
+    }
+    return hadError ? 1 : 0;
+}
+
+// Print each group of duplicates, largest savings first, then what removing the extra copies would free
+static int printDuplicates(const Options &options, const HashOptions &hashOptions,
+                           const std::vector<std::string> &roots)
+{
+    const DedupSummary summary = findDuplicates(roots, options.dedupOptions, hashOptions, options.jobs);
+
+    for (const DedupError &error : summary.errors)
+    {
+        std::cerr << std::format("{}: {}: {}", PROGRAM_NAME, error.path, error.message) << std::endl;
+    }
+    for (const DuplicateGroup &group : summary.groups)
+    {
+        std::cout << std::format("{} files of {} bytes, {} reclaimable, {}  {}\n", group.paths.size(), group.size,
+                                 group.reclaimableBytes(), algorithmName(options.dedupOptions.algorithm),
+                                 toHex(group.digest));
+        for (const std::string &path : group.paths)
+        {
+            std::cout << path << '\n';
+        }
+        std::cout << '\n';
+    }
+    std::cout << std::flush;
+
+    const double megabytes = static_cast<double>(summary.bytesRead) / (1024 * 1024);
+    std::cerr << std::format("{}: {} duplicate groups, {} bytes reclaimable", PROGRAM_NAME, summary.groups.size(),
+                             summary.reclaimableBytes)
+              << std::endl;
+    if (options.summary)
+    {
+        std::cerr << std::format("{}: {} files, {} hard links, {} sharing a size, {} sharing both ends, "
+                                 "{:.2f} MB read in {:.2f} s",
+                                 PROGRAM_NAME, summary.files, summary.hardLinks, summary.sizeCandidates,
+                                 summary.sampleCandidates, megabytes, summary.seconds)
+                  << std::endl;
+    }
+    return summary.errors.empty() ? 0 : 1;
+}
+
+// Chunk every file, then report per file and overall how much chunk level deduplication would save
+static int reportSharedChunks(const Options &options, const HashOptions &hashOptions,
+                              const std::vector<std::string> &paths)
+{
+    const ChunkingParameters parameters = ChunkingParameters::forAverage(options.cdcAverageSize);
+    const wc_HashType algorithm = options.explicitAlgorithm ? options.algorithms.front() : HASH_TYPE_BLAKE3;
+    const std::vector<ContentChunks> files =
+        chunkFiles(paths, algorithm, parameters, hashOptions, options.jobs);
+
+    bool hadError = false;
+    for (const ContentChunks &file : files)
+    {
+        if (!file.error.empty())
+        {
+            std::cerr << std::format("{}: {}: {}", PROGRAM_NAME, file.path, file.error) << std::endl;
+            hadError = true;
+        }
+    }
+
+    if (!options.cdcIndexPath.empty())
+    {
+        std::ofstream output(options.cdcIndexPath, std::ios::binary);
+        saveChunkIndex(output, files, parameters);
+        if (!output.flush())
+        {
+            std::cerr << std::format("{}: {}: Cannot write chunk index", PROGRAM_NAME, options.cdcIndexPath)
+                      << std::endl;
+            hadError = true;
+        }
+    }
+
+    auto percent = [](const uint64_t part, const uint64_t whole) {
+        return whole > 0 ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+    };
+    const SharedBytesReport report = compareChunks(files);
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (!files[i].error.empty())
+        {
+            continue;
+        }
+        const ChunkSharing &sharing = report.files[i];
+        std::cout << std::format("{}: {} bytes in {} chunks, {} ({:.1f}%) shared with other files, {} ({:.1f}%) "
+                                 "repeated within the file\n",
+                                 files[i].path, sharing.bytes, files[i].chunkCount(), sharing.sharedBytes,
+                                 percent(sharing.sharedBytes, sharing.bytes), sharing.repeatedBytes,
+                                 percent(sharing.repeatedBytes, sharing.bytes));
+    }
+    const uint64_t savedBytes = report.totalBytes - report.uniqueBytes;
+    std::cout << std::format("total: {} bytes, {} unique, {} ({:.1f}%) saved by storing each chunk once",
+                             report.totalBytes, report.uniqueBytes, savedBytes,
+                             percent(savedBytes, report.totalBytes))
+              << std::endl;
+    return hadError ? 1 : 0;
+}
+
+// Index every digest in the hash lists
+static int buildKnownIndex(const Options &options)
+{
+    const KnownBuildSummary summary = KnownHashes::build(options.operands, options.buildKnownPath);
+    std::cerr << std::format("{}: indexed {} digests, {} duplicates, {} lines without a digest", PROGRAM_NAME,
+                             summary.digests, summary.duplicates, summary.skippedLines)
+              << std::endl;
+    return 0;
+}
+
+static std::atomic interrupted(false);
+
+// Hash a file from its checkpoint, saving the state reached even if interrupted
+static int hashWithCheckpoint(const Options &options, HashOptions hashOptions, const KnownHashes *known,
+                              const std::string &path)
+{
+    HashCheckpoint checkpoint;
+    if (std::ifstream input(options.checkpointPath, std::ios::binary); input)
+    {
+        checkpoint = HashCheckpoint::load(input);
+    }
+    hashOptions.checkpoint = &checkpoint;
+
+    std::signal(SIGINT, [](int) { interrupted.store(true); });
+    const DigestSet digests = calculateDigests(path, options.algorithms, hashOptions, interrupted);
+    std::signal(SIGINT, SIG_DFL);
+
+    // A cache hit never opens the file, leaving no state to save
+    if (!checkpoint.states.empty())
+    {
+        std::ofstream output(options.checkpointPath, std::ios::binary);
+        checkpoint.save(output);
+        if (!output.flush())
+        {
+            std::cerr << std::format("{}: {}: Cannot write checkpoint", PROGRAM_NAME, options.checkpointPath)
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    if (digests.empty())
+    {
+        std::cerr << std::format("{}: {}: interrupted after {} bytes, checkpoint saved", PROGRAM_NAME, path,
+                                 checkpoint.offset)
+                  << std::endl;
+        return 130;
+    }
+    const std::optional<bool> isKnown = known ? std::optional(known->containsAny(digests)) : std::nullopt;
+    std::cout << formatDigestLines(options, isKnown, digests, path) << std::flush;
+    return 0;
+}
+
+static void readPathList(std::istream &input, const bool nullSeparated, std::vector<std::string> &paths)
+{
+    std::string line;
+    while (std::getline(input, line, nullSeparated ? '\0' : '\n'))
+    {
+        if (!nullSeparated && line.ends_with('\r'))
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            paths.push_back(line);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::optional<Options> parsed;
+    try
+    {
+        parsed = parseArguments(argc, argv);
+    }
+    catch (const std::invalid_argument &exception)
+    {
+        std::cerr << std::format("{}: {}\nTry '{} --help' for more information.", PROGRAM_NAME, exception.what(),
+                                 PROGRAM_NAME)
+                  << std::endl;
+        return 2;
+    }
+    if (!parsed)
+    {
+        return 0;
+    }
+    const Options &options = *parsed;
+
+    std::atomic hadError(false);
+    std::mutex outputMutex;
+
+    auto reportError = [&](const std::string &path, const std::string_view message) {
+        std::lock_guard lock(outputMutex);
+        std::cerr << std::format("{}: {}: {}", PROGRAM_NAME, path, message) << std::endl;
+        hadError.store(true);
+    };
+
+    std::unique_ptr<DigestCache> cache;
+    HashOptions hashOptions = options.hashOptions;
+    if (!options.cachePath.empty())
+    {
+        try
+        {
+            cache = std::make_unique<DigestCache>(options.cachePath);
+        }
+        catch (const std::exception &exception)
+        {
+            reportError(options.cachePath, exception.what());
+            return 1;
+        }
+        hashOptions.cache = cache.get();
+    }
+
+    if (options.cacheCommand == CacheCommand::Compact)
+    {
+        const CompactResult result = cache->compact();
+        std::cerr << std::format("{}: kept {} cache entries, dropped {}", PROGRAM_NAME, result.kept, result.dropped)
+                  << std::endl;
+        return 0;
+    }
+    if (options.cacheCommand == CacheCommand::Clear)
+    {
+        cache->clear();
+        return 0;
+    }
+
+    if (!options.buildKnownPath.empty())
+    {
+        try
+        {
+            return buildKnownIndex(options);
+        }
+        catch (const std::exception &exception)
+        {
+            reportError(options.buildKnownPath, exception.what());
+            return 1;
+        }
+    }
+
+    std::unique_ptr<KnownHashes> known;
+    if (!options.knownPath.empty())
+    {
+        try
+        {
+            known = std::make_unique<KnownHashes>(options.knownPath);
+        }
+        catch (const std::exception &exception)
+        {
+            reportError(options.knownPath, exception.what());
+            return 1;
+        }
+    }
+
+    if (!options.manifestPath.empty() || !options.verifyManifestPath.empty())
+    {
+        const std::string &path = options.operands.front();
+        try
+        {
+            return options.manifestPath.empty() ? verifyManifest(options, path) : writeManifest(options, path);
+        }
+        catch (const std::exception &exception)
+        {
+            reportError(path, exception.what());
+            return 1;
+        }
+    }
+    if (!options.checkManifests.empty())
+    {
+        return verifyChecksumManifests(options, hashOptions);
+    }
+    if (!options.checkpointPath.empty())
+    {
+        const std::string &path = options.operands.front();
+        try
+        {
+            return hashWithCheckpoint(options, hashOptions, known.get(), path);
+        }
+        catch (const std::exception &exception)
+        {
+            reportError(path, exception.what());
+            return 1;
+        }
+    }
+
+    // Gather every path up front so workers can pull from a flat list
+    std::vector<std::string> paths;
+    bool readStdin = options.operands.empty() && options.listFiles.empty();
+    for (const std::string &list : options.listFiles)
+    {
+        if (list == "-")
+        {
+            readStdin = true;
+            continue;
+        }
+        std::ifstream listFile(list, std::ios::binary);
+        if (!listFile)
+        {
+            reportError(list, "Cannot open file list");
+            continue;
+        }
+        readPathList(listFile, options.nullSeparated, paths);
+    }
+    for (const std::string &operand : options.operands)
+    {
+        if (operand == "-")
+        {
+            readStdin = true;
+        }
+        else if (hasWildcard(operand) && !fs::exists(operand))
+        {
+            const std::vector<std::string> expanded = expandGlob(operand);
+            if (expanded.empty())
+            {
+                reportError(operand, "No match");
+            }
+            paths.insert(paths.end(), expanded.begin(), expanded.end());
+        }
+        else
+        {
+            paths.push_back(operand);
+        }
+    }
+    if (readStdin)
+    {
+        readPathList(std::cin, options.nullSeparated, paths);
+    }
+
+    // Directories are only walked when asked to, like cp and friends
+    std::vector<std::string> roots;
+    for (const std::string &path : paths)
+    {
+        std::error_code error;
+        if (!options.recursive && fs::is_directory(path, error))
+        {
+            reportError(path, "Is a directory");
+            continue;
+        }
+        if (!fs::exists(path, error))
+        {
+            reportError(path, "No such file or directory");
+            continue;
+        }
+        roots.push_back(path);
+    }
+
+    if (options.quick)
+    {
+        // Sampled digests are tagged so they are never mistaken for, or checked against, full-content ones
+        size_t files = 0;
+        size_t completeFiles = 0;
+        uint64_t sampledBytes = 0;
+        uint64_t fileBytes = 0;
+        auto hashSampled = [&](const std::string &path) {
+            try
+            {
+                const QuickHashResult result = calculateQuickDigests(path, options.algorithms, options.quickOptions,
+                                                                     hashOptions, options.jobs);
+                std::string lines;
+                for (const wc_HashType algorithm : options.algorithms)
+                {
+                    lines += std::format("{}-SAMPLED  {}  {}\n", algorithmName(algorithm),
+                                         result.digests.hex(algorithm), path);
+                }
+                std::cout << lines << std::flush;
+                files++;
+                completeFiles += result.complete ? 1 : 0;
+                sampledBytes += result.sampledBytes;
+                fileBytes += result.fileSize;
+            }
+            catch (const std::exception &exception)
+            {
+                reportError(path, exception.what());
+            }
+        };
+        for (const std::string &root : roots)
+        {
+            std::error_code error;
+            if (!fs::is_directory(root, error))
+            {
+                hashSampled(root);
+                continue;
+            }
+            for (auto entry = fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied,
+                                                               error);
+                 entry != fs::recursive_directory_iterator(); entry.increment(error))
+            {
+                if (entry->is_regular_file(error))
+                {
+                    hashSampled(entry->path().string());
+                }
+            }
+        }
+        if (options.summary)
+        {
+            std::cerr << std::format("{} files sampled ({} read whole), {} of {} bytes read; sampled digests are not "
+                                     "full-content digests",
+                                     files, completeFiles, sampledBytes, fileBytes)
+                      << std::endl;
+        }
+        return hadError.load() ? 1 : 0;
+    }
+
+    if (options.contentChunks)
+    {
+        try
+        {
+            return reportSharedChunks(options, hashOptions, roots) != 0 || hadError.load() ? 1 : 0;
+        }
+        catch (const std::exception &exception)
+        {
+            std::cerr << std::format("{}: {}", PROGRAM_NAME, exception.what()) << std::endl;
+            return 1;
+        }
+    }
+
+    if (options.duplicates)
+    {
+        try
+        {
+            return printDuplicates(options, hashOptions, roots) != 0 || hadError.load() ? 1 : 0;
+        }
+        catch (const std::exception &exception)
+        {
+            std::cerr << std::format("{}: {}", PROGRAM_NAME, exception.what()) << std::endl;
+            return 1;
+        }
+    }
+
+    if (options.cacheCommand == CacheCommand::Invalidate)
+    {
+        auto invalidate = [&](const std::string &path) {
+            if (!cache->invalidate(path))
+            {
+                reportError(path, "Not a regular file");
+            }
+        };
+        for (const std::string &root : roots)
+        {
+            std::error_code error;
+            if (!fs::is_directory(root, error))
+            {
+                invalidate(root);
+                continue;
+            }
+            for (auto entry = fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied,
+                                                               error);
+                 entry != fs::recursive_directory_iterator(); entry.increment(error))
+            {
+                if (entry->is_regular_file(error))
+                {
+                    invalidate(entry->path().string());
+                }
+            }
+        }
+        return hadError.load() ? 1 : 0;
+    }
+
+    std::atomic<uint64_t> knownFiles = 0;
+    const TreeSummary summary = hashTree(
+        roots, options.algorithms, hashOptions, options.jobs, [&](const FileHashResult &result) {
+            if (!result.error.empty())
+            {
+                reportError(result.path, result.error);
+                return;
+            }
+
+            const std::optional<bool> isKnown =
+                known ? std::optional(known->containsAny(result.digests)) : std::nullopt;
+            if (isKnown.value_or(false))
+            {
+                knownFiles.fetch_add(1);
+            }
+            // Build every line for the file first so output from different files never interleaves
+            const std::string lines = formatDigestLines(options, isKnown, result.digests, result.path);
+
+            std::lock_guard lock(outputMutex);
+            std::cout << lines << std::flush;
+        });
+
+    if (options.summary)
+    {
+        const double megabytes = static_cast<double>(summary.bytes) / (1024 * 1024);
+        const uint64_t hashed = summary.files + summary.failed;
+        std::cerr << std::format("{}: {} files, {} failed, {:.2f} MB in {:.2f} s ({:.2f} MB/s)", PROGRAM_NAME,
+                                 summary.files, summary.failed, megabytes, summary.seconds,
+                                 summary.seconds > 0 ? megabytes / summary.seconds : 0.0)
+                  << (known ? std::format(", {} known", knownFiles.load()) : "")
+                  << std::format(", {:.3f} arena misses per file",
+                                 hashed > 0 ? static_cast<double>(summary.arenaMisses) / hashed : 0.0)
+                  << std::endl;
+    }
+
+    return hadError.load() ? 1 : 0;
+}
\ No newline at end of file
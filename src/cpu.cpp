@@ -0,0 +1,81 @@
+#include "cpu.h"
+
+#include <cstdlib>
+#include <string_view>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace
+{
+CpuFeatures detect()
+{
+    CpuFeatures features;
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    // libgcc's checks include whether the OS has enabled the AVX and AVX-512 register state
+    __builtin_cpu_init();
+    features.sse41 = __builtin_cpu_supports("sse4.1");
+    features.sse42 = __builtin_cpu_supports("sse4.2");
+    features.pclmul = __builtin_cpu_supports("pclmul");
+    features.avx2 = __builtin_cpu_supports("avx2");
+    features.avx512f = __builtin_cpu_supports("avx512f");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 1);
+    features.sse41 = (info[2] & (1 << 19)) != 0;
+    features.sse42 = (info[2] & (1 << 20)) != 0;
+    features.pclmul = (info[2] & (1 << 1)) != 0;
+    const bool osSavesState = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const unsigned long long enabledState = osSavesState ? _xgetbv(0) : 0;
+
+    __cpuidex(info, 7, 0);
+    // XMM and YMM state for AVX2, plus the opmask and ZMM state for AVX-512
+    features.avx2 = avx && (enabledState & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+    features.avx512f = (enabledState & 0xe6) == 0xe6 && (info[1] & (1 << 16)) != 0;
+#endif
+
+    const char *disabled = std::getenv("HASHER_CPU_DISABLE");
+    if (disabled != nullptr)
+    {
+        std::string_view remaining = disabled;
+        while (!remaining.empty())
+        {
+            const size_t comma = remaining.find(',');
+            const std::string_view name = remaining.substr(0, comma);
+            remaining = comma == std::string_view::npos ? std::string_view{} : remaining.substr(comma + 1);
+
+            if (name == "sse4.1" || name == "sse41")
+            {
+                features.sse41 = false;
+            }
+            else if (name == "sse4.2" || name == "sse42")
+            {
+                features.sse42 = false;
+            }
+            else if (name == "pclmul")
+            {
+                features.pclmul = false;
+            }
+            else if (name == "avx2")
+            {
+                features.avx2 = false;
+            }
+            else if (name == "avx512f" || name == "avx512")
+            {
+                features.avx512f = false;
+            }
+        }
+    }
+    return features;
+}
+} // namespace
+
+const CpuFeatures &cpuFeatures()
+{
+    static const CpuFeatures features = detect();
+    return features;
+}
\ No newline at end of file
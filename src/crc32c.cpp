@@ -0,0 +1,69 @@
+#include "crc32c.h"
+#include "cpu.h"
+#include "crc32c_impl.h"
+
+#include <array>
+
+namespace
+{
+// Slicing-by-8: TABLES[k][b] is the CRC of byte b followed by k zero bytes, so eight bytes take eight lookups
+constexpr std::array<std::array<uint32_t, 256>, 8> TABLES = []() {
+    std::array<std::array<uint32_t, 256>, 8> tables{};
+    for (uint32_t byte = 0; byte < 256; byte++)
+    {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ ((crc & 1) != 0 ? CRC32C_POLYNOMIAL : 0);
+        }
+        tables[0][byte] = crc;
+    }
+    for (size_t k = 1; k < 8; k++)
+    {
+        for (size_t byte = 0; byte < 256; byte++)
+        {
+            tables[k][byte] = (tables[k - 1][byte] >> 8) ^ tables[0][tables[k - 1][byte] & 0xff];
+        }
+    }
+    return tables;
+}();
+
+uint32_t crc32cPortable(uint32_t crc, const uint8_t *data, size_t length)
+{
+    for (; length >= 8; data += 8, length -= 8)
+    {
+        const uint32_t low = crc ^ (uint32_t{data[0]} | uint32_t{data[1]} << 8 | uint32_t{data[2]} << 16 |
+                                    uint32_t{data[3]} << 24);
+        crc = TABLES[7][low & 0xff] ^ TABLES[6][(low >> 8) & 0xff] ^ TABLES[5][(low >> 16) & 0xff] ^
+              TABLES[4][low >> 24] ^ TABLES[3][data[4]] ^ TABLES[2][data[5]] ^ TABLES[1][data[6]] ^
+              TABLES[0][data[7]];
+    }
+    for (; length > 0; data++, length--)
+    {
+        crc = (crc >> 8) ^ TABLES[0][(crc ^ *data) & 0xff];
+    }
+    return crc;
+}
+} // namespace
+
+void Crc32c::update(const uint8_t *input, const size_t size)
+{
+#ifdef HASHER_HAVE_CRC32C_X86
+    const CpuFeatures &cpu = cpuFeatures();
+    if (cpu.sse42 && cpu.pclmul)
+    {
+        this->crc = crc32cSse42(this->crc, input, size);
+        return;
+    }
+#endif
+    this->crc = crc32cPortable(this->crc, input, size);
+}
+
+void Crc32c::finalize(uint8_t *output) const
+{
+    const uint32_t value = ~this->crc;
+    for (size_t i = 0; i < CRC32C_OUT_LEN; i++)
+    {
+        output[i] = static_cast<uint8_t>(value >> (24 - 8 * i));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "crc32c_impl.h"
+
+#ifdef HASHER_HAVE_CRC32C_X86
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+// The crc32 instruction takes three cycles but a new one can start every cycle, so three streams of a block each are
+// run side by side and then combined. Long blocks for the bulk, short ones for what is left after them
+constexpr size_t LONG_BLOCK = 8192;
+constexpr size_t SHORT_BLOCK = 256;
+
+// Multiplier that moves a CRC over bytes bytes of zeros. A carry-less multiply of the bit-reversed CRC by K followed
+// by a crc32 of the 64-bit product gives CRC * K * x^33 mod P, so K is x^(8 * bytes - 33) mod P
+constexpr uint32_t shiftConstant(const size_t bytes)
+{
+    uint32_t value = 0x80000000; // x^0
+    for (size_t i = 0; i < 8 * bytes - 33; i++)
+    {
+        value = (value >> 1) ^ ((value & 1) != 0 ? CRC32C_POLYNOMIAL : 0);
+    }
+    return value;
+}
+
+uint64_t load64(const uint8_t *data)
+{
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint64_t multiply(const uint64_t crc, const uint32_t constant)
+{
+    const __m128i product = _mm_clmulepi64_si128(_mm_cvtsi64_si128(static_cast<long long>(crc)),
+                                                 _mm_cvtsi32_si128(static_cast<int>(constant)), 0);
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+}
+
+template <size_t Block>
+uint32_t crcStreams(uint64_t crc, const uint8_t *&data, size_t &length)
+{
+    constexpr uint32_t SHIFT_ONE = shiftConstant(Block);
+    constexpr uint32_t SHIFT_TWO = shiftConstant(2 * Block);
+
+    for (; length >= 3 * Block; data += 3 * Block, length -= 3 * Block)
+    {
+        uint64_t first = crc;
+        uint64_t second = 0;
+        uint64_t third = 0;
+        for (size_t i = 0; i < Block; i += 8)
+        {
+            first = _mm_crc32_u64(first, load64(data + i));
+            second = _mm_crc32_u64(second, load64(data + Block + i));
+            third = _mm_crc32_u64(third, load64(data + 2 * Block + i));
+        }
+        crc = _mm_crc32_u64(0, multiply(first, SHIFT_TWO) ^ multiply(second, SHIFT_ONE)) ^ third;
+    }
+    return static_cast<uint32_t>(crc);
+}
+} // namespace
+
+uint32_t crc32cSse42(uint32_t crc, const uint8_t *data, size_t length)
+{
+    crc = crcStreams<LONG_BLOCK>(crc, data, length);
+    crc = crcStreams<SHORT_BLOCK>(crc, data, length);
+
+    uint64_t value = crc;
+    for (; length >= 8; data += 8, length -= 8)
+    {
+        value = _mm_crc32_u64(value, load64(data));
+    }
+    crc = static_cast<uint32_t>(value);
+    for (; length > 0; data++, length--)
+    {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+#endif
\ No newline at end of file
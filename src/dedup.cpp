@@ -0,0 +1,350 @@
+#include "dedup.h"
+#include "pool.h"
+#include "reader.h"
+#include "tree.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <tuple>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#define HASHER_HAVE_INODES
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// Files whose ends are sampled are handed out in batches, since each one is only a couple of small reads
+constexpr size_t BATCH_FILES = 64;
+
+struct Candidate
+{
+    std::string path;
+    uint64_t size = 0;
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    // Digest of both ends, or of the whole file once complete
+    std::vector<byte> digest;
+    bool complete = false;
+    bool failed = false;
+};
+
+bool isCancelled(const std::optional<std::reference_wrapper<const std::atomic<bool>>> &shouldCancel)
+{
+    return shouldCancel && shouldCancel->get().load();
+}
+
+// Stage one: every regular file under the roots, listed in parallel
+class Listing
+{
+    WorkStealingPool &pool;
+    const DedupOptions &dedupOptions;
+    std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel;
+    std::mutex mutex;
+    DirectoryWalkCallbacks callbacks;
+
+    void addFile(std::vector<Candidate> &found, const fs::path &path)
+    {
+        Candidate candidate;
+        candidate.path = path.string();
+#ifdef HASHER_HAVE_INODES
+        struct stat status{};
+        if (stat(candidate.path.c_str(), &status) != 0)
+        {
+            this->reportError(path, std::error_code(errno, std::generic_category()));
+            return;
+        }
+        candidate.size = static_cast<uint64_t>(status.st_size);
+        candidate.device = static_cast<uint64_t>(status.st_dev);
+        candidate.inode = static_cast<uint64_t>(status.st_ino);
+#else
+        std::error_code error;
+        candidate.size = fs::file_size(path, error);
+        if (error)
+        {
+            this->reportError(path, error);
+            return;
+        }
+#endif
+        if (candidate.size >= this->dedupOptions.minimumSize)
+        {
+            found.push_back(std::move(candidate));
+        }
+    }
+
+    void reportError(const fs::path &path, const std::error_code &error)
+    {
+        std::lock_guard lock(this->mutex);
+        this->errors.push_back({path.string(), error.message()});
+    }
+
+    void addDirectoryFiles(const std::span<const fs::directory_entry> entries)
+    {
+        std::vector<Candidate> found;
+        for (const fs::directory_entry &entry : entries)
+        {
+            this->addFile(found, entry.path());
+        }
+
+        std::lock_guard lock(this->mutex);
+        std::ranges::move(found, std::back_inserter(this->files));
+    }
+
+  public:
+    std::vector<Candidate> files;
+    std::vector<DedupError> errors;
+
+    Listing(WorkStealingPool &pool, const DedupOptions &dedupOptions,
+            const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+        : pool(pool), dedupOptions(dedupOptions), shouldCancel(shouldCancel),
+          callbacks{
+              .onFiles = [this](const std::span<const fs::directory_entry> entries) {
+                  this->addDirectoryFiles(entries);
+              },
+              .onError = [this](const fs::path &path, const std::error_code &error) { this->reportError(path, error); },
+              .isCancelled = [this]() { return isCancelled(this->shouldCancel); },
+          }
+    {
+    }
+
+    void addRoots(const std::vector<std::string> &roots)
+    {
+        std::vector<Candidate> found;
+        for (const std::string &root : roots)
+        {
+            std::error_code error;
+            if (fs::is_directory(root, error))
+            {
+                walkDirectoryTree(this->pool, root, this->callbacks);
+            }
+            else
+            {
+                this->addFile(found, root);
+            }
+        }
+
+        std::lock_guard lock(this->mutex);
+        std::ranges::move(found, std::back_inserter(this->files));
+    }
+};
+
+// Call function with every run of at least two consecutive candidates that equal compares alike
+template <class Equal, class Function>
+void forEachRun(const std::vector<Candidate *> &candidates, Equal &&equal, Function &&function)
+{
+    for (size_t first = 0; first < candidates.size();)
+    {
+        size_t last = first + 1;
+        while (last < candidates.size() && equal(*candidates[first], *candidates[last]))
+        {
+            last++;
+        }
+        if (last - first > 1)
+        {
+            function(std::span(candidates).subspan(first, last - first));
+        }
+        first = last;
+    }
+}
+
+// Run function on every candidate on the pool, batch at a time
+template <class Function>
+void forEachParallel(WorkStealingPool &pool, const std::vector<Candidate *> &candidates, const size_t batch,
+                     Function &&function)
+{
+    for (size_t first = 0; first < candidates.size(); first += batch)
+    {
+        const size_t last = std::min(first + batch, candidates.size());
+        pool.submit([&, first, last]() {
+            for (size_t i = first; i < last; i++)
+            {
+                function(*candidates[i]);
+            }
+        });
+    }
+    pool.wait();
+}
+
+bool bySizeAndDigest(const Candidate *left, const Candidate *right)
+{
+    return std::tie(left->size, left->digest) < std::tie(right->size, right->digest);
+}
+
+bool sameSizeAndDigest(const Candidate &left, const Candidate &right)
+{
+    return left.size == right.size && left.digest == right.digest;
+}
+} // namespace
+
+DedupSummary findDuplicates(const std::vector<std::string> &roots, const DedupOptions &dedupOptions,
+                            const HashOptions &options, const size_t jobs,
+                            const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+{
+    const auto start = std::chrono::steady_clock::now();
+    DedupSummary summary;
+    WorkStealingPool pool(std::max<size_t>(jobs, 1));
+    std::mutex errorMutex;
+    std::atomic<uint64_t> bytesRead = 0;
+
+    auto finish = [&]() {
+        summary.bytesRead = bytesRead.load();
+        summary.cancelled = isCancelled(shouldCancel);
+        if (summary.cancelled)
+        {
+            summary.groups.clear();
+        }
+        for (const DuplicateGroup &group : summary.groups)
+        {
+            summary.reclaimableBytes += group.reclaimableBytes();
+        }
+        summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return summary;
+    };
+    auto fail = [&](Candidate &candidate, const std::string &message) {
+        candidate.failed = true;
+        std::lock_guard lock(errorMutex);
+        summary.errors.push_back({candidate.path, message});
+    };
+
+    // Stage one: list the tree and keep the sizes seen more than once
+    Listing listing(pool, dedupOptions, shouldCancel);
+    listing.addRoots(roots);
+    pool.wait();
+    summary.errors = std::move(listing.errors);
+    std::vector<Candidate> &files = listing.files;
+    summary.files = files.size();
+
+    // Names of one inode hold the same bytes without taking space twice, so only the first is kept
+    std::vector<Candidate *> candidates;
+    candidates.reserve(files.size());
+    for (Candidate &file : files)
+    {
+        candidates.push_back(&file);
+    }
+#ifdef HASHER_HAVE_INODES
+    std::ranges::sort(candidates, [](const Candidate *left, const Candidate *right) {
+        return std::tie(left->device, left->inode, left->path) < std::tie(right->device, right->inode, right->path);
+    });
+    const auto [linked, linkedEnd] = std::ranges::unique(candidates, [](const Candidate *left, const Candidate *right) {
+        return left->device == right->device && left->inode == right->inode;
+    });
+    summary.hardLinks = static_cast<uint64_t>(linkedEnd - linked);
+    candidates.erase(linked, linkedEnd);
+#endif
+
+    std::ranges::sort(candidates, bySizeAndDigest);
+    std::vector<Candidate *> sameSize;
+    forEachRun(candidates, [](const Candidate &left, const Candidate &right) { return left.size == right.size; },
+               [&](const std::span<Candidate *const> run) { sameSize.insert(sameSize.end(), run.begin(), run.end()); });
+    summary.sizeCandidates = sameSize.size();
+    if (isCancelled(shouldCancel))
+    {
+        return finish();
+    }
+
+    // Stage two: hash the first and last sampleSize bytes, or the whole file if that would cover it anyway
+    forEachParallel(pool, sameSize, BATCH_FILES, [&](Candidate &candidate) {
+        if (isCancelled(shouldCancel))
+        {
+            return;
+        }
+        const uint64_t sample = dedupOptions.sampleSize;
+        candidate.complete = candidate.size <= 2 * sample;
+        try
+        {
+            Hasher hasher(dedupOptions.algorithm);
+            auto hashRange = [&](const uint64_t offset, const uint64_t length) {
+                const FileReaderPtr reader = openFileRangeReader(candidate.path, offset, length, options);
+                while (!reader->finished())
+                {
+                    const std::span<const byte> data = reader->read(0);
+                    hasher.updateWithBuffer(data.data(), static_cast<word32>(data.size()));
+                    bytesRead.fetch_add(data.size(), std::memory_order_relaxed);
+                }
+            };
+            if (candidate.complete)
+            {
+                hashRange(0, candidate.size);
+            }
+            else
+            {
+                hashRange(0, sample);
+                hashRange(candidate.size - sample, sample);
+            }
+            hasher.finalize();
+            candidate.digest.assign(hasher.getRawDigest().begin(), hasher.getRawDigest().end());
+        }
+        catch (const std::exception &exception)
+        {
+            fail(candidate, exception.what());
+        }
+    });
+    if (isCancelled(shouldCancel))
+    {
+        return finish();
+    }
+
+    // Files read whole are done, the rest still alike go on to a full hash
+    std::erase_if(sameSize, [](const Candidate *candidate) { return candidate->failed; });
+    std::ranges::sort(sameSize, bySizeAndDigest);
+    std::vector<Candidate *> sameEnds;
+    std::vector<Candidate *> confirmed;
+    forEachRun(sameSize, sameSizeAndDigest, [&](const std::span<Candidate *const> run) {
+        std::vector<Candidate *> &next = run.front()->complete ? confirmed : sameEnds;
+        next.insert(next.end(), run.begin(), run.end());
+    });
+    summary.sampleCandidates = sameEnds.size() + confirmed.size();
+
+    // Stage three: hash the remaining files in full, each on its own since they are the big ones
+    forEachParallel(pool, sameEnds, 1, [&](Candidate &candidate) {
+        if (isCancelled(shouldCancel))
+        {
+            return;
+        }
+        try
+        {
+            const DigestSet digests = calculateDigests(candidate.path, {dedupOptions.algorithm}, options, shouldCancel);
+            if (digests.empty())
+            {
+                // Cancelled part way
+                return;
+            }
+            const std::span<const byte> digest = digests.at(dedupOptions.algorithm);
+            candidate.digest.assign(digest.begin(), digest.end());
+            bytesRead.fetch_add(candidate.size, std::memory_order_relaxed);
+        }
+        catch (const std::exception &exception)
+        {
+            fail(candidate, exception.what());
+        }
+    });
+    if (isCancelled(shouldCancel))
+    {
+        return finish();
+    }
+
+    std::erase_if(sameEnds, [](const Candidate *candidate) { return candidate->failed; });
+    confirmed.insert(confirmed.end(), sameEnds.begin(), sameEnds.end());
+    std::ranges::sort(confirmed, bySizeAndDigest);
+    forEachRun(confirmed, sameSizeAndDigest, [&](const std::span<Candidate *const> run) {
+        DuplicateGroup &group = summary.groups.emplace_back();
+        group.size = run.front()->size;
+        group.digest = run.front()->digest;
+        for (const Candidate *candidate : run)
+        {
+            group.paths.push_back(candidate->path);
+        }
+        std::ranges::sort(group.paths);
+    });
+    std::ranges::stable_sort(summary.groups, std::greater(), &DuplicateGroup::reclaimableBytes);
+
+    return finish();
+}
\ No newline at end of file
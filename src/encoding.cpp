@@ -0,0 +1,135 @@
+#include "encoding.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HASHER_HAVE_SSE2_HEX
+#endif
+
+namespace
+{
+// Both hex digits of every byte value, so the scalar path is one load and one two-byte store per byte
+constexpr std::array<char, 512> HEX_PAIRS = []() {
+    constexpr char DIGITS[] = "0123456789abcdef";
+    std::array<char, 512> pairs{};
+    for (size_t value = 0; value < 256; value++)
+    {
+        pairs[value * 2] = DIGITS[value >> 4];
+        pairs[value * 2 + 1] = DIGITS[value & 0xf];
+    }
+    return pairs;
+}();
+
+constexpr char BASE64_DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#ifdef HASHER_HAVE_SSE2_HEX
+// Turn 16 nibbles into their ASCII hex digits: '0' + n, plus the gap up to 'a' for n > 9
+__m128i nibblesToHex(const __m128i nibbles)
+{
+    const __m128i letters = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    const __m128i digits = _mm_add_epi8(nibbles, _mm_set1_epi8('0'));
+    return _mm_add_epi8(digits, _mm_and_si128(letters, _mm_set1_epi8('a' - '0' - 10)));
+}
+#endif
+} // namespace
+
+void encodeHex(const std::span<const unsigned char> data, char *output)
+{
+    size_t i = 0;
+
+#ifdef HASHER_HAVE_SSE2_HEX
+    // 16 bytes at a time: split into high and low nibbles, interleave them back into digit order and convert
+    const __m128i lowMask = _mm_set1_epi8(0x0f);
+    for (; i + 16 <= data.size(); i += 16)
+    {
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + i));
+        const __m128i high = _mm_and_si128(_mm_srli_epi16(input, 4), lowMask);
+        const __m128i low = _mm_and_si128(input, lowMask);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i * 2), nibblesToHex(_mm_unpacklo_epi8(high, low)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i * 2 + 16), nibblesToHex(_mm_unpackhi_epi8(high, low)));
+    }
+#endif
+
+    for (; i < data.size(); i++)
+    {
+        output[i * 2] = HEX_PAIRS[data[i] * 2];
+        output[i * 2 + 1] = HEX_PAIRS[data[i] * 2 + 1];
+    }
+}
+
+std::string toHex(const std::span<const unsigned char> data)
+{
+    std::string hex(data.size() * 2, '\0');
+    encodeHex(data, hex.data());
+    return hex;
+}
+
+bool decodeHex(const std::string_view hex, unsigned char *output)
+{
+    if (hex.size() % 2 != 0)
+    {
+        return false;
+    }
+
+    auto digit = [](const char c) -> int {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f')
+        {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F')
+        {
+            return c - 'A' + 10;
+        }
+        return -1;
+    };
+
+    for (size_t i = 0; i < hex.size(); i += 2)
+    {
+        const int high = digit(hex[i]);
+        const int low = digit(hex[i + 1]);
+        if (high < 0 || low < 0)
+        {
+            return false;
+        }
+        output[i / 2] = static_cast<unsigned char>(high << 4 | low);
+    }
+    return true;
+}
+
+void encodeBase64(const std::span<const unsigned char> data, char *output)
+{
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3)
+    {
+        const uint32_t group = uint32_t{data[i]} << 16 | uint32_t{data[i + 1]} << 8 | data[i + 2];
+        *output++ = BASE64_DIGITS[group >> 18];
+        *output++ = BASE64_DIGITS[group >> 12 & 0x3f];
+        *output++ = BASE64_DIGITS[group >> 6 & 0x3f];
+        *output++ = BASE64_DIGITS[group & 0x3f];
+    }
+
+    const size_t remaining = data.size() - i;
+    if (remaining > 0)
+    {
+        const uint32_t group = uint32_t{data[i]} << 16 | (remaining > 1 ? uint32_t{data[i + 1]} << 8 : 0);
+        *output++ = BASE64_DIGITS[group >> 18];
+        *output++ = BASE64_DIGITS[group >> 12 & 0x3f];
+        *output++ = remaining > 1 ? BASE64_DIGITS[group >> 6 & 0x3f] : '=';
+        *output++ = '=';
+    }
+}
+
+std::string toBase64(const std::span<const unsigned char> data)
+{
+    std::string base64(base64Length(data.size()), '\0');
+    encodeBase64(data, base64.data());
+    return base64;
+}
\ No newline at end of file
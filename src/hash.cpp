@@ -6,25 +6,45 @@
 #define HAVE_BLAKE2B
 
 #include "hash.h"
+#include "arena.h"
+#include "cache.h"
+#include "chunk_ring.h"
+#include "encoding.h"
+#include "reader.h"
 
 #include <wolfssl/wolfcrypt/blake2.h>
+#include <wolfssl/wolfcrypt/error-crypt.h>
 #include <wolfssl/wolfcrypt/hash.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <format>
 #include <fstream>
+#include <functional>
 #include <future>
-#include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <map>
+#include <mutex>
 #include <optional>
 #include <ranges>
-#include <sstream>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <variant>
 #include <vector>
 
-constexpr int BLAKE2B_DIGEST_SIZE = 64;
-
-constexpr size_t BUFFER_SIZE = 1024 * 1024; // 1 MB
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#endif
 
 class HashException final : public std::runtime_error
 {
@@ -57,185 +77,792 @@ class HashException final : public std::runtime_error
     }
 };
 
-Hasher::Hasher(const wc_HashType algorithm) : algorithm(algorithm), finalized(false)
+void throwHashException(const std::string &errorMessage, const int code, const wc_HashType algorithm)
+{
+    throw HashException(errorMessage, code, algorithm);
+}
+
+Hasher::Alternatives Hasher::create(const wc_HashType algorithm)
 {
-    // Get digest size
-    int digestSize;
-    switch (this->algorithm)
+    // Not wolfCrypt enumerators, so kept out of the switch
+    if (algorithm == HASH_TYPE_BLAKE3)
+    {
+        return Alternatives(std::in_place_type<TypedHasher<HASH_TYPE_BLAKE3>>);
+    }
+    if (algorithm == HASH_TYPE_XXH3_64)
+    {
+        return Alternatives(std::in_place_type<TypedHasher<HASH_TYPE_XXH3_64>>);
+    }
+    if (algorithm == HASH_TYPE_XXH3_128)
     {
+        return Alternatives(std::in_place_type<TypedHasher<HASH_TYPE_XXH3_128>>);
+    }
+    if (algorithm == HASH_TYPE_CRC32C)
+    {
+        return Alternatives(std::in_place_type<TypedHasher<HASH_TYPE_CRC32C>>);
+    }
+
+    switch (algorithm)
+    {
+    case WC_HASH_TYPE_MD5:
+        return Alternatives(std::in_place_type<TypedHasher<WC_HASH_TYPE_MD5>>);
+    case WC_HASH_TYPE_SHA:
+        return Alternatives(std::in_place_type<TypedHasher<WC_HASH_TYPE_SHA>>);
+    case WC_HASH_TYPE_SHA256:
+        return Alternatives(std::in_place_type<TypedHasher<WC_HASH_TYPE_SHA256>>);
+    case WC_HASH_TYPE_SHA512:
+        return Alternatives(std::in_place_type<TypedHasher<WC_HASH_TYPE_SHA512>>);
+    case WC_HASH_TYPE_SHA3_256:
+        return Alternatives(std::in_place_type<TypedHasher<WC_HASH_TYPE_SHA3_256>>);
+    case WC_HASH_TYPE_SHA3_512:
+        return Alternatives(std::in_place_type<TypedHasher<WC_HASH_TYPE_SHA3_512>>);
     case WC_HASH_TYPE_BLAKE2B:
-        digestSize = BLAKE2B_DIGEST_SIZE;
-        break;
+        return Alternatives(std::in_place_type<TypedHasher<WC_HASH_TYPE_BLAKE2B>>);
     default:
-        digestSize = wc_HashGetDigestSize(this->algorithm);
-        break;
+        throw HashException("Unsupported hash algorithm!", HASH_TYPE_E, algorithm);
+    }
+}
+
+Hasher::Hasher(const wc_HashType algorithm) : hasher(create(algorithm))
+{
+}
+
+void Hasher::reset()
+{
+    std::visit([](auto &typed) { typed.reset(); }, this->hasher);
+}
+
+void Hasher::updateWithBuffer(const byte *buffer, const word32 bufferSize)
+{
+    std::visit([&](auto &typed) { typed.updateWithBuffer(buffer, bufferSize); }, this->hasher);
+}
+
+void Hasher::finalize()
+{
+    std::visit([](auto &typed) { typed.finalize(); }, this->hasher);
+}
+
+std::string Hasher::getDigest() const
+{
+    return toHex(this->getRawDigest());
+}
+
+std::span<const byte> Hasher::getRawDigest() const
+{
+    return std::visit([](const auto &typed) { return typed.getRawDigest(); }, this->hasher);
+}
+
+wc_HashType Hasher::getAlgorithm() const
+{
+    return std::visit([](const auto &typed) { return std::remove_cvref_t<decltype(typed)>::ALGORITHM; },
+                      this->hasher);
+}
+
+size_t Hasher::getDigestSize() const
+{
+    return std::visit([](const auto &typed) { return std::remove_cvref_t<decltype(typed)>::DIGEST_SIZE; },
+                      this->hasher);
+}
+
+std::vector<byte> Hasher::saveState() const
+{
+    return std::visit([](const auto &typed) { return typed.saveState(); }, this->hasher);
+}
+
+void Hasher::restoreState(const std::span<const byte> saved)
+{
+    std::visit([&](auto &typed) { typed.restoreState(saved); }, this->hasher);
+}
+
+void DigestSet::set(const wc_HashType algorithm, const std::span<const byte> digest)
+{
+    // Keep the slots sorted by algorithm so iteration order matches std::map
+    const auto position = std::ranges::lower_bound(this->slots.begin(), this->slots.begin() + this->count, algorithm,
+                                                   {}, &Slot::algorithm);
+    const bool replacing = position != this->slots.begin() + this->count && position->algorithm == algorithm;
+
+    // A replacement of the same length reuses the old bytes, anything else is appended to the storage
+    if (replacing && position->length == digest.size())
+    {
+        std::ranges::copy(digest, this->storage.begin() + position->offset);
+        return;
     }
-    if (digestSize <= 0)
+    if ((!replacing && this->count == MAX_ENTRIES) || this->used + digest.size() > STORAGE_SIZE)
     {
-        throw HashException("Got invalid digest size!", digestSize, this->algorithm);
+        throw std::length_error("Too many digests for one DigestSet");
     }
 
-    this->digest.resize(digestSize);
+    if (!replacing)
+    {
+        std::move_backward(position, this->slots.begin() + this->count, this->slots.begin() + this->count + 1);
+        this->count++;
+    }
+    *position = {algorithm, this->used, static_cast<uint16_t>(digest.size())};
+    std::ranges::copy(digest, this->storage.begin() + this->used);
+    this->used += static_cast<uint16_t>(digest.size());
+}
+
+const DigestSet::Slot *DigestSet::find(const wc_HashType algorithm) const
+{
+    const auto last = this->slots.begin() + this->count;
+    const auto position = std::ranges::lower_bound(this->slots.begin(), last, algorithm, {}, &Slot::algorithm);
+    return position != last && position->algorithm == algorithm ? &*position : nullptr;
+}
+
+bool DigestSet::contains(const wc_HashType algorithm) const
+{
+    return this->find(algorithm) != nullptr;
+}
 
-    int ret;
-    switch (this->algorithm)
+std::span<const byte> DigestSet::at(const wc_HashType algorithm) const
+{
+    const Slot *slot = this->find(algorithm);
+    if (slot == nullptr)
     {
-    case WC_HASH_TYPE_BLAKE2B:
-        ret = wc_InitBlake2b(&blake2bhash, digestSize);
-        break;
-    default:
-        ret = wc_HashInit(&hash, algorithm);
-        break;
+        throw std::out_of_range(std::format("No digest for algorithm {}", algorithmName(algorithm)));
     }
-    if (ret != 0)
+    return {this->storage.data() + slot->offset, slot->length};
+}
+
+std::string DigestSet::hex(const wc_HashType algorithm) const
+{
+    return toHex(this->at(algorithm));
+}
+
+std::string DigestSet::base64(const wc_HashType algorithm) const
+{
+    return toBase64(this->at(algorithm));
+}
+
+DigestSet::Entry DigestSet::entry(const size_t index) const
+{
+    const Slot &slot = this->slots[index];
+    return {slot.algorithm, {this->storage.data() + slot.offset, slot.length}};
+}
+
+std::map<wc_HashType, std::string> DigestSet::toHexMap() const
+{
+    std::map<wc_HashType, std::string> hashes;
+    for (const auto &[algorithm, digest] : *this)
     {
-        throw HashException("Failed to initialize hash!", ret, algorithm);
+        hashes.emplace_hint(hashes.end(), algorithm, toHex(digest));
     }
+    return hashes;
 }
 
-void Hasher::updateWithBuffer(const byte *buffer, word32 bufferSize)
+bool DigestSet::operator==(const DigestSet &other) const
 {
-    if (this->finalized)
+    if (this->count != other.count)
     {
-        throw std::logic_error("You cannot update a hash after it has been finalized!");
+        return false;
     }
+    for (size_t i = 0; i < this->count; i++)
+    {
+        const Entry mine = this->entry(i);
+        const Entry theirs = other.entry(i);
+        if (mine.algorithm != theirs.algorithm || !std::ranges::equal(mine.digest, theirs.digest))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr std::pair<wc_HashType, std::string_view> ALGORITHM_NAMES[] = {
+    {WC_HASH_TYPE_MD5, "MD5"},           {WC_HASH_TYPE_SHA, "SHA1"},          {WC_HASH_TYPE_SHA256, "SHA256"},
+    {WC_HASH_TYPE_SHA512, "SHA512"},     {WC_HASH_TYPE_SHA3_256, "SHA3_256"}, {WC_HASH_TYPE_SHA3_512, "SHA3_512"},
+    {WC_HASH_TYPE_BLAKE2B, "BLAKE2b"},   {HASH_TYPE_BLAKE3, "BLAKE3"},        {HASH_TYPE_XXH3_64, "XXH3"},
+    {HASH_TYPE_XXH3_128, "XXH128"},      {HASH_TYPE_CRC32C, "CRC32C"},
+};
 
-    int ret;
-    switch (this->algorithm)
+std::vector<wc_HashType> supportedAlgorithms()
+{
+    std::vector<wc_HashType> algorithms;
+    for (const auto &type : ALGORITHM_NAMES | std::views::keys)
     {
-    case WC_HASH_TYPE_BLAKE2B:
-        ret = wc_Blake2bUpdate(&this->blake2bhash, buffer, bufferSize);
-        break;
-    default:
-        ret = wc_HashUpdate(&this->hash, this->algorithm, buffer, bufferSize);
-        break;
+        algorithms.push_back(type);
     }
-    if (ret != 0)
+    return algorithms;
+}
+
+std::string_view algorithmName(const wc_HashType algorithm)
+{
+    for (const auto &[type, name] : ALGORITHM_NAMES)
     {
-        throw HashException("Failed to update hash!", ret, this->algorithm);
+        if (type == algorithm)
+        {
+            return name;
+        }
     }
+    return "Unknown";
 }
 
-void Hasher::finalize()
+std::optional<wc_HashType> algorithmFromName(const std::string_view name)
 {
-    if (this->finalized)
+    // Compare case-insensitively and ignore separators so "sha3-256", "SHA3_256" and "sha3256" all match
+    auto normalize = [](const std::string_view text) {
+        std::string normalized;
+        for (const char c : text)
+        {
+            if (c != '-' && c != '_')
+            {
+                normalized += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+        }
+        return normalized;
+    };
+
+    const std::string wanted = normalize(name);
+    for (const auto &[type, typeName] : ALGORITHM_NAMES)
     {
-        throw std::logic_error("You cannot finalize a hash twice!");
+        if (normalize(typeName) == wanted)
+        {
+            return type;
+        }
     }
-    this->finalized = true;
+    return std::nullopt;
+}
+
+const HashCheckpoint::Entry *HashCheckpoint::find(const wc_HashType algorithm) const
+{
+    const auto found = std::ranges::find(this->states, algorithm, &Entry::algorithm);
+    return found != this->states.end() ? &*found : nullptr;
+}
+
+namespace
+{
+constexpr std::string_view CHECKPOINT_HEADER = "hasher-checkpoint 2\n";
+constexpr std::string_view CHECKPOINT_CHECKSUM = "checksum ";
+
+std::string checkpointChecksum(const std::string_view text)
+{
+    Hasher hasher(WC_HASH_TYPE_SHA256);
+    hasher.updateWithBuffer(reinterpret_cast<const byte *>(text.data()), static_cast<word32>(text.size()));
+    hasher.finalize();
+    return toHex(hasher.getRawDigest());
+}
 
-    int ret;
-    switch (this->algorithm)
+// The next line of text without its newline, moving text past it
+std::string_view takeLine(std::string_view &text)
+{
+    const size_t end = text.find('\n');
+    const std::string_view line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    return line;
+}
+
+std::string_view expectKey(std::string_view &text, const std::string_view key)
+{
+    const std::string_view line = takeLine(text);
+    if (!line.starts_with(key) || line.size() <= key.size() || line[key.size()] != ' ')
     {
-    case WC_HASH_TYPE_BLAKE2B:
-        ret = wc_Blake2bFinal(&this->blake2bhash, this->digest.data(), static_cast<word32>(this->digest.size()));
-        break;
-    default:
-        ret = wc_HashFinal(&this->hash, this->algorithm, this->digest.data());
-        break;
+        throw std::runtime_error(std::format("Hash checkpoint is missing its '{}' line", key));
     }
-    if (ret != 0)
+    return line.substr(key.size() + 1);
+}
+
+uint64_t parseCheckpointNumber(const std::string_view text)
+{
+    uint64_t value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size())
     {
-        throw HashException("Failed to store digest!", ret, this->algorithm);
+        throw std::runtime_error(std::format("Invalid number '{}' in hash checkpoint", text));
     }
+    return value;
 }
 
-std::string Hasher::getDigest() const
+std::vector<byte> decodeCheckpointHex(const std::string_view hex, const std::string_view what)
 {
-    if (!this->finalized)
+    std::vector<byte> data(hex.size() / 2);
+    if (hex.size() % 2 != 0 || !decodeHex(hex, data.data()))
     {
-        throw std::logic_error("You must finalize a hash to get the digest!");
+        throw std::runtime_error(std::format("Invalid {} in hash checkpoint", what));
     }
+    return data;
+}
+} // namespace
 
-    // Convert digest to hex string
-    std::stringstream ss;
-    ss << std::hex << std::setfill('0');
-    for (const unsigned char i : this->digest)
+void HashCheckpoint::save(std::ostream &output) const
+{
+    std::string text(CHECKPOINT_HEADER);
+    text += std::format("path {}\nfile {} {}\nsample {}\noffset {}\ncomplete {}\n", this->path, this->device,
+                        this->inode, toHex(this->sample), this->offset, this->complete ? 1 : 0);
+    for (const Entry &entry : this->states)
     {
-        ss << std::setw(2) << static_cast<int>(i);
+        text += std::format("{} {}\n", algorithmName(entry.algorithm), toHex(entry.state));
     }
+    output << text << CHECKPOINT_CHECKSUM << checkpointChecksum(text) << '\n';
+}
 
-    return ss.str();
+HashCheckpoint HashCheckpoint::load(std::istream &input)
+{
+    const std::string contents{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    if (!contents.starts_with(CHECKPOINT_HEADER))
+    {
+        throw std::runtime_error("Not a hash checkpoint");
+    }
+
+    // Everything up to the last line is covered by the checksum on it
+    std::string_view text = contents;
+    if (text.ends_with('\n'))
+    {
+        text.remove_suffix(1);
+    }
+    const size_t checksumLine = text.rfind('\n') + 1;
+    const std::string_view checksum = text.substr(checksumLine);
+    text = text.substr(0, checksumLine);
+    if (!checksum.starts_with(CHECKPOINT_CHECKSUM) ||
+        checksum.substr(CHECKPOINT_CHECKSUM.size()) != checkpointChecksum(text))
+    {
+        throw std::runtime_error("Hash checkpoint is damaged, its checksum does not match");
+    }
+    text.remove_prefix(CHECKPOINT_HEADER.size());
+
+    HashCheckpoint checkpoint;
+    checkpoint.path = expectKey(text, "path");
+    const std::string_view file = expectKey(text, "file");
+    const size_t space = file.find(' ');
+    checkpoint.device = parseCheckpointNumber(file.substr(0, space));
+    checkpoint.inode = parseCheckpointNumber(space == std::string_view::npos ? "" : file.substr(space + 1));
+    checkpoint.sample = decodeCheckpointHex(expectKey(text, "sample"), "sample");
+    checkpoint.offset = parseCheckpointNumber(expectKey(text, "offset"));
+    checkpoint.complete = parseCheckpointNumber(expectKey(text, "complete")) != 0;
+
+    while (!text.empty())
+    {
+        const std::string_view line = takeLine(text);
+        const size_t separator = line.find(' ');
+        const std::string_view name = line.substr(0, separator);
+        const std::optional<wc_HashType> algorithm = algorithmFromName(name);
+        if (!algorithm || separator == std::string_view::npos)
+        {
+            throw std::runtime_error(std::format("Invalid state for '{}' in hash checkpoint", name));
+        }
+        checkpoint.states.push_back(
+            {*algorithm, decodeCheckpointHex(line.substr(separator + 1), std::format("state for '{}'", name))});
+    }
+    return checkpoint;
 }
 
-Hasher::~Hasher()
+void HashProgress::reset()
 {
-    int ret;
-    switch (this->algorithm)
+    this->totalBytes.store(0);
+    this->bytesRead.store(0);
+    this->ioNanoseconds.store(0);
+    this->stallNanoseconds.store(0);
+    for (AlgorithmProgress &algorithm : this->algorithms)
     {
-    case WC_HASH_TYPE_BLAKE2B:
-        ret = 0;
-        break;
-    default:
-        ret = wc_HashFree(&this->hash, this->algorithm);
-        break;
+        algorithm.bytesHashed.store(0);
+        algorithm.hashNanoseconds.store(0);
+    }
+}
+
+namespace
+{
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "progress counters must not take locks");
+
+// Adds the time until it goes out of scope to a progress counter, and costs nothing when there is no counter
+class ScopedTimer
+{
+    std::atomic<uint64_t> *counter;
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    explicit ScopedTimer(std::atomic<uint64_t> *counter) : counter(counter)
+    {
+        if (this->counter != nullptr)
+        {
+            this->start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    ~ScopedTimer()
+    {
+        if (this->counter != nullptr)
+        {
+            const auto elapsed = std::chrono::steady_clock::now() - this->start;
+            this->counter->fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                     std::memory_order_relaxed);
+        }
+    }
+};
+
+void updateHasher(Hasher &hasher, const std::span<const byte> data, HashProgress *progress)
+{
+    AlgorithmProgress *tracked = progress != nullptr ? &progress->algorithm(hasher.getAlgorithm()) : nullptr;
+    {
+        ScopedTimer timer(tracked != nullptr ? &tracked->hashNanoseconds : nullptr);
+        hasher.updateWithBuffer(data.data(), static_cast<word32>(data.size()));
     }
-    if (ret != 0)
+    if (tracked != nullptr)
     {
-        std::cerr << std::format("Failed to free hash! - Error Code: {}", ret) << std::endl;
+        tracked->bytesHashed.fetch_add(data.size(), std::memory_order_relaxed);
     }
 }
 
+// Read the next chunk, counting the time blocked on I/O
+std::span<const byte> readTracked(FileReader &reader, const size_t slot, HashProgress *progress)
+{
+    std::span<const byte> data;
+    {
+        ScopedTimer timer(progress != nullptr ? &progress->ioNanoseconds : nullptr);
+        data = reader.read(slot);
+    }
+    if (progress != nullptr)
+    {
+        progress->bytesRead.fetch_add(data.size(), std::memory_order_relaxed);
+    }
+    return data;
+}
+
+// Read the file on a background thread that keeps up to bufferCount chunks in flight, so the disk keeps working
+// while earlier chunks are hashed. When pipelined, every hasher also consumes the chunks on its own thread, so the
+// wall time approaches that of the slowest algorithm instead of the sum of all of them. Returns false if cancelled,
+// with every hasher having been given the bytesRead bytes read up to then.
+bool hashWithReadAhead(FileReader &reader, ChunkRing &ring, const std::vector<Hasher *> &hashers,
+                       const std::function<bool()> &isCancelled, HashProgress *progress, uint64_t &bytesRead)
+{
+    const bool pipelined = ring.consumers() > 1;
+    std::atomic failed(false);
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    auto fail = [&](std::exception_ptr exception) {
+        std::lock_guard lock(errorMutex);
+        if (!error)
+        {
+            error = std::move(exception);
+        }
+        failed.store(true);
+    };
+
+    auto consume = [&](const std::vector<Hasher *> &assigned) {
+        for (uint64_t sequence = 0;; sequence++)
+        {
+            const ChunkRing::Chunk &chunk = ring.wait(sequence);
+            // Keep releasing chunks after a failure so the reader is never left waiting on this thread
+            if (!failed.load())
+            {
+                try
+                {
+                    for (Hasher *hasher : assigned)
+                    {
+                        updateHasher(*hasher, chunk.data, progress);
+                    }
+                }
+                catch (...)
+                {
+                    fail(std::current_exception());
+                }
+            }
+            const bool last = chunk.last;
+            ring.release(sequence);
+            if (last)
+            {
+                return;
+            }
+        }
+    };
+
+    bool cancelled = false;
+    auto produce = [&]() {
+        for (uint64_t sequence = 0;; sequence++)
+        {
+            ChunkRing::Chunk &chunk = [&]() -> ChunkRing::Chunk & {
+                ScopedTimer timer(progress != nullptr ? &progress->stallNanoseconds : nullptr);
+                return ring.acquire(sequence);
+            }();
+            const size_t slot = sequence % ring.slotCount();
+            reader.release(slot);
+
+            // Let the reader start refilling any later slots the hashers have already finished with
+            for (uint64_t ahead = sequence + 1; ahead < sequence + ring.slotCount(); ahead++)
+            {
+                if (ring.isFree(ahead))
+                {
+                    reader.release(ahead % ring.slotCount());
+                }
+            }
+
+            cancelled = isCancelled();
+            if (cancelled || failed.load())
+            {
+                chunk.data = {};
+                chunk.last = true;
+                ring.publish(sequence);
+                return;
+            }
+
+            try
+            {
+                chunk.data = readTracked(reader, slot, progress);
+                chunk.last = reader.finished();
+                bytesRead += chunk.data.size();
+            }
+            catch (...)
+            {
+                fail(std::current_exception());
+                chunk.data = {};
+                chunk.last = true;
+            }
+            ring.publish(sequence);
+            if (chunk.last)
+            {
+                return;
+            }
+        }
+    };
+
+    {
+        std::jthread readerThread(produce);
+        if (pipelined)
+        {
+            std::vector<std::jthread> workers;
+            for (Hasher *hasher : hashers)
+            {
+                workers.emplace_back(consume, std::vector{hasher});
+            }
+        }
+        else
+        {
+            consume(hashers);
+        }
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return !cancelled;
+}
+
+// Which file a checkpoint at offset belongs to: its absolute path, device and inode, and a digest of its first bytes
+// and of those just before offset
+HashCheckpoint identifyFile(const std::string &filePath, const uint64_t offset)
+{
+    HashCheckpoint identity;
+    identity.path = std::filesystem::absolute(filePath).lexically_normal().string();
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat status{};
+    if (stat(filePath.c_str(), &status) != 0)
+    {
+        throw std::runtime_error(std::format("Failed to open file: {}", filePath));
+    }
+    identity.device = static_cast<uint64_t>(status.st_dev);
+    identity.inode = static_cast<uint64_t>(status.st_ino);
+#endif
+
+    const uint64_t length = std::min<uint64_t>(offset, HashCheckpoint::CHECKPOINT_SAMPLE_SIZE);
+    std::vector<char> data(2 * length);
+    std::ifstream file(filePath, std::ios::binary);
+    file.read(data.data(), static_cast<std::streamsize>(length));
+    file.seekg(static_cast<std::streamoff>(offset - length));
+    file.read(data.data() + length, static_cast<std::streamsize>(length));
+    if (!file)
+    {
+        throw std::runtime_error(std::format("Failed to read file: {}", filePath));
+    }
+    Hasher hasher(WC_HASH_TYPE_SHA256);
+    hasher.updateWithBuffer(reinterpret_cast<const byte *>(data.data()), static_cast<word32>(data.size()));
+    hasher.finalize();
+    const std::span<const byte> digest = hasher.getRawDigest();
+    identity.sample.assign(digest.begin(), digest.end());
+    return identity;
+}
+
+// Record where every hasher has got to in the given file
+void saveCheckpoint(HashCheckpoint &checkpoint, const std::string &filePath, const std::vector<Hasher *> &hashers,
+                    const uint64_t offset, const bool complete)
+{
+    HashCheckpoint identity = identifyFile(filePath, offset);
+    checkpoint.path = std::move(identity.path);
+    checkpoint.device = identity.device;
+    checkpoint.inode = identity.inode;
+    checkpoint.sample = std::move(identity.sample);
+    checkpoint.offset = offset;
+    checkpoint.complete = complete;
+    checkpoint.states.clear();
+    for (const Hasher *hasher : hashers)
+    {
+        checkpoint.states.push_back({hasher->getAlgorithm(), hasher->saveState()});
+    }
+}
+} // namespace
+
 std::map<wc_HashType, std::string> calculateHashes(
     const std::string &filePath, const std::vector<wc_HashType> &hashesToCalculate,
     const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+{
+    return calculateHashes(filePath, hashesToCalculate, HashOptions{}, shouldCancel);
+}
+
+std::map<wc_HashType, std::string> calculateHashes(
+    const std::string &filePath, const std::vector<wc_HashType> &hashesToCalculate, const HashOptions &options,
+    const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+{
+    return calculateDigests(filePath, hashesToCalculate, options, shouldCancel).toHexMap();
+}
+
+DigestSet calculateDigests(const std::string &filePath, const std::vector<wc_HashType> &hashesToCalculate,
+                           const HashOptions &options,
+                           const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
 {
     // Helper to check cancellation
     auto isCancelled = [&]() -> bool { return shouldCancel && shouldCancel->get().load(); };
 
-    std::map<wc_HashType, std::unique_ptr<Hasher>> hashes;
     if (isCancelled())
     {
         return {};
     }
 
-    for (wc_HashType algorithm : hashesToCalculate)
+    // Unchanged files are answered from the digest cache without being opened
+    std::optional<FileIdentity> identity;
+    if (options.cache != nullptr)
     {
-        hashes[algorithm] = std::make_unique<Hasher>(algorithm);
+        identity = fileIdentity(filePath);
+        if (identity)
+        {
+            if (auto cached = options.cache->lookup(*identity, hashesToCalculate))
+            {
+                return std::move(*cached);
+            }
+        }
+    }
+
+    // Hashers come from the arena when there is one, otherwise every hasher lives in one allocation, skipping
+    // algorithms that were asked for twice
+    std::unique_ptr<std::optional<Hasher>[]> storage;
+    std::vector<Hasher *> ownHashers;
+    if (options.arena != nullptr)
+    {
+        options.arena->countFile();
     }
+    else
+    {
+        storage = std::make_unique<std::optional<Hasher>[]>(hashesToCalculate.size());
+        for (const wc_HashType algorithm : hashesToCalculate)
+        {
+            auto isAlgorithm = [&](const Hasher *hasher) { return hasher->getAlgorithm() == algorithm; };
+            if (std::ranges::none_of(ownHashers, isAlgorithm))
+            {
+                ownHashers.push_back(&storage[ownHashers.size()].emplace(algorithm));
+            }
+        }
+    }
+    const std::vector<Hasher *> &hashers =
+        options.arena != nullptr ? options.arena->hashers(hashesToCalculate) : ownHashers;
     if (isCancelled())
     {
         return {};
     }
 
-    // Read file
-    std::ifstream file(filePath, std::ios::binary);
-    std::vector<byte> buffer(BUFFER_SIZE);
-    while (file)
+    // Carry on from a checkpoint holding every algorithm, but only in the same file with the hashed part unchanged
+    uint64_t offset = 0;
+    if (options.checkpoint != nullptr && options.checkpoint->offset > 0)
     {
-        if (isCancelled())
+        const HashCheckpoint &checkpoint = *options.checkpoint;
+        auto hasState = [&](const Hasher *hasher) { return checkpoint.find(hasher->getAlgorithm()) != nullptr; };
+        if (std::ranges::all_of(hashers, hasState))
         {
-            return {};
+            const uint64_t size = std::filesystem::file_size(filePath);
+            const HashCheckpoint identity = identifyFile(filePath, std::min(size, checkpoint.offset));
+            if (identity.path != checkpoint.path || identity.device != checkpoint.device ||
+                identity.inode != checkpoint.inode)
+            {
+                throw std::runtime_error(std::format("Checkpoint was saved for {}, not this file", checkpoint.path));
+            }
+            if (size < checkpoint.offset || identity.sample != checkpoint.sample)
+            {
+                throw std::runtime_error(
+                    std::format("File has changed within the {} bytes its checkpoint covers", checkpoint.offset));
+            }
+            for (Hasher *hasher : hashers)
+            {
+                hasher->restoreState(checkpoint.find(hasher->getAlgorithm())->state);
+            }
+            offset = checkpoint.offset;
         }
+    }
 
-        file.read(reinterpret_cast<char *>(buffer.data()), BUFFER_SIZE);
-        const std::streamsize bytesRead = file.gcount();
+    // Read file, or only what follows the checkpoint
+    const bool readAhead = options.bufferCount > 0 || options.pipelined;
+    const size_t slotCount = readAhead ? std::max<size_t>(options.bufferCount, 1) : 1;
+    const FileReaderPtr reader =
+        offset > 0 ? openFileRangeReader(filePath, offset, UINT64_MAX, options, slotCount)
+                   : openFileReader(filePath, options, slotCount);
+    if (options.progress != nullptr && reader->size())
+    {
+        options.progress->totalBytes.store(offset + *reader->size());
+        options.progress->bytesRead.fetch_add(offset);
+    }
+    uint64_t bytesRead = 0;
+    auto stopAtCheckpoint = [&]() -> DigestSet {
+        if (options.checkpoint != nullptr)
+        {
+            saveCheckpoint(*options.checkpoint, filePath, hashers, offset + bytesRead, false);
+        }
+        return {};
+    };
+
+    // Files that fit in a single buffer gain nothing from a separate reader thread
+    const bool singleChunk = reader->size() && *reader->size() <= BUFFER_SIZE;
 
-        for (const auto &hasher : hashes | std::views::values)
+    if (readAhead && !singleChunk)
+    {
+        const size_t consumers = options.pipelined ? hashers.size() : 1;
+        std::optional<ChunkRing> ownRing;
+        ChunkRing &ring = options.arena != nullptr ? options.arena->chunkRing(slotCount, consumers)
+                                                   : ownRing.emplace(slotCount, consumers);
+        if (!hashWithReadAhead(*reader, ring, hashers, isCancelled, options.progress, bytesRead))
         {
-            hasher->updateWithBuffer(buffer.data(), static_cast<word32>(bytesRead));
+            return stopAtCheckpoint();
         }
     }
-    file.close();
-
-    for (const auto &hasher : hashes | std::views::values)
+    else
     {
-        hasher->finalize();
+        do
+        {
+            if (isCancelled())
+            {
+                return stopAtCheckpoint();
+            }
+
+            const std::span<const byte> data = readTracked(*reader, 0, options.progress);
+            for (Hasher *hasher : hashers)
+            {
+                updateHasher(*hasher, data, options.progress);
+            }
+            bytesRead += data.size();
+            reader->release(0);
+        } while (!reader->finished());
     }
-    if (isCancelled())
+
+    // Finalizing consumes the state, so it is saved first to let a later call extend the file's digest
+    if (options.checkpoint != nullptr)
     {
-        return {};
+        saveCheckpoint(*options.checkpoint, filePath, hashers, offset + bytesRead, true);
     }
 
-    std::map<wc_HashType, std::string> calculateHashes;
-    for (const auto &[algorithm, hasher] : hashes)
+    DigestSet digests;
+    for (Hasher *hasher : hashers)
     {
-        calculateHashes[algorithm] = hasher->getDigest();
+        hasher->finalize();
+        digests.set(hasher->getAlgorithm(), hasher->getRawDigest());
     }
     if (isCancelled())
     {
         return {};
     }
 
-    return calculateHashes;
+    // Only cache the result if the file did not change while it was being read
+    if (identity && fileIdentity(filePath) == identity)
+    {
+        options.cache->store(*identity, filePath, digests);
+    }
+
+    return digests;
 }
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "jobs.h"
+
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+JobScheduler::JobScheduler(size_t workerCount, std::function<void()> onChange) : onChange(std::move(onChange))
+{
+    workerCount = std::max<size_t>(workerCount, 1);
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        this->workers.emplace_back([this]() { this->run(); });
+    }
+}
+
+JobScheduler::~JobScheduler()
+{
+    this->shutdown();
+}
+
+JobScheduler::JobId JobScheduler::submit(std::string label, Work work)
+{
+    auto job = std::make_shared<Job>();
+    job->status.label = std::move(label);
+    job->work = std::move(work);
+
+    JobId id;
+    {
+        std::lock_guard lock(this->mutex);
+        id = this->nextId++;
+        job->status.id = id;
+        this->all.push_back(job);
+        if (this->stopping)
+        {
+            job->status.state = JobState::Cancelled;
+            job->work = nullptr;
+            return id;
+        }
+        this->queue.push_back(std::move(job));
+    }
+    this->workAvailable.notify_one();
+    return id;
+}
+
+void JobScheduler::cancel(const JobId id)
+{
+    {
+        std::lock_guard lock(this->mutex);
+        const auto found = std::ranges::find_if(this->all, [&](const auto &job) { return job->status.id == id; });
+        if (found == this->all.end())
+        {
+            return;
+        }
+        Job &job = **found;
+        job.shouldCancel.store(true);
+        if (job.status.state != JobState::Queued)
+        {
+            return;
+        }
+        job.status.state = JobState::Cancelled;
+        job.work = nullptr;
+        std::erase_if(this->queue, [&](const auto &queued) { return queued->status.id == id; });
+    }
+    this->notifyChange();
+}
+
+void JobScheduler::cancelAll()
+{
+    {
+        std::lock_guard lock(this->mutex);
+        for (const auto &job : this->all)
+        {
+            job->shouldCancel.store(true);
+            if (job->status.state == JobState::Queued)
+            {
+                job->status.state = JobState::Cancelled;
+                job->work = nullptr;
+            }
+        }
+        this->queue.clear();
+    }
+    this->notifyChange();
+}
+
+bool JobScheduler::forget(const JobId id)
+{
+    std::lock_guard lock(this->mutex);
+    const auto found = std::ranges::find_if(this->all, [&](const auto &job) { return job->status.id == id; });
+    if (found == this->all.end())
+    {
+        return true;
+    }
+    if ((*found)->status.state == JobState::Queued || (*found)->status.state == JobState::Running)
+    {
+        return false;
+    }
+    this->all.erase(found);
+    return true;
+}
+
+void JobScheduler::shutdown()
+{
+    this->cancelAll();
+    {
+        std::lock_guard lock(this->mutex);
+        this->stopping = true;
+    }
+    this->workAvailable.notify_all();
+    this->workers.clear();
+}
+
+std::optional<JobScheduler::JobStatus> JobScheduler::status(const JobId id) const
+{
+    std::lock_guard lock(this->mutex);
+    const auto found = std::ranges::find_if(this->all, [&](const auto &job) { return job->status.id == id; });
+    if (found == this->all.end())
+    {
+        return std::nullopt;
+    }
+    return (*found)->status;
+}
+
+std::vector<JobScheduler::JobStatus> JobScheduler::jobs() const
+{
+    std::lock_guard lock(this->mutex);
+    std::vector<JobStatus> statuses;
+    statuses.reserve(this->all.size());
+    for (const auto &job : this->all)
+    {
+        statuses.push_back(job->status);
+    }
+    return statuses;
+}
+
+void JobScheduler::run()
+{
+    while (true)
+    {
+        std::shared_ptr<Job> job;
+        Work work;
+        {
+            std::unique_lock lock(this->mutex);
+            this->workAvailable.wait(lock, [&]() { return this->stopping || !this->queue.empty(); });
+            if (this->queue.empty())
+            {
+                return;
+            }
+            job = std::move(this->queue.front());
+            this->queue.pop_front();
+            job->status.state = JobState::Running;
+            work = std::exchange(job->work, nullptr);
+        }
+        this->notifyChange();
+
+        // Everything the work wrote is published by the state change under the lock, so whoever sees the job end
+        // can read its results without further locking
+        JobState state = JobState::Finished;
+        std::string error;
+        try
+        {
+            work(job->shouldCancel);
+        }
+        catch (const std::exception &exception)
+        {
+            state = JobState::Failed;
+            error = exception.what();
+        }
+        catch (...)
+        {
+            state = JobState::Failed;
+            error = "Unknown error";
+        }
+        if (job->shouldCancel.load())
+        {
+            state = JobState::Cancelled;
+        }
+
+        {
+            std::lock_guard lock(this->mutex);
+            job->status.state = state;
+            job->status.error = std::move(error);
+        }
+        this->notifyChange();
+    }
+}
+
+void JobScheduler::notifyChange() const
+{
+    if (this->onChange)
+    {
+        this->onChange();
+    }
+}
\ No newline at end of file
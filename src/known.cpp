@@ -0,0 +1,428 @@
+#include "known.h"
+#include "encoding.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HASHER_HAVE_MMAP
+#endif
+
+namespace
+{
+constexpr char INDEX_MAGIC[8] = {'H', 'S', 'H', 'K', 'N', 'O', 'W', 'N'};
+constexpr uint32_t INDEX_VERSION = 1;
+constexpr size_t PREFIX_BITS = 16;
+constexpr size_t PREFIX_COUNT = size_t{1} << PREFIX_BITS;
+// Interpolation steps before a lookup falls back to bisection, bounding the cost on badly skewed buckets
+constexpr int MAX_INTERPOLATION_STEPS = 8;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t groupCount;
+};
+
+// Each group is a table of PREFIX_COUNT + 1 indexes, entry p being the first digest whose leading 16 bits are at
+// least p, followed by the sorted digests themselves. Both start 8 byte aligned
+struct GroupHeader
+{
+    uint32_t digestSize = 0;
+    uint32_t reserved = 0;
+    uint64_t count = 0;
+    uint64_t prefixOffset = 0;
+    uint64_t digestOffset = 0;
+};
+static_assert(sizeof(GroupHeader) == 32);
+
+uint64_t readBigEndian64(const byte *data)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; i++)
+    {
+        value = value << 8 | data[i];
+    }
+    return value;
+}
+
+size_t prefixOf(const byte *digest)
+{
+    return static_cast<size_t>(digest[0]) << 8 | digest[1];
+}
+
+uint64_t alignUp(const uint64_t value)
+{
+    return (value + 7) & ~uint64_t{7};
+}
+
+// Digests of one length gathered while building
+template <size_t Size>
+using Digests = std::vector<std::array<byte, Size>>;
+using AllDigests = std::tuple<Digests<16>, Digests<20>, Digests<32>, Digests<64>>;
+
+bool isAlphanumeric(const char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) != 0;
+}
+
+// Add every free-standing digest on a line, returning how many there were
+size_t collectDigests(const std::string_view line, AllDigests &digests)
+{
+    size_t found = 0;
+    size_t i = 0;
+    while (i < line.size())
+    {
+        if (!std::isxdigit(static_cast<unsigned char>(line[i])) || (i > 0 && isAlphanumeric(line[i - 1])))
+        {
+            i++;
+            continue;
+        }
+        size_t end = i;
+        while (end < line.size() && std::isxdigit(static_cast<unsigned char>(line[end])))
+        {
+            end++;
+        }
+        if (end < line.size() && isAlphanumeric(line[end]))
+        {
+            i = end;
+            continue;
+        }
+
+        const std::string_view hex = line.substr(i, end - i);
+        std::apply(
+            [&](auto &...groups) {
+                auto add = [&](auto &group) {
+                    using Digest = typename std::remove_reference_t<decltype(group)>::value_type;
+                    if (hex.size() == std::tuple_size_v<Digest> * 2)
+                    {
+                        decodeHex(hex, group.emplace_back().data());
+                        found++;
+                    }
+                };
+                (add(groups), ...);
+            },
+            digests);
+        i = end;
+    }
+    return found;
+}
+
+template <size_t Size>
+void writeGroupData(std::ofstream &output, const Digests<Size> &digests, const GroupHeader &header)
+{
+    std::vector<uint64_t> prefixes(PREFIX_COUNT + 1, digests.size());
+    for (size_t i = digests.size(); i-- > 0;)
+    {
+        prefixes[prefixOf(digests[i].data())] = i;
+    }
+    // Empty prefixes start where the next non-empty one does
+    for (size_t prefix = PREFIX_COUNT; prefix-- > 0;)
+    {
+        prefixes[prefix] = std::min(prefixes[prefix], prefixes[prefix + 1]);
+    }
+
+    output.seekp(static_cast<std::streamoff>(header.prefixOffset));
+    output.write(reinterpret_cast<const char *>(prefixes.data()),
+                 static_cast<std::streamsize>(prefixes.size() * sizeof(uint64_t)));
+    output.seekp(static_cast<std::streamoff>(header.digestOffset));
+    output.write(reinterpret_cast<const char *>(digests.data()), static_cast<std::streamsize>(digests.size() * Size));
+}
+} // namespace
+
+struct KnownHashes::State
+{
+    struct Group
+    {
+        size_t digestSize;
+        uint64_t count;
+        const uint64_t *prefixes;
+        const byte *digests;
+    };
+
+    std::vector<Group> groups;
+#ifdef HASHER_HAVE_MMAP
+    void *mapping = nullptr;
+    size_t length = 0;
+
+    ~State()
+    {
+        if (this->mapping != nullptr)
+        {
+            munmap(this->mapping, this->length);
+        }
+    }
+#else
+    std::vector<uint64_t> contents;
+#endif
+
+    [[nodiscard]] const Group *group(const size_t digestSize) const
+    {
+        const auto found = std::ranges::find(this->groups, digestSize, &Group::digestSize);
+        return found != this->groups.end() ? &*found : nullptr;
+    }
+};
+
+KnownHashes::KnownHashes(const std::string &indexPath) : state(std::make_unique<State>())
+{
+    std::span<const byte> data;
+#ifdef HASHER_HAVE_MMAP
+    const int descriptor = open(indexPath.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status{};
+    if (descriptor < 0 || fstat(descriptor, &status) != 0)
+    {
+        if (descriptor >= 0)
+        {
+            close(descriptor);
+        }
+        throw std::runtime_error(std::format("Failed to open known hash index: {}", indexPath));
+    }
+    this->state->length = static_cast<size_t>(status.st_size);
+    if (this->state->length > 0)
+    {
+        void *mapping = mmap(nullptr, this->state->length, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (mapping != MAP_FAILED)
+        {
+            this->state->mapping = mapping;
+            // Lookups land anywhere in the index, so readahead would only pull in pages that are never used
+            madvise(mapping, this->state->length, MADV_RANDOM);
+        }
+    }
+    close(descriptor);
+    if (this->state->mapping == nullptr && this->state->length > 0)
+    {
+        throw std::runtime_error(std::format("Failed to map known hash index: {}", indexPath));
+    }
+    data = {static_cast<const byte *>(this->state->mapping), this->state->length};
+#else
+    std::ifstream input(indexPath, std::ios::binary | std::ios::ate);
+    if (!input)
+    {
+        throw std::runtime_error(std::format("Failed to open known hash index: {}", indexPath));
+    }
+    const size_t length = static_cast<size_t>(input.tellg());
+    this->state->contents.resize((length + 7) / 8);
+    input.seekg(0);
+    input.read(reinterpret_cast<char *>(this->state->contents.data()), static_cast<std::streamsize>(length));
+    data = {reinterpret_cast<const byte *>(this->state->contents.data()), length};
+#endif
+
+    auto invalid = [&]() { return std::runtime_error(std::format("Not a known hash index: {}", indexPath)); };
+
+    FileHeader header{};
+    if (data.size() < sizeof(header))
+    {
+        throw invalid();
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.version != INDEX_VERSION ||
+        header.groupCount > 64 || data.size() < sizeof(header) + header.groupCount * sizeof(GroupHeader))
+    {
+        throw invalid();
+    }
+
+    for (uint32_t i = 0; i < header.groupCount; i++)
+    {
+        GroupHeader group{};
+        std::memcpy(&group, data.data() + sizeof(header) + i * sizeof(GroupHeader), sizeof(group));
+        const uint64_t prefixBytes = (PREFIX_COUNT + 1) * sizeof(uint64_t);
+        if (group.digestSize < 2 + 8 || group.digestSize > 64 || group.prefixOffset % 8 != 0 ||
+            group.prefixOffset > data.size() || data.size() - group.prefixOffset < prefixBytes ||
+            group.digestOffset > data.size() || (data.size() - group.digestOffset) / group.digestSize < group.count)
+        {
+            throw invalid();
+        }
+
+        const auto *prefixes = reinterpret_cast<const uint64_t *>(data.data() + group.prefixOffset);
+        // A corrupt table could send lookups outside the digests, so it is checked once up front
+        if (prefixes[0] != 0 || prefixes[PREFIX_COUNT] != group.count ||
+            !std::is_sorted(prefixes, prefixes + PREFIX_COUNT + 1))
+        {
+            throw invalid();
+        }
+        this->state->groups.push_back({group.digestSize, group.count, prefixes, data.data() + group.digestOffset});
+    }
+}
+
+KnownHashes::~KnownHashes() = default;
+
+bool KnownHashes::contains(const std::span<const byte> digest) const
+{
+    const State::Group *group = this->state->group(digest.size());
+    if (group == nullptr)
+    {
+        return false;
+    }
+
+    const size_t size = group->digestSize;
+    const size_t prefix = prefixOf(digest.data());
+    uint64_t low = group->prefixes[prefix];
+    uint64_t high = group->prefixes[prefix + 1];
+    const uint64_t key = readBigEndian64(digest.data() + 2);
+    auto keyAt = [&](const uint64_t index) { return readBigEndian64(group->digests + index * size + 2); };
+
+    for (int step = 0; low < high; step++)
+    {
+        uint64_t middle = low + (high - low) / 2;
+        if (step < MAX_INTERPOLATION_STEPS)
+        {
+            const uint64_t lowKey = keyAt(low);
+            const uint64_t highKey = keyAt(high - 1);
+            if (key < lowKey || key > highKey)
+            {
+                return false;
+            }
+            if (highKey > lowKey)
+            {
+                const double fraction = static_cast<double>(key - lowKey) / static_cast<double>(highKey - lowKey);
+                middle = low + std::min(high - 1 - low, static_cast<uint64_t>(fraction * (high - 1 - low)));
+            }
+        }
+
+        const int order = std::memcmp(digest.data(), group->digests + middle * size, size);
+        if (order == 0)
+        {
+            return true;
+        }
+        if (order < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return false;
+}
+
+bool KnownHashes::containsAny(const DigestSet &digests) const
+{
+    for (const auto &[algorithm, digest] : digests)
+    {
+        if (this->contains(digest))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t KnownHashes::size() const
+{
+    uint64_t total = 0;
+    for (const State::Group &group : this->state->groups)
+    {
+        total += group.count;
+    }
+    return total;
+}
+
+KnownBuildSummary KnownHashes::build(const std::vector<std::string> &listPaths, const std::string &indexPath)
+{
+    KnownBuildSummary summary;
+    AllDigests digests;
+
+    for (const std::string &listPath : listPaths)
+    {
+        std::ifstream input(listPath, std::ios::binary);
+        if (!input)
+        {
+            throw std::runtime_error(std::format("Failed to open hash list: {}", listPath));
+        }
+        std::string line;
+        while (std::getline(input, line))
+        {
+            if (collectDigests(line, digests) == 0)
+            {
+                summary.skippedLines++;
+            }
+        }
+    }
+
+    std::apply(
+        [&](auto &...groups) {
+            auto deduplicate = [&](auto &group) {
+                std::ranges::sort(group);
+                const auto [first, last] = std::ranges::unique(group);
+                summary.duplicates += static_cast<uint64_t>(last - first);
+                group.erase(first, last);
+                summary.digests += group.size();
+            };
+            (deduplicate(groups), ...);
+        },
+        digests);
+
+    // Lay out the header and group headers, then each group's prefix table and digests
+    FileHeader header{};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    std::vector<GroupHeader> groupHeaders;
+    std::apply(
+        [&](const auto &...groups) {
+            auto plan = [&](const auto &group) {
+                using Digest = typename std::remove_reference_t<decltype(group)>::value_type;
+                if (!group.empty())
+                {
+                    groupHeaders.push_back({.digestSize = static_cast<uint32_t>(std::tuple_size_v<Digest>),
+                                            .count = group.size()});
+                }
+            };
+            (plan(groups), ...);
+        },
+        digests);
+    header.groupCount = static_cast<uint32_t>(groupHeaders.size());
+
+    uint64_t end = sizeof(header) + groupHeaders.size() * sizeof(GroupHeader);
+    for (GroupHeader &group : groupHeaders)
+    {
+        group.prefixOffset = alignUp(end);
+        group.digestOffset = group.prefixOffset + (PREFIX_COUNT + 1) * sizeof(uint64_t);
+        end = group.digestOffset + group.count * group.digestSize;
+    }
+
+    // Written next to the index and renamed over it, so a running lookup never sees half a file
+    const std::string temporaryPath = indexPath + ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!output)
+        {
+            throw std::runtime_error(std::format("Failed to create known hash index: {}", indexPath));
+        }
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char *>(groupHeaders.data()),
+                     static_cast<std::streamsize>(groupHeaders.size() * sizeof(GroupHeader)));
+
+        size_t next = 0;
+        std::apply(
+            [&](const auto &...groups) {
+                auto write = [&](const auto &group) {
+                    if (!group.empty())
+                    {
+                        writeGroupData(output, group, groupHeaders[next++]);
+                    }
+                };
+                (write(groups), ...);
+            },
+            digests);
+
+        if (!output.flush())
+        {
+            throw std::runtime_error(std::format("Failed to write known hash index: {}", indexPath));
+        }
+    }
+    std::filesystem::rename(temporaryPath, indexPath);
+    return summary;
+}
\ No newline at end of file
@@ -2,16 +2,38 @@
 #define GLFW_INCLUDE_VULKAN
 
 #include "ImGuiFileDialog.h"
+#include "encoding.h"
 #include "hash.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_vulkan.h"
+#include "jobs.h"
+#include "known.h"
+#include "quick.h"
+#include "tree.h"
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <format>
-#include <future>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <thread>
+
+// The main loop sleeps in glfwWaitEventsTimeout instead of drawing every vsync, so an idle window leaves the CPU to the
+// hashing threads. Input wakes it at once and a finished hash posts an empty event; otherwise it only wakes to refresh
+// progress bars, or to let a hover tooltip appear
+static constexpr double PROGRESS_REFRESH_SECONDS = 0.1;
+static constexpr double HOVER_REFRESH_SECONDS = 0.1;
+static constexpr double IDLE_WAIT_SECONDS = 1.0;
+// Frames drawn after waking for an event before sleeping again, since ImGui can take a frame or two to settle a layout
+static constexpr int FRAMES_AFTER_EVENT = 3;
+// Jobs hashed at once. Each already spreads its algorithms or files over every core, so more would only have them
+// fight over the disk, while a second one keeps a small file from waiting behind a huge one
+static constexpr size_t MAX_RUNNING_JOBS = 2;
 
 static VkAllocationCallbacks *g_Allocator = nullptr;
 static VkInstance g_Instance = VK_NULL_HANDLE;
@@ -306,6 +328,49 @@ static void FramePresent(ImGui_ImplVulkanH_Window *wd)
     wd->SemaphoreIndex = (wd->SemaphoreIndex + 1) % wd->SemaphoreCount; // Now we can use the next set of semaphores
 }
 
+// A file or folder queued for hashing. Each job keeps its own progress and results, so one that has been superseded
+// can wind down in the background without touching what is on screen
+struct FileJob
+{
+    JobScheduler::JobId id = 0;
+    std::string path;
+    bool isDirectory = false;
+    // What the digests cover when they are sampled, empty for full-content digests
+    std::string sampledNote;
+    HashProgress progress;
+    // When a worker picked the job up, for the ETA
+    std::atomic<std::chrono::steady_clock::time_point> started{};
+
+    // Written by the job and only read once the scheduler reports that it ended
+    std::map<wc_HashType, std::string> hashes;
+    // Algorithms whose digest of the file is in the known hash index
+    std::vector<wc_HashType> knownAlgorithms;
+    // Text that only changes when hashing finishes, formatted then rather than every frame
+    std::string knownNote;
+    std::string treeSummaryText;
+
+    // Folder results, appended to by the pool workers as files finish
+    std::mutex treeResultsMutex;
+    std::vector<FileHashResult> treeResults;
+    // Whether each result matched the known hash index, filled in alongside treeResults
+    std::vector<bool> treeKnown;
+    size_t treeKnownCount = 0;
+};
+
+// Progress bar overlay: how fast the work goes while it runs, and the time left at the rate it is actually advancing
+static std::string describeProgress(const uint64_t done, const uint64_t total, const double busySeconds,
+                                    const double elapsedSeconds)
+{
+    constexpr double MEGABYTE = 1024.0 * 1024.0;
+    const double speed = busySeconds > 0 ? static_cast<double>(done) / MEGABYTE / busySeconds : 0.0;
+    if (done == 0 || done >= total || elapsedSeconds <= 0)
+    {
+        return std::format("{:.1f} MB/s", speed);
+    }
+    const double eta = static_cast<double>(total - done) / (static_cast<double>(done) / elapsedSeconds);
+    return std::format("{:.1f} MB/s, ETA {:.0f} s", speed, eta);
+}
+
 // Main code
 int main(int argc, char *argv[])
 {
@@ -357,6 +422,8 @@ int main(int argc, char *argv[])
     io.ConfigWindowsMoveFromTitleBarOnly = true;
     io.ConfigViewportsNoAutoMerge = true;
     io.ConfigDockingTransparentPayload = true;
+    // A blinking cursor would need a frame every blink
+    io.ConfigInputTextCursorBlink = false;
     io.IniFilename = nullptr;
 
     ImGui::StyleColorsDark();
@@ -385,13 +452,14 @@ int main(int argc, char *argv[])
     ImFont *cascadia = io.Fonts->AddFontFromFileTTF("assets/CascadiaCodeNF-Regular.woff2", 15.0f);
 
     // State
-    std::atomic hashThreadShouldCancel(false);
-    bool isCalculating = true;
+    bool isCalculating = false;
+    bool anyJobRunning = false;
     std::string errorMessage;
     bool running = true;
-    std::string filePath;
+    std::string initialPath;
 
     bool showDemoWindow = false;
+    std::array<char, 129> inputBuffer{};
     auto clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
     // Set file path
@@ -399,14 +467,7 @@ int main(int argc, char *argv[])
     {
         if (std::filesystem::exists(argv[1]))
         {
-            if (!std::filesystem::is_empty(argv[1]))
-            {
-                filePath = argv[1];
-            }
-            else
-            {
-                errorMessage = "File passed is empty";
-            }
+            initialPath = argv[1];
         }
         else
         {
@@ -418,30 +479,150 @@ int main(int argc, char *argv[])
         errorMessage = "No file passed";
     }
 
+    // Every digest is matched against the known hash index named by the environment, if there is one
+    std::unique_ptr<KnownHashes> knownHashes;
+    if (const char *knownPath = std::getenv("HASHER_KNOWN_HASHES"); knownPath != nullptr && *knownPath != '\0')
+    {
+        try
+        {
+            knownHashes = std::make_unique<KnownHashes>(knownPath);
+        }
+        catch (const std::exception &exception)
+        {
+            std::cerr << exception.what() << std::endl;
+        }
+    }
+
     std::vector hashesToCalculate = {
         WC_HASH_TYPE_MD5,      WC_HASH_TYPE_SHA,      WC_HASH_TYPE_SHA256,  WC_HASH_TYPE_SHA512,
-        WC_HASH_TYPE_SHA3_256, WC_HASH_TYPE_SHA3_512, WC_HASH_TYPE_BLAKE2B,
+        WC_HASH_TYPE_SHA3_256, WC_HASH_TYPE_SHA3_512, WC_HASH_TYPE_BLAKE2B, HASH_TYPE_BLAKE3,
+        HASH_TYPE_XXH3_64,     HASH_TYPE_XXH3_128,    HASH_TYPE_CRC32C,
+    };
+
+    // Folders already keep every core busy with one file per worker, so their files are not pipelined as well
+    const HashOptions treeOptions{};
+    const size_t treeJobs = std::max(1u, std::thread::hardware_concurrency());
+
+    // Quick sample mode hashes a few blocks of the file instead of all of it, for very large files
+    bool quickSample = false;
+    const QuickHashOptions quickOptions{};
+
+    int shownAlgorithm = 2; // SHA256
+
+    // Runs on a scheduler worker, with the job's own cancellation flag
+    auto hashJob = [&](FileJob &job, const bool quick, const std::atomic<bool> &shouldCancel) {
+        job.started.store(std::chrono::steady_clock::now());
+        if (job.isDirectory)
+        {
+            const TreeSummary summary = hashTree(
+                {job.path}, hashesToCalculate, treeOptions, treeJobs,
+                [&](const FileHashResult &result) {
+                    // Looked up outside the lock so the other workers are not held up
+                    const bool known = knownHashes && knownHashes->containsAny(result.digests);
+                    std::lock_guard lock(job.treeResultsMutex);
+                    job.treeResults.push_back(result);
+                    job.treeKnown.push_back(known);
+                    job.treeKnownCount += known ? 1 : 0;
+                },
+                shouldCancel);
+            const double megabytes = static_cast<double>(summary.bytes) / (1024 * 1024);
+            job.treeSummaryText = std::format("{} files, {} failed, {:.2f} MB in {:.2f} s ({:.2f} MB/s)", summary.files,
+                                              summary.failed, megabytes, summary.seconds,
+                                              summary.seconds > 0 ? megabytes / summary.seconds : 0.0);
+            return;
+        }
+
+        // Hash every algorithm on its own core since the GUI always calculates the full set
+        const HashOptions hashOptions{.pipelined = true, .progress = &job.progress};
+        job.hashes = quick ? calculateQuickDigests(job.path, hashesToCalculate, quickOptions, hashOptions, treeJobs,
+                                                   shouldCancel)
+                                 .digests.toHexMap()
+                           : calculateHashes(job.path, hashesToCalculate, hashOptions, shouldCancel);
+        for (const auto &[algorithm, hash] : job.hashes)
+        {
+            // Sampled digests never equal the full-content digests in the index
+            std::vector<byte> digest(hash.size() / 2);
+            if (knownHashes && !quick && decodeHex(hash, digest.data()) && knownHashes->contains(digest))
+            {
+                job.knownAlgorithms.push_back(algorithm);
+            }
+        }
+
+        std::string names;
+        for (const wc_HashType algorithm : job.knownAlgorithms)
+        {
+            names += std::format("{}{}", names.empty() ? "" : ", ", algorithmName(algorithm));
+        }
+        job.knownNote = job.knownAlgorithms.empty() ? "Not in the known hash index"
+                                                    : std::format("In the known hash index by {}", names);
     };
 
-    std::map<wc_HashType, std::string> displayNames = {
-        {WC_HASH_TYPE_MD5, "MD5"},         {WC_HASH_TYPE_SHA, "SHA1"},          {WC_HASH_TYPE_SHA256, "SHA256"},
-        {WC_HASH_TYPE_SHA512, "SHA512"},   {WC_HASH_TYPE_SHA3_256, "SHA3_256"}, {WC_HASH_TYPE_SHA3_512, "SHA3_512"},
-        {WC_HASH_TYPE_BLAKE2B, "BLAKE2b"},
+    // Declared after everything the jobs use, so it is destroyed, and its workers joined, before any of it
+    std::vector<std::unique_ptr<FileJob>> fileJobs;
+    // The job on screen: the latest one opened, unless another was picked from the queue
+    FileJob *shownJob = nullptr;
+    JobScheduler scheduler(MAX_RUNNING_JOBS, glfwPostEmptyEvent);
+
+    // Queue a file or folder behind any jobs already waiting
+    auto queueJob = [&](const std::string &path) -> FileJob * {
+        auto job = std::make_unique<FileJob>();
+        job->path = path;
+        std::error_code error;
+        job->isDirectory = std::filesystem::is_directory(path, error);
+        const bool quick = quickSample && !job->isDirectory;
+        if (quick)
+        {
+            const size_t blocks = quickHashRanges(std::filesystem::file_size(path, error), quickOptions).size();
+            job->sampledNote = blocks == 1 ? "Sampled quick hash of the whole file, not a full-content digest"
+                                           : std::format("Sampled quick hash: {} blocks of {} KB, not a full-content "
+                                                         "digest",
+                                                         blocks, quickOptions.sampleSize / 1024);
+        }
+        FileJob *queued = job.get();
+        queued->id = scheduler.submit(path, [&hashJob, queued, quick](const std::atomic<bool> &shouldCancel) {
+            hashJob(*queued, quick, shouldCancel);
+        });
+        fileJobs.push_back(std::move(job));
+        return queued;
     };
 
-    std::future<std::map<wc_HashType, std::string>> hashThread;
+    // The job on screen is superseded by whatever is opened next, so it is cancelled at once rather than waited for
+    auto supersedeShownJob = [&]() {
+        if (shownJob != nullptr)
+        {
+            scheduler.cancel(shownJob->id);
+        }
+        errorMessage = "";
+    };
 
-    if (!filePath.empty())
+    if (!initialPath.empty())
     {
-        hashThread = std::async(std::launch::async,
-                                [&]() { return calculateHashes(filePath, hashesToCalculate, hashThreadShouldCancel); });
+        shownJob = queueJob(initialPath);
     }
 
     // Main loop
+    int framesToDraw = FRAMES_AFTER_EVENT;
     while (!glfwWindowShouldClose(window))
     {
-        // Poll and handle events
-        glfwPollEvents();
+        // Sleep until there is input, a job starts or ends, or something on screen is due to change
+        if (framesToDraw > 0)
+        {
+            glfwPollEvents();
+            framesToDraw--;
+        }
+        else
+        {
+            const double timeout = anyJobRunning               ? PROGRESS_REFRESH_SECONDS
+                                   : ImGui::IsAnyItemHovered() ? HOVER_REFRESH_SECONDS
+                                                               : IDLE_WAIT_SECONDS;
+            const auto sleepStarted = std::chrono::steady_clock::now();
+            glfwWaitEventsTimeout(timeout);
+            // Woken early, so by input or a job changing state rather than the timeout
+            if (std::chrono::duration<double>(std::chrono::steady_clock::now() - sleepStarted).count() < timeout)
+            {
+                framesToDraw = FRAMES_AFTER_EVENT - 1;
+            }
+        }
 
         // Resize swap chain?
         int fb_width, fb_height;
@@ -471,16 +652,38 @@ int main(int argc, char *argv[])
             glfwSetWindowShouldClose(window, GLFW_TRUE);
         }
 
-        // Main content
-        static std::map<wc_HashType, std::string> calculatedHashes = {};
-
-        if (errorMessage.empty() && isCalculating)
+        // Superseded jobs drop out of the queue once they have wound down, since nothing will show them again
+        for (auto job = fileJobs.begin(); job != fileJobs.end();)
         {
-            if (hashThread.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            const auto status = scheduler.status((*job)->id);
+            if (job->get() != shownJob && status && status->state == JobScheduler::JobState::Cancelled &&
+                scheduler.forget((*job)->id))
             {
-                calculatedHashes = hashThread.get();
-                isCalculating = false;
+                job = fileJobs.erase(job);
+                continue;
             }
+            ++job;
+        }
+
+        const std::vector<JobScheduler::JobStatus> jobStatuses = scheduler.jobs();
+        auto statusOf = [&](const FileJob &job) {
+            const auto found = std::ranges::find(jobStatuses, job.id, &JobScheduler::JobStatus::id);
+            return found != jobStatuses.end() ? *found : JobScheduler::JobStatus{.id = job.id};
+        };
+        anyJobRunning = std::ranges::any_of(jobStatuses, [](const JobScheduler::JobStatus &status) {
+            return status.state == JobScheduler::JobState::Running;
+        });
+        const JobScheduler::JobStatus shownStatus =
+            shownJob != nullptr ? statusOf(*shownJob) : JobScheduler::JobStatus{};
+        isCalculating = shownJob != nullptr && (shownStatus.state == JobScheduler::JobState::Queued ||
+                                                shownStatus.state == JobScheduler::JobState::Running);
+        if (shownJob != nullptr && shownStatus.state == JobScheduler::JobState::Failed)
+        {
+            errorMessage = shownStatus.error;
+        }
+        else if (shownJob != nullptr && shownStatus.state == JobScheduler::JobState::Cancelled)
+        {
+            errorMessage = "Cancelled";
         }
 
         ImGui::Begin("Hasher", &running, ImGuiWindowFlags_MenuBar | ImGuiWindowFlags_AlwaysAutoResize);
@@ -493,12 +696,27 @@ int main(int argc, char *argv[])
                     showDemoWindow = true;
                 }
                 ImGui::Separator();
-                // Open file dialog
+                // Open file dialog, any number of files at once
                 if (ImGui::MenuItem("Open"))
                 {
                     IGFD::FileDialogConfig config;
                     config.path = ".";
-                    ImGuiFileDialog::Instance()->OpenDialog("ChooseHashFile", "Choose File", ".*", config);
+                    config.countSelectionMax = 0;
+                    ImGuiFileDialog::Instance()->OpenDialog("ChooseHashFile", "Choose Files", ".*", config);
+                }
+                if (ImGui::MenuItem("Open Folder"))
+                {
+                    IGFD::FileDialogConfig config;
+                    config.path = ".";
+                    ImGuiFileDialog::Instance()->OpenDialog("ChooseHashFolder", "Choose Folder", nullptr, config);
+                }
+                ImGui::Separator();
+                // Re-hash the shown file in the new mode, dropping the hash in the old one
+                if (ImGui::MenuItem("Quick Sample", nullptr, &quickSample) && shownJob != nullptr &&
+                    !shownJob->isDirectory)
+                {
+                    supersedeShownJob();
+                    shownJob = queueJob(shownJob->path);
                 }
                 ImGui::EndMenu();
             }
@@ -510,27 +728,137 @@ int main(int argc, char *argv[])
             ImGui::ShowDemoWindow(&showDemoWindow);
         }
 
-        // Calculate hash for file selected when ok clicked
+        // Queue the files selected when ok clicked, showing the first of them
         if (ImGuiFileDialog::Instance()->Display("ChooseHashFile", 32, {720, 480}))
         {
             if (ImGuiFileDialog::Instance()->IsOk())
             {
-                std::string filePathName = ImGuiFileDialog::Instance()->GetFilePathName();
-                errorMessage = "";
-                filePath = ImGuiFileDialog::Instance()->GetFilePathName();
-                hashThread = std::async(std::launch::async, [&]() {
-                    return calculateHashes(filePath, hashesToCalculate, hashThreadShouldCancel);
-                });
-                calculatedHashes = {};
-                isCalculating = true;
+                supersedeShownJob();
+                FileJob *first = nullptr;
+                for (const auto &[fileName, filePathName] : ImGuiFileDialog::Instance()->GetSelection())
+                {
+                    FileJob *queued = queueJob(filePathName);
+                    first = first != nullptr ? first : queued;
+                }
+                shownJob = first != nullptr ? first : queueJob(ImGuiFileDialog::Instance()->GetFilePathName());
+            }
+            ImGuiFileDialog::Instance()->Close();
+        }
+
+        // Hash every file in the folder selected when ok clicked
+        if (ImGuiFileDialog::Instance()->Display("ChooseHashFolder", 32, {720, 480}))
+        {
+            if (ImGuiFileDialog::Instance()->IsOk())
+            {
+                supersedeShownJob();
+                shownJob = queueJob(ImGuiFileDialog::Instance()->GetCurrentPath());
             }
             ImGuiFileDialog::Instance()->Close();
         }
 
-        ImGui::Text("File: %s", filePath.c_str());
-        ImGui::Spacing();
-        if (errorMessage.empty())
+        if (shownJob != nullptr)
+        {
+            ImGui::Text(shownJob->isDirectory ? "Folder: %s" : "File: %s", shownJob->path.c_str());
+            ImGui::Spacing();
+        }
+        if (shownJob != nullptr && shownStatus.state == JobScheduler::JobState::Queued)
+        {
+            const auto ahead = std::ranges::count_if(jobStatuses, [&](const JobScheduler::JobStatus &status) {
+                return status.id < shownJob->id && (status.state == JobScheduler::JobState::Queued ||
+                                                    status.state == JobScheduler::JobState::Running);
+            });
+            ImGui::Text("Queued behind %zu other jobs", static_cast<size_t>(ahead));
+        }
+        else if (errorMessage.empty() && shownJob != nullptr && shownJob->isDirectory)
+        {
+            FileJob &job = *shownJob;
+            std::lock_guard lock(job.treeResultsMutex);
+
+            if (isCalculating)
+            {
+                ImGui::Text("Hashing... %zu files done", job.treeResults.size());
+            }
+            else
+            {
+                ImGui::TextUnformatted(job.treeSummaryText.c_str());
+            }
+            if (knownHashes)
+            {
+                ImGui::Text("%zu of %zu files are in the known hash index", job.treeKnownCount, job.treeResults.size());
+            }
+
+            ImGui::SetNextItemWidth(200);
+            if (ImGui::BeginCombo("Algorithm", algorithmName(hashesToCalculate[shownAlgorithm]).data()))
+            {
+                for (int i = 0; i < static_cast<int>(hashesToCalculate.size()); i++)
+                {
+                    if (ImGui::Selectable(algorithmName(hashesToCalculate[i]).data(), i == shownAlgorithm))
+                    {
+                        shownAlgorithm = i;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            const wc_HashType algorithm = hashesToCalculate[shownAlgorithm];
+
+            if (ImGui::BeginTable("TreeTable", knownHashes ? 4 : 3,
+                                  ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY,
+                                  ImVec2(900, 400)))
+            {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("File", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthFixed);
+                ImGui::TableSetupColumn("Hash", ImGuiTableColumnFlags_WidthStretch);
+                if (knownHashes)
+                {
+                    ImGui::TableSetupColumn("Known", ImGuiTableColumnFlags_WidthFixed);
+                }
+                ImGui::TableHeadersRow();
+
+                // Only lay out the rows in view, since a folder can hold millions of files
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(job.treeResults.size()));
+                while (clipper.Step())
+                {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+                    {
+                        const FileHashResult &result = job.treeResults[row];
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(result.path.c_str());
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%llu", static_cast<unsigned long long>(result.size));
+                        ImGui::TableNextColumn();
+                        if (!result.error.empty())
+                        {
+                            ImGui::Text("Error: %s", result.error.c_str());
+                            continue;
+                        }
+                        // Encoded only for the rows on screen
+                        const std::string hash = result.digests.hex(algorithm);
+                        ImGui::PushID(row);
+                        if (ImGui::SmallButton("Copy"))
+                        {
+                            ImGui::SetClipboardText(hash.c_str());
+                        }
+                        ImGui::PopID();
+                        ImGui::SameLine();
+                        ImGui::PushFont(cascadia);
+                        ImGui::TextUnformatted(hash.c_str());
+                        ImGui::PopFont();
+                        if (knownHashes)
+                        {
+                            ImGui::TableNextColumn();
+                            ImGui::TextUnformatted(job.treeKnown[row] ? "Known" : "");
+                        }
+                    }
+                }
+                ImGui::EndTable();
+            }
+        }
+        else if (errorMessage.empty() && shownJob != nullptr)
         {
+            FileJob &job = *shownJob;
             ImGui::PushStyleVar(ImGuiStyleVar_CellPadding, ImVec2(7, 7));
 
             if (ImGui::BeginTable("HashTable", 2,
@@ -545,6 +873,11 @@ int main(int argc, char *argv[])
 
                 if (isCalculating)
                 {
+                    const uint64_t totalBytes = job.progress.totalBytes.load(std::memory_order_relaxed);
+                    const double elapsed =
+                        std::chrono::duration<double>(std::chrono::steady_clock::now() - job.started.load()).count();
+                    const float progressWidth = 420;
+
                     for (const auto &algorithm : hashesToCalculate)
                     {
                         ImGui::TableNextRow();
@@ -554,24 +887,52 @@ int main(int argc, char *argv[])
 
                         // Center the text vertically due to copy button
                         ImGui::SetCursorPosY(ImGui::GetCursorPosY() + (ImGui::GetTextLineHeight() / 4));
-                        ImGui::Text(displayNames.at(algorithm).c_str());
+                        ImGui::Text(algorithmName(algorithm).data());
 
                         // Hash column
                         ImGui::TableNextColumn();
                         ImGui::BeginDisabled();
-                        ImGui::Button(std::format("Copy##{}", displayNames.at(algorithm)).c_str());
+                        ImGui::PushID(static_cast<int>(algorithm));
+                        ImGui::Button("Copy");
+                        ImGui::PopID();
                         ImGui::EndDisabled();
                         if (ImGui::IsItemHovered())
                         {
                             ImGui::SetTooltip("Be patient! This hash is still calculating");
                         }
                         ImGui::SameLine();
-                        ImGui::Text("Calculating...");
+
+                        const AlgorithmProgress &progress = job.progress.algorithm(algorithm);
+                        const uint64_t hashed = progress.bytesHashed.load(std::memory_order_relaxed);
+                        const double busy =
+                            static_cast<double>(progress.hashNanoseconds.load(std::memory_order_relaxed)) / 1e9;
+                        ImGui::ProgressBar(totalBytes > 0 ? static_cast<float>(hashed) / totalBytes : 0.0f,
+                                           ImVec2(progressWidth, 0),
+                                           describeProgress(hashed, totalBytes, busy, elapsed).c_str());
+                    }
+
+                    // The reader gets a row too, so a slow disk stands out against the algorithms
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("Disk");
+                    ImGui::TableNextColumn();
+                    const uint64_t read = job.progress.bytesRead.load(std::memory_order_relaxed);
+                    const double blocked =
+                        static_cast<double>(job.progress.ioNanoseconds.load(std::memory_order_relaxed)) / 1e9;
+                    const double stalled =
+                        static_cast<double>(job.progress.stallNanoseconds.load(std::memory_order_relaxed)) / 1e9;
+                    ImGui::ProgressBar(totalBytes > 0 ? static_cast<float>(read) / totalBytes : 0.0f,
+                                       ImVec2(progressWidth, 0),
+                                       describeProgress(read, totalBytes, blocked, elapsed).c_str());
+                    if (ImGui::IsItemHovered())
+                    {
+                        ImGui::SetTooltip("Blocked on reads for %.1f s, waited %.1f s for the hashers to catch up",
+                                          blocked, stalled);
                     }
                 }
                 else
                 {
-                    for (const auto &[algorithm, hash] : calculatedHashes)
+                    for (const auto &[algorithm, hash] : job.hashes)
                     {
                         ImGui::TableNextRow();
 
@@ -580,14 +941,16 @@ int main(int argc, char *argv[])
 
                         // Center the text vertically due to copy button
                         ImGui::SetCursorPosY(ImGui::GetCursorPosY() + (ImGui::GetTextLineHeight() / 4));
-                        ImGui::Text(displayNames.at(algorithm).c_str());
+                        ImGui::Text(algorithmName(algorithm).data());
 
                         // Hash column
                         ImGui::TableNextColumn();
-                        if (ImGui::Button(std::format("Copy##{}", displayNames.at(algorithm)).c_str()))
+                        ImGui::PushID(static_cast<int>(algorithm));
+                        if (ImGui::Button("Copy"))
                         {
                             ImGui::SetClipboardText(hash.c_str());
                         }
+                        ImGui::PopID();
                         if (hash.contains("Err-crypt code: "))
                         {
                             if (ImGui::IsItemHovered())
@@ -615,19 +978,34 @@ int main(int argc, char *argv[])
 
             ImGui::Spacing();
 
+            if (!job.sampledNote.empty())
+            {
+                ImGui::TextColored(ImVec4(251 * (1.0f / 255.0f), 191 * (1.0f / 255.0f), 36 * (1.0f / 255.0f), 255),
+                                   "%s", job.sampledNote.c_str()); // Tailwind Amber 400
+                ImGui::Spacing();
+            }
+
+            if (knownHashes && job.sampledNote.empty() && !isCalculating)
+            {
+                ImGui::TextUnformatted(job.knownNote.c_str());
+                ImGui::Spacing();
+            }
+
             static std::string message = "No hash to check";
             static auto color =
                 ImVec4(244 * (1.0f / 255.0f), 105 * (1.0f / 255.0f), 105 * (1.0f / 255.0f), 255); // Tailwind Red 400
+            static JobScheduler::JobId checkedJob = 0;
 
             // Reset on file change
-            if (isCalculating)
+            if (isCalculating || checkedJob != job.id)
             {
                 message = "No hash to check";
                 color = ImVec4(244 * (1.0f / 255.0f), 105 * (1.0f / 255.0f), 105 * (1.0f / 255.0f),
                                255); // Tailwind Red 400
+                inputBuffer[0] = '\0';
+                checkedJob = job.id;
             }
 
-            std::vector<char> inputBuffer(129);
             if (isCalculating)
             {
                 ImGui::BeginDisabled();
@@ -641,7 +1019,7 @@ int main(int argc, char *argv[])
             {
                 bool found = false;
 
-                for (const auto &[algorithm, hash] : calculatedHashes)
+                for (const auto &[algorithm, hash] : job.hashes)
                 {
                     if (hash.contains("Err-crypt code: "))
                     {
@@ -651,7 +1029,7 @@ int main(int argc, char *argv[])
                     if (std::equal(inputBuffer.data(), inputBuffer.data() + strlen(inputBuffer.data()), hash.begin(),
                                    hash.end(), [](char a, char b) { return std::tolower(a) == std::tolower(b); }))
                     {
-                        message = std::format("Match found for algorithm: {}", displayNames.at(algorithm));
+                        message = std::format("Match found for algorithm: {}", algorithmName(algorithm));
                         color = ImVec4(32 * (1.0f / 255.0f), 187 * (1.0f / 255.0f), 126 * (1.0f / 255.0f),
                                        255); // Tailwind Emerald 500
                         found = true;
@@ -675,6 +1053,82 @@ int main(int argc, char *argv[])
         }
         ImGui::End();
 
+        // Every job not yet cleared away. Picking one shows it, without disturbing the others
+        if (fileJobs.size() > 1)
+        {
+            ImGui::Begin("Queue", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+            ImGui::Text("%zu jobs, %zu at a time", fileJobs.size(), scheduler.workerCount());
+            if (ImGui::BeginTable("QueueTable", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("File", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("State", ImGuiTableColumnFlags_WidthFixed);
+                ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed);
+                ImGui::TableHeadersRow();
+
+                for (const std::unique_ptr<FileJob> &job : fileJobs)
+                {
+                    const JobScheduler::JobStatus status = statusOf(*job);
+                    ImGui::PushID(static_cast<int>(job->id));
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    if (ImGui::Selectable(job->path.c_str(), job.get() == shownJob))
+                    {
+                        shownJob = job.get();
+                        errorMessage = "";
+                    }
+                    ImGui::TableNextColumn();
+                    switch (status.state)
+                    {
+                    case JobScheduler::JobState::Queued:
+                        ImGui::TextUnformatted("Queued");
+                        break;
+                    case JobScheduler::JobState::Running: {
+                        const uint64_t totalBytes = job->progress.totalBytes.load(std::memory_order_relaxed);
+                        const uint64_t read = job->progress.bytesRead.load(std::memory_order_relaxed);
+                        if (job->isDirectory || totalBytes == 0)
+                        {
+                            ImGui::TextUnformatted("Hashing");
+                        }
+                        else
+                        {
+                            ImGui::Text("Hashing %.0f%%", 100.0 * static_cast<double>(read) / totalBytes);
+                        }
+                        break;
+                    }
+                    case JobScheduler::JobState::Finished:
+                        ImGui::TextUnformatted("Done");
+                        break;
+                    case JobScheduler::JobState::Failed:
+                        ImGui::TextUnformatted("Failed");
+                        break;
+                    case JobScheduler::JobState::Cancelled:
+                        ImGui::TextUnformatted("Cancelled");
+                        break;
+                    }
+                    ImGui::TableNextColumn();
+                    if (status.state == JobScheduler::JobState::Queued ||
+                        status.state == JobScheduler::JobState::Running)
+                    {
+                        if (ImGui::SmallButton("Cancel"))
+                        {
+                            scheduler.cancel(job->id);
+                        }
+                    }
+                    ImGui::PopID();
+                }
+                ImGui::EndTable();
+            }
+
+            // Finished jobs stay around to be looked at again until cleared
+            if (ImGui::Button("Clear Finished"))
+            {
+                std::erase_if(fileJobs, [&](const std::unique_ptr<FileJob> &job) {
+                    return job.get() != shownJob && scheduler.forget(job->id);
+                });
+            }
+            ImGui::End();
+        }
+
         // Rendering
         ImGui::Render();
         ImDrawData *main_draw_data = ImGui::GetDrawData();
@@ -702,6 +1156,9 @@ int main(int argc, char *argv[])
         }
     }
 
+    // Stop every job still queued or running, since they wake the main loop through GLFW as they end
+    scheduler.shutdown();
+
     // Cleanup
     err = vkDeviceWaitIdle(g_Device);
     check_vk_result(err);
@@ -715,11 +1172,5 @@ int main(int argc, char *argv[])
     glfwDestroyWindow(window);
     glfwTerminate();
 
-    // End hash thread if it is still running
-    if (isCalculating)
-    {
-        hashThreadShouldCancel.store(true);
-    }
-
     return 0;
 }
\ No newline at end of file
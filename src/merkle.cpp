@@ -0,0 +1,363 @@
+#include "merkle.h"
+#include "encoding.h"
+#include "pool.h"
+#include "reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <format>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+
+namespace
+{
+constexpr std::string_view MANIFEST_HEADER = "hasher-chunk-manifest 1";
+constexpr byte INTERIOR_PREFIX = 0x01;
+constexpr byte ROOT_PREFIX = 0x02;
+
+bool isCancelled(const std::optional<std::reference_wrapper<const std::atomic<bool>>> &shouldCancel)
+{
+    return shouldCancel && shouldCancel->get().load();
+}
+
+// Rounded up without adding to fileSize, which may come from an untrusted manifest and sit near UINT64_MAX
+size_t chunkCountFor(const uint64_t fileSize, const uint64_t chunkSize)
+{
+    const uint64_t count = fileSize / chunkSize + (fileSize % chunkSize != 0 ? 1 : 0);
+    if (count > std::numeric_limits<size_t>::max())
+    {
+        throw std::length_error("File has too many chunks");
+    }
+    return std::max<size_t>(1, static_cast<size_t>(count));
+}
+
+void appendLittleEndian(std::vector<byte> &output, const uint64_t value)
+{
+    for (size_t i = 0; i < sizeof(value); i++)
+    {
+        output.push_back(static_cast<byte>(value >> (i * 8)));
+    }
+}
+
+std::vector<byte> digestOf(const wc_HashType algorithm, const std::span<const byte> data)
+{
+    Hasher hasher(algorithm);
+    hasher.updateWithBuffer(data.data(), static_cast<word32>(data.size()));
+    hasher.finalize();
+    const std::span<const byte> digest = hasher.getRawDigest();
+    return {digest.begin(), digest.end()};
+}
+
+// Digest of one chunk, read through its own range reader. Returns false if cancelled part way
+bool hashChunk(const std::string &filePath, const wc_HashType algorithm, const uint64_t offset, const uint64_t length,
+               const HashOptions &options,
+               const std::optional<std::reference_wrapper<const std::atomic<bool>>> &shouldCancel,
+               const std::span<byte> digest)
+{
+    Hasher hasher(algorithm);
+    const FileReaderPtr reader = openFileRangeReader(filePath, offset, length, options);
+    while (!reader->finished())
+    {
+        if (isCancelled(shouldCancel))
+        {
+            return false;
+        }
+        const std::span<const byte> data = reader->read(0);
+        hasher.updateWithBuffer(data.data(), static_cast<word32>(data.size()));
+        if (options.progress != nullptr)
+        {
+            options.progress->bytesRead.fetch_add(data.size(), std::memory_order_relaxed);
+            options.progress->algorithm(algorithm).bytesHashed.fetch_add(data.size(), std::memory_order_relaxed);
+        }
+    }
+    hasher.finalize();
+    std::ranges::copy(hasher.getRawDigest(), digest.begin());
+    return true;
+}
+
+// Hash each listed chunk into digests on a pool, index i of chunks landing at offset i * digestSize. Returns false
+// if cancelled
+bool hashChunks(const std::string &filePath, const wc_HashType algorithm, const uint64_t chunkSize,
+                const uint64_t fileSize, const std::vector<size_t> &chunks, const size_t digestSize,
+                std::vector<byte> &digests, const HashOptions &options, const size_t jobs,
+                const std::optional<std::reference_wrapper<const std::atomic<bool>>> &shouldCancel)
+{
+    digests.resize(chunks.size() * digestSize);
+    std::atomic cancelled(false);
+
+    auto run = [&](const size_t i) {
+        const uint64_t offset = chunks[i] * chunkSize;
+        const uint64_t length = std::min(chunkSize, fileSize - std::min(offset, fileSize));
+        const std::span<byte> digest = std::span(digests).subspan(i * digestSize, digestSize);
+        if (!hashChunk(filePath, algorithm, offset, length, options, shouldCancel, digest))
+        {
+            cancelled.store(true);
+        }
+    };
+
+    // A single chunk is hashed right here rather than paying for a pool
+    const size_t workers = std::min(jobs, chunks.size());
+    if (workers <= 1)
+    {
+        for (size_t i = 0; i < chunks.size() && !cancelled.load(); i++)
+        {
+            run(i);
+        }
+        return !cancelled.load();
+    }
+
+    WorkStealingPool pool(workers);
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        pool.submit([&, i]() {
+            if (!cancelled.load())
+            {
+                run(i);
+            }
+        });
+    }
+    pool.wait();
+    return !cancelled.load();
+}
+
+std::string_view expectField(std::istream &input, const std::string_view name, std::string &line)
+{
+    if (!std::getline(input, line))
+    {
+        throw std::runtime_error(std::format("Manifest ends before its '{}' line", name));
+    }
+    if (line.ends_with('\r'))
+    {
+        line.pop_back();
+    }
+    const std::string_view text = line;
+    if (!text.starts_with(name) || text.size() <= name.size() || text[name.size()] != ' ')
+    {
+        throw std::runtime_error(std::format("Manifest is missing its '{}' line", name));
+    }
+    return text.substr(name.size() + 1);
+}
+
+uint64_t parseNumber(const std::string_view text, const std::string_view name)
+{
+    uint64_t value = 0;
+    if (text.empty() || text.size() > 20)
+    {
+        throw std::runtime_error(std::format("Invalid {} in manifest", name));
+    }
+    for (const char c : text)
+    {
+        if (c < '0' || c > '9' || value > (UINT64_MAX - (c - '0')) / 10)
+        {
+            throw std::runtime_error(std::format("Invalid {} in manifest", name));
+        }
+        value = value * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return value;
+}
+
+void parseDigest(const std::string_view hex, const size_t digestSize, byte *output)
+{
+    if (hex.size() != digestSize * 2 || !decodeHex(hex, output))
+    {
+        throw std::runtime_error(std::format("Invalid digest '{}' in manifest", hex));
+    }
+}
+} // namespace
+
+std::vector<byte> merkleRoot(const ChunkManifest &manifest)
+{
+    std::vector<std::vector<byte>> level;
+    for (size_t i = 0; i < manifest.chunkCount(); i++)
+    {
+        const std::span<const byte> digest = manifest.chunk(i);
+        level.emplace_back(digest.begin(), digest.end());
+    }
+    if (level.empty())
+    {
+        throw std::invalid_argument("A manifest needs at least one chunk");
+    }
+
+    std::vector<byte> node;
+    while (level.size() > 1)
+    {
+        std::vector<std::vector<byte>> parents;
+        for (size_t i = 0; i + 1 < level.size(); i += 2)
+        {
+            node.assign(1, INTERIOR_PREFIX);
+            node.insert(node.end(), level[i].begin(), level[i].end());
+            node.insert(node.end(), level[i + 1].begin(), level[i + 1].end());
+            parents.push_back(digestOf(manifest.algorithm, node));
+        }
+        if (level.size() % 2 != 0)
+        {
+            parents.push_back(std::move(level.back()));
+        }
+        level = std::move(parents);
+    }
+
+    node.assign(1, ROOT_PREFIX);
+    appendLittleEndian(node, manifest.fileSize);
+    appendLittleEndian(node, manifest.chunkSize);
+    node.insert(node.end(), level.front().begin(), level.front().end());
+    return digestOf(manifest.algorithm, node);
+}
+
+void ChunkManifest::save(std::ostream &output) const
+{
+    output << MANIFEST_HEADER << '\n'
+           << std::format("algorithm {}\nchunk-size {}\nfile-size {}\nroot {}\n", algorithmName(this->algorithm),
+                          this->chunkSize, this->fileSize, toHex(this->root));
+    for (size_t i = 0; i < this->chunkCount(); i++)
+    {
+        output << std::format("{} {}\n", i, toHex(this->chunk(i)));
+    }
+}
+
+ChunkManifest ChunkManifest::load(std::istream &input)
+{
+    std::string line;
+    if (!std::getline(input, line) || std::string_view(line).substr(0, MANIFEST_HEADER.size()) != MANIFEST_HEADER)
+    {
+        throw std::runtime_error("Not a chunk manifest");
+    }
+
+    ChunkManifest manifest;
+    const std::string_view name = expectField(input, "algorithm", line);
+    const std::optional<wc_HashType> algorithm = algorithmFromName(name);
+    if (!algorithm)
+    {
+        throw std::runtime_error(std::format("Unknown algorithm '{}' in manifest", name));
+    }
+    manifest.algorithm = *algorithm;
+    manifest.digestSize = Hasher(manifest.algorithm).getDigestSize();
+
+    manifest.chunkSize = parseNumber(expectField(input, "chunk-size", line), "chunk size");
+    if (manifest.chunkSize == 0)
+    {
+        throw std::runtime_error("Invalid chunk size in manifest");
+    }
+    manifest.fileSize = parseNumber(expectField(input, "file-size", line), "file size");
+
+    manifest.root.resize(manifest.digestSize);
+    parseDigest(expectField(input, "root", line), manifest.digestSize, manifest.root.data());
+
+    // The count comes from the manifest itself, so digests only grow with the lines that are really there
+    const size_t count = chunkCountFor(manifest.fileSize, manifest.chunkSize);
+    for (size_t i = 0; i < count; i++)
+    {
+        const std::string index = std::to_string(i);
+        const std::string_view hex = expectField(input, index, line);
+        manifest.digests.resize(manifest.digests.size() + manifest.digestSize);
+        parseDigest(hex, manifest.digestSize, manifest.digests.data() + i * manifest.digestSize);
+    }
+
+    if (merkleRoot(manifest) != manifest.root)
+    {
+        throw std::runtime_error("Manifest root does not match its chunk digests");
+    }
+    return manifest;
+}
+
+ChunkManifest buildChunkManifest(const std::string &filePath, const wc_HashType algorithm, const uint64_t chunkSize,
+                                 const HashOptions &options, const size_t jobs,
+                                 const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+{
+    if (chunkSize == 0)
+    {
+        throw std::invalid_argument("Chunk size must not be zero");
+    }
+
+    ChunkManifest manifest;
+    manifest.algorithm = algorithm;
+    manifest.chunkSize = chunkSize;
+    manifest.digestSize = Hasher(algorithm).getDigestSize();
+    manifest.fileSize = std::filesystem::file_size(filePath);
+    if (options.progress != nullptr)
+    {
+        options.progress->totalBytes.store(manifest.fileSize, std::memory_order_relaxed);
+    }
+
+    std::vector<size_t> chunks(chunkCountFor(manifest.fileSize, chunkSize));
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        chunks[i] = i;
+    }
+    if (!hashChunks(filePath, algorithm, chunkSize, manifest.fileSize, chunks, manifest.digestSize, manifest.digests,
+                    options, jobs, shouldCancel))
+    {
+        manifest.digests.clear();
+        return manifest;
+    }
+
+    manifest.root = merkleRoot(manifest);
+    return manifest;
+}
+
+ChunkVerification verifyChunkManifest(const std::string &filePath, const ChunkManifest &manifest,
+                                      const HashOptions &options, const size_t jobs, const uint64_t offset,
+                                      const uint64_t length,
+                                      const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+{
+    ChunkVerification verification;
+    const uint64_t fileSize = std::filesystem::file_size(filePath);
+    verification.sizeChanged = fileSize != manifest.fileSize;
+
+    // Chunks of either layout count, so bytes cut off or appended show up as changed chunks too
+    const size_t currentCount = chunkCountFor(fileSize, manifest.chunkSize);
+    const size_t totalCount = std::max(currentCount, manifest.chunkCount());
+    const uint64_t end = length > UINT64_MAX - offset ? UINT64_MAX : offset + length;
+    const size_t first = static_cast<size_t>(offset / manifest.chunkSize);
+    const size_t last = std::min<size_t>(totalCount, static_cast<size_t>((end - 1) / manifest.chunkSize) + 1);
+    if (length == 0 || first >= last)
+    {
+        return verification;
+    }
+
+    // Only chunks the file still has need reading; the rest are changed by definition
+    std::vector<size_t> toHash;
+    for (size_t i = first; i < last; i++)
+    {
+        if (i < currentCount && i < manifest.chunkCount())
+        {
+            toHash.push_back(i);
+        }
+        else
+        {
+            verification.changedChunks.push_back(i);
+        }
+    }
+
+    std::vector<byte> digests;
+    if (options.progress != nullptr)
+    {
+        const uint64_t begin = first * manifest.chunkSize;
+        options.progress->totalBytes.store(std::min(fileSize, last * manifest.chunkSize) - std::min(fileSize, begin),
+                                           std::memory_order_relaxed);
+    }
+    const bool completed = hashChunks(filePath, manifest.algorithm, manifest.chunkSize, fileSize, toHash,
+                                      manifest.digestSize, digests, options, jobs, shouldCancel);
+    if (!completed)
+    {
+        verification.changedChunks.clear();
+        verification.cancelled = true;
+        return verification;
+    }
+
+    for (size_t i = 0; i < toHash.size(); i++)
+    {
+        const std::span<const byte> actual = std::span(digests).subspan(i * manifest.digestSize, manifest.digestSize);
+        if (!std::ranges::equal(actual, manifest.chunk(toHash[i])))
+        {
+            verification.changedChunks.push_back(toHash[i]);
+        }
+        const uint64_t chunkOffset = toHash[i] * manifest.chunkSize;
+        verification.checkedBytes += std::min(manifest.chunkSize, fileSize - chunkOffset);
+    }
+    verification.checkedChunks = toHash.size();
+    std::ranges::sort(verification.changedChunks);
+    return verification;
+}
\ No newline at end of file
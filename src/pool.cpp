@@ -0,0 +1,142 @@
+#include "pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+// Lets submit() tell whether it is running on one of the pool's workers, and which one
+thread_local const WorkStealingPool *currentPool = nullptr;
+thread_local size_t currentWorker = 0;
+} // namespace
+
+WorkStealingPool::WorkStealingPool(size_t workerCount)
+{
+    workerCount = std::max<size_t>(workerCount, 1);
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        this->queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        this->workers.emplace_back([this, i]() { this->run(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::unique_lock lock(this->stateMutex);
+        this->allDone.wait(lock, [&]() { return this->pending.load() == 0; });
+        this->stopping = true;
+    }
+    this->workAvailable.notify_all();
+    this->workers.clear();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+    const size_t target = currentPool == this
+                              ? currentWorker
+                              : this->nextQueue.fetch_add(1, std::memory_order_relaxed) % this->queues.size();
+
+    this->pending.fetch_add(1);
+    {
+        Queue &queue = *this->queues[target];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    this->queued.fetch_add(1);
+
+    // Taking the lock orders the increment before any worker's check, so a worker about to sleep cannot miss it
+    {
+        std::lock_guard lock(this->stateMutex);
+    }
+    this->workAvailable.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock lock(this->stateMutex);
+    this->allDone.wait(lock, [&]() { return this->pending.load() == 0; });
+    if (this->failure)
+    {
+        std::rethrow_exception(std::exchange(this->failure, nullptr));
+    }
+}
+
+size_t WorkStealingPool::currentWorkerIndex() const
+{
+    return currentPool == this ? currentWorker : this->workerCount();
+}
+
+bool WorkStealingPool::take(const size_t worker, Task &task)
+{
+    // Newest task of our own first, since it is the most likely to still be in cache
+    {
+        Queue &own = *this->queues[worker];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            this->queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Then the oldest task of someone else, which tends to be the biggest piece of remaining work
+    for (size_t offset = 1; offset < this->queues.size(); offset++)
+    {
+        Queue &victim = *this->queues[(worker + offset) % this->queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            this->queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(const size_t worker)
+{
+    currentPool = this;
+    currentWorker = worker;
+
+    while (true)
+    {
+        Task task;
+        if (!this->take(worker, task))
+        {
+            std::unique_lock lock(this->stateMutex);
+            this->workAvailable.wait(lock, [&]() { return this->stopping || this->queued.load() > 0; });
+            if (this->stopping)
+            {
+                return;
+            }
+            continue;
+        }
+
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            std::lock_guard lock(this->stateMutex);
+            if (!this->failure)
+            {
+                this->failure = std::current_exception();
+            }
+        }
+
+        if (this->pending.fetch_sub(1) == 1)
+        {
+            std::lock_guard lock(this->stateMutex);
+            this->allDone.notify_all();
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "quick.h"
+#include "pool.h"
+#include "reader.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+namespace
+{
+constexpr std::string_view QUICK_TAG = "hasher-quick 1";
+// Samples adding up to no more than this are read all at once into memory. Bigger ones, such as from a huge sample
+// size or a file the samples cover whole, are streamed through the hashers one range after another instead
+constexpr uint64_t MAX_BUFFERED_SAMPLE_BYTES = 64 * 1024 * 1024;
+
+void updateAll(const std::vector<Hasher *> &hashers, const std::span<const byte> data, HashProgress *progress)
+{
+    for (Hasher *hasher : hashers)
+    {
+        // Samples can be larger than a single update takes
+        for (size_t done = 0; done < data.size(); done += BUFFER_SIZE)
+        {
+            const size_t length = std::min<size_t>(BUFFER_SIZE, data.size() - done);
+            hasher->updateWithBuffer(data.data() + done, static_cast<word32>(length));
+        }
+        if (progress != nullptr)
+        {
+            progress->algorithm(hasher->getAlgorithm()).bytesHashed.fetch_add(data.size(), std::memory_order_relaxed);
+        }
+    }
+}
+
+void updateLittleEndian(const std::vector<Hasher *> &hashers, const uint64_t value)
+{
+    byte bytes[8];
+    for (size_t i = 0; i < 8; i++)
+    {
+        bytes[i] = static_cast<byte>(value >> (8 * i));
+    }
+    updateAll(hashers, bytes, nullptr);
+}
+
+// Read exactly length bytes at offset, failing if the file shrank since its size was taken
+std::vector<byte> readRange(const std::string &filePath, const uint64_t offset, const uint64_t length,
+                            const HashOptions &options)
+{
+    std::vector<byte> data;
+    data.reserve(length);
+    const FileReaderPtr reader = openFileRangeReader(filePath, offset, length, options);
+    while (!reader->finished() && data.size() < length)
+    {
+        const std::span<const byte> part = reader->read(0);
+        data.insert(data.end(), part.begin(), part.end());
+        reader->release(0);
+    }
+    if (data.size() != length)
+    {
+        throw std::runtime_error(std::format("File changed size while sampling: {}", filePath));
+    }
+    return data;
+}
+
+// Hash exactly length bytes at offset a buffer at a time, failing like readRange if the file shrank. Returns false if
+// cancelled part way
+template <typename Cancelled>
+bool streamRange(const std::string &filePath, const uint64_t offset, const uint64_t length, const HashOptions &options,
+                 const std::vector<Hasher *> &hashers, const Cancelled &isCancelled)
+{
+    uint64_t done = 0;
+    const FileReaderPtr reader = openFileRangeReader(filePath, offset, length, options);
+    while (!reader->finished() && done < length)
+    {
+        if (isCancelled())
+        {
+            return false;
+        }
+        const std::span<const byte> part = reader->read(0);
+        updateAll(hashers, part, options.progress);
+        reader->release(0);
+        done += part.size();
+        if (options.progress != nullptr)
+        {
+            options.progress->bytesRead.fetch_add(part.size(), std::memory_order_relaxed);
+        }
+    }
+    if (done != length)
+    {
+        throw std::runtime_error(std::format("File changed size while sampling: {}", filePath));
+    }
+    return true;
+}
+} // namespace
+
+std::vector<std::pair<uint64_t, uint64_t>> quickHashRanges(const uint64_t fileSize,
+                                                           const QuickHashOptions &quickOptions)
+{
+    const uint64_t size = quickOptions.sampleSize;
+    const uint64_t blocks = quickOptions.samples + 2;
+    if (size == 0 || fileSize / blocks <= size)
+    {
+        return {{0, fileSize}};
+    }
+
+    // Block k starts k / (blocks - 1) of the way to the tail, computed without overflowing on huge files
+    const uint64_t span = fileSize - size;
+    const uint64_t gaps = blocks - 1;
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    for (uint64_t k = 0; k < blocks; k++)
+    {
+        ranges.emplace_back(span / gaps * k + span % gaps * k / gaps, size);
+    }
+    return ranges;
+}
+
+QuickHashResult calculateQuickDigests(const std::string &filePath, const std::vector<wc_HashType> &hashesToCalculate,
+                                      const QuickHashOptions &quickOptions, const HashOptions &options,
+                                      const size_t jobs,
+                                      const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+{
+    auto isCancelled = [&]() { return shouldCancel && shouldCancel->get().load(); };
+
+    QuickHashResult result;
+    if (isCancelled())
+    {
+        return result;
+    }
+    std::error_code error;
+    result.fileSize = std::filesystem::file_size(filePath, error);
+    if (error)
+    {
+        throw std::runtime_error(std::format("Failed to open file: {}", filePath));
+    }
+
+    const std::vector<std::pair<uint64_t, uint64_t>> ranges = quickHashRanges(result.fileSize, quickOptions);
+    result.complete = ranges.size() == 1;
+    for (const auto &[offset, length] : ranges)
+    {
+        result.sampledBytes += length;
+    }
+    if (options.progress != nullptr)
+    {
+        options.progress->totalBytes.store(result.sampledBytes, std::memory_order_relaxed);
+    }
+
+    // Every hasher lives in one allocation, skipping algorithms that were asked for twice
+    const auto storage = std::make_unique<std::optional<Hasher>[]>(hashesToCalculate.size());
+    std::vector<Hasher *> hashers;
+    for (const wc_HashType algorithm : hashesToCalculate)
+    {
+        if (std::ranges::none_of(hashers, [&](const Hasher *hasher) { return hasher->getAlgorithm() == algorithm; }))
+        {
+            hashers.push_back(&storage[hashers.size()].emplace(algorithm));
+        }
+    }
+
+    updateAll(hashers, std::span(reinterpret_cast<const byte *>(QUICK_TAG.data()), QUICK_TAG.size()), nullptr);
+    updateLittleEndian(hashers, result.fileSize);
+    updateLittleEndian(hashers, quickOptions.sampleSize);
+    updateLittleEndian(hashers, ranges.size());
+
+    // Every range is read at once, since on disks that seek or queue requests the reads are what take the time, as
+    // long as that fits in memory
+    std::vector<std::vector<byte>> samples(ranges.size());
+    const bool buffered = result.sampledBytes <= MAX_BUFFERED_SAMPLE_BYTES;
+    if (buffered)
+    {
+        WorkStealingPool pool(std::clamp<size_t>(jobs, 1, ranges.size()));
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            pool.submit([&, i]() {
+                if (isCancelled())
+                {
+                    return;
+                }
+                samples[i] = readRange(filePath, ranges[i].first, ranges[i].second, options);
+                if (options.progress != nullptr)
+                {
+                    options.progress->bytesRead.fetch_add(ranges[i].second, std::memory_order_relaxed);
+                }
+            });
+        }
+        pool.wait();
+    }
+    if (isCancelled())
+    {
+        return result;
+    }
+
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        updateLittleEndian(hashers, ranges[i].first);
+        if (buffered)
+        {
+            updateAll(hashers, samples[i], options.progress);
+        }
+        else if (!streamRange(filePath, ranges[i].first, ranges[i].second, options, hashers, isCancelled))
+        {
+            return result;
+        }
+    }
+
+    for (Hasher *hasher : hashers)
+    {
+        hasher->finalize();
+        result.digests.set(hasher->getAlgorithm(), hasher->getRawDigest());
+    }
+    return result;
+}
\ No newline at end of file
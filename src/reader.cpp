@@ -0,0 +1,1158 @@
+#include "reader.h"
+#include "arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cerrno>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HASHER_HAVE_MMAP
+#endif
+
+#if defined(__linux__) && defined(O_DIRECT)
+#define HASHER_HAVE_DIRECT_IO
+#endif
+
+#if defined(HASHER_HAVE_DIRECT_IO) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define HASHER_HAVE_IO_URING
+#endif
+
+constexpr size_t MMAP_WINDOW_SIZE = 16 * 1024 * 1024; // 16 MB
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;    // 2 MB
+constexpr size_t DEFAULT_DIRECT_ALIGNMENT = 4096;
+
+namespace
+{
+// Size of a regular file, or nothing for anything else. Asks stat directly where there is one, since going through
+// std::filesystem would allocate a path for every file
+std::optional<uint64_t> regularFileSize(const std::string &filePath)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat status{};
+    if (stat(filePath.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint64_t>(status.st_size);
+#else
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(filePath, error))
+    {
+        return std::nullopt;
+    }
+    const uintmax_t size = std::filesystem::file_size(filePath, error);
+    return error ? std::nullopt : std::optional<uint64_t>(size);
+#endif
+}
+
+// A closed reader of the given kind parked in the arena by an earlier file, if there is one
+template <typename Reader> std::unique_ptr<Reader> takeParked(HashArena *arena)
+{
+    if (arena == nullptr)
+    {
+        return nullptr;
+    }
+    return std::unique_ptr<Reader>(static_cast<Reader *>(arena->takeReader(typeid(Reader)).release()));
+}
+
+// Reads through std::ifstream into buffers owned by the reader, or borrowed from the arena when there is one. Works
+// for anything that can be opened
+class StreamReader final : public FileReader
+{
+    std::ifstream file;
+    // Every read fills a whole buffer of ours, so the stream is left unbuffered. libstdc++ still allocates a one byte
+    // buffer on every open of an unbuffered stream, unless it is given one that outlives the file like this
+    char streamBuffer[1] = {};
+    std::vector<std::vector<byte>> buffers;
+    HashArena *arena;
+    // Bytes left in the requested range, if the reader was opened on one
+    std::optional<uint64_t> remaining;
+
+  public:
+    StreamReader(const size_t slotCount, HashArena *arena)
+        : buffers(arena != nullptr ? 0 : slotCount), arena(arena)
+    {
+        this->file.rdbuf()->pubsetbuf(this->streamBuffer, sizeof(this->streamBuffer));
+    }
+
+    void open(const std::string &filePath, const uint64_t offset = 0,
+              const std::optional<uint64_t> length = std::nullopt)
+    {
+        this->file.open(filePath, std::ios::binary);
+        if (!this->file.is_open())
+        {
+            throw std::runtime_error(std::format("Failed to open file: {}", filePath));
+        }
+
+        this->fileSize.reset();
+        if (const std::optional<uint64_t> size = regularFileSize(filePath))
+        {
+            const uint64_t available = *size > offset ? *size - offset : 0;
+            this->fileSize = length ? std::min(*length, available) : available;
+        }
+
+        if (offset > 0 && !this->file.seekg(static_cast<std::streamoff>(offset)))
+        {
+            throw std::runtime_error(std::format("Failed to seek in file: {}", filePath));
+        }
+        this->remaining = length;
+        this->atEnd = this->remaining == 0;
+    }
+
+    std::span<const byte> read(const size_t slot) override
+    {
+        // Allocate lazily so synchronous reads only ever touch one buffer
+        std::span<byte> buffer;
+        if (this->arena != nullptr)
+        {
+            buffer = this->arena->readBuffer(slot);
+        }
+        else
+        {
+            if (this->buffers[slot].empty())
+            {
+                this->buffers[slot].resize(BUFFER_SIZE);
+            }
+            buffer = this->buffers[slot];
+        }
+
+        const size_t wanted =
+            this->remaining ? static_cast<size_t>(std::min<uint64_t>(BUFFER_SIZE, *this->remaining)) : BUFFER_SIZE;
+        this->file.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(wanted));
+        if (this->file.bad())
+        {
+            throw std::runtime_error("Failed to read file!");
+        }
+
+        const size_t length = static_cast<size_t>(this->file.gcount());
+        if (this->remaining)
+        {
+            *this->remaining -= length;
+        }
+        this->atEnd = !this->file || this->remaining == 0;
+
+        return {buffer.data(), length};
+    }
+
+    bool closeForReuse() override
+    {
+        this->file.close();
+        this->file.clear();
+        return true;
+    }
+};
+
+FileReaderPtr openStreamReader(const std::string &filePath, const size_t slotCount, HashArena *arena,
+                               const uint64_t offset = 0, const std::optional<uint64_t> length = std::nullopt)
+{
+    std::unique_ptr<StreamReader> reader = takeParked<StreamReader>(arena);
+    if (!reader)
+    {
+        reader = std::make_unique<StreamReader>(slotCount, arena);
+    }
+    reader->open(filePath, offset, length);
+    return FileReaderPtr(reader.release(), FileReaderDeleter{arena});
+}
+
+#ifdef HASHER_HAVE_MMAP
+// Hands out windows of a read-only mapping so hashers read the page cache directly without a copy. Each window is
+// unmapped as soon as its slot is released, keeping the resident size bounded by slotCount windows.
+class MmapReader final : public FileReader
+{
+    int descriptor = -1;
+    uint64_t offset = 0;
+    uint64_t end = 0;
+    size_t pageSize;
+    std::vector<std::span<byte>> windows;
+
+    void unmapAll()
+    {
+        for (size_t slot = 0; slot < this->windows.size(); slot++)
+        {
+            this->release(slot);
+        }
+    }
+
+  public:
+    MmapReader() : pageSize(static_cast<size_t>(sysconf(_SC_PAGESIZE)))
+    {
+    }
+
+    MmapReader(const MmapReader &) = delete;
+    MmapReader &operator=(const MmapReader &) = delete;
+
+    // Take over an open descriptor and read from begin to end of it
+    void open(const int descriptor, const uint64_t begin, const uint64_t end, const size_t slotCount)
+    {
+        this->descriptor = descriptor;
+        this->offset = begin;
+        this->end = end;
+        this->windows.assign(slotCount, {});
+        this->fileSize = end - begin;
+        this->atEnd = begin == end;
+    }
+
+    std::span<const byte> read(const size_t slot) override
+    {
+        this->release(slot);
+
+        // Pages past the end of a file that shrank since it was opened raise SIGBUS, so stop where the file now ends,
+        // the same short read a stream would see. Truncation while a window is being hashed is still fatal
+        struct stat status{};
+        if (fstat(this->descriptor, &status) != 0)
+        {
+            throw std::runtime_error("Failed to read file!");
+        }
+        this->end = std::min(this->end, std::max(this->offset, static_cast<uint64_t>(status.st_size)));
+
+        const size_t length = static_cast<size_t>(std::min<uint64_t>(MMAP_WINDOW_SIZE, this->end - this->offset));
+        if (length == 0)
+        {
+            this->atEnd = true;
+            return {};
+        }
+
+        // Mappings have to start on a page boundary, which a range need not
+        const size_t lead = static_cast<size_t>(this->offset % this->pageSize);
+        void *mapping = mmap(nullptr, lead + length, PROT_READ, MAP_PRIVATE, this->descriptor,
+                             static_cast<off_t>(this->offset - lead));
+        if (mapping == MAP_FAILED)
+        {
+            throw std::runtime_error("Failed to map file!");
+        }
+        // Ask for aggressive readahead on this window, which the hashers will only get to once earlier slots drain
+        madvise(mapping, lead + length, MADV_SEQUENTIAL);
+        madvise(mapping, lead + length, MADV_WILLNEED);
+
+        this->windows[slot] = {static_cast<byte *>(mapping) + lead, length};
+        this->offset += length;
+        this->atEnd = this->offset >= this->end;
+
+        return this->windows[slot];
+    }
+
+    void release(const size_t slot) override
+    {
+        std::span<byte> &window = this->windows[slot];
+        if (!window.empty())
+        {
+            const size_t lead = reinterpret_cast<uintptr_t>(window.data()) % this->pageSize;
+            munmap(window.data() - lead, lead + window.size());
+            window = {};
+        }
+    }
+
+    bool closeForReuse() override
+    {
+        this->unmapAll();
+        close(this->descriptor);
+        this->descriptor = -1;
+        return true;
+    }
+
+    ~MmapReader() override
+    {
+        this->unmapAll();
+        if (this->descriptor >= 0)
+        {
+            close(this->descriptor);
+        }
+    }
+};
+
+// Only regular files that the kernel agrees to map get the mmap path; pipes, devices and the like are streamed
+FileReaderPtr tryMmapReader(const std::string &filePath, const size_t slotCount, HashArena *arena,
+                            const uint64_t offset = 0, const uint64_t length = std::numeric_limits<uint64_t>::max())
+{
+    const int descriptor = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat status{};
+    if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size <= 0 ||
+        static_cast<uint64_t>(status.st_size) > static_cast<uint64_t>(std::numeric_limits<off_t>::max()))
+    {
+        close(descriptor);
+        return nullptr;
+    }
+
+    // Probe a single page, since some filesystems refuse to map at all
+    const size_t probeLength = std::min<size_t>(static_cast<size_t>(sysconf(_SC_PAGESIZE)), status.st_size);
+    void *probe = mmap(nullptr, probeLength, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (probe == MAP_FAILED)
+    {
+        close(descriptor);
+        return nullptr;
+    }
+    munmap(probe, probeLength);
+
+    std::unique_ptr<MmapReader> reader = takeParked<MmapReader>(arena);
+    if (!reader)
+    {
+        reader = std::make_unique<MmapReader>();
+    }
+    const uint64_t size = static_cast<uint64_t>(status.st_size);
+    const uint64_t begin = std::min(offset, size);
+    reader->open(descriptor, begin, begin + std::min(length, size - begin), slotCount);
+    return FileReaderPtr(reader.release(), FileReaderDeleter{arena});
+}
+
+// Anonymous memory holding one BUFFER_SIZE buffer per slot for readers that need page aligned buffers. With huge
+// pages it first tries explicitly reserved ones, then asks for transparent huge pages on a 2 MB aligned region.
+class AlignedBuffers
+{
+    byte *memory = nullptr;
+    size_t mappedSize = 0;
+    size_t slots;
+    bool hugePages;
+
+  public:
+    AlignedBuffers(const size_t slotCount, const bool hugePages) : slots(slotCount), hugePages(hugePages)
+    {
+        const size_t size = slotCount * BUFFER_SIZE;
+        if (hugePages)
+        {
+            const size_t hugeSize = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+#ifdef MAP_HUGETLB
+            void *reserved =
+                mmap(nullptr, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (reserved != MAP_FAILED)
+            {
+                this->memory = static_cast<byte *>(reserved);
+                this->mappedSize = hugeSize;
+                return;
+            }
+#endif
+            // Over-allocate so the region can be trimmed to start on a huge page boundary
+            void *mapping = mmap(nullptr, hugeSize + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapping == MAP_FAILED)
+            {
+                throw std::system_error(errno, std::system_category(), "mmap read buffers");
+            }
+            const auto start = reinterpret_cast<uintptr_t>(mapping);
+            const uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+            if (aligned > start)
+            {
+                munmap(mapping, aligned - start);
+            }
+            munmap(reinterpret_cast<void *>(aligned + hugeSize), start + HUGE_PAGE_SIZE - aligned);
+            this->memory = reinterpret_cast<byte *>(aligned);
+            this->mappedSize = hugeSize;
+#ifdef MADV_HUGEPAGE
+            madvise(this->memory, this->mappedSize, MADV_HUGEPAGE);
+#endif
+            return;
+        }
+
+        void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::system_error(errno, std::system_category(), "mmap read buffers");
+        }
+        this->memory = static_cast<byte *>(mapping);
+        this->mappedSize = size;
+    }
+
+    AlignedBuffers(const AlignedBuffers &) = delete;
+    AlignedBuffers &operator=(const AlignedBuffers &) = delete;
+
+    ~AlignedBuffers()
+    {
+        munmap(this->memory, this->mappedSize);
+    }
+
+    [[nodiscard]] std::span<byte> buffer(const size_t slot) const
+    {
+        return {this->memory + slot * BUFFER_SIZE, BUFFER_SIZE};
+    }
+
+    // Whether these are the buffers AlignedBuffers(slotCount, hugePages) would make
+    [[nodiscard]] bool matches(const size_t slotCount, const bool hugePages) const
+    {
+        return this->slots == slotCount && this->hugePages == hugePages;
+    }
+};
+#endif
+
+#ifdef HASHER_HAVE_DIRECT_IO
+// Offset and length alignment O_DIRECT needs for a file, which is the logical block size of the device behind it.
+// Returns 0 when the filesystem does not support direct I/O for the file at all
+size_t directAlignment(const int descriptor)
+{
+#ifdef STATX_DIOALIGN
+    struct statx status{};
+    if (statx(descriptor, "", AT_EMPTY_PATH, STATX_DIOALIGN, &status) == 0 && (status.stx_mask & STATX_DIOALIGN) != 0)
+    {
+        const size_t alignment = std::max(status.stx_dio_mem_align, status.stx_dio_offset_align);
+        return alignment <= BUFFER_SIZE ? alignment : 0;
+    }
+#endif
+    // Older kernels cannot say, but 4 KB covers both 512 byte and 4K native devices
+    return DEFAULT_DIRECT_ALIGNMENT;
+}
+
+// Open a file for O_DIRECT reads, returning -1 if the filesystem does not support them
+int openDirect(const std::string &filePath, size_t &alignment)
+{
+    const int descriptor = open(filePath.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+    if (descriptor < 0)
+    {
+        return -1;
+    }
+    alignment = directAlignment(descriptor);
+    if (alignment == 0)
+    {
+        close(descriptor);
+        return -1;
+    }
+    return descriptor;
+}
+
+// Buffered pread used to finish reads O_DIRECT rejects, such as one continuing from an unaligned offset. The pages
+// are dropped from the cache again afterwards, so direct mode still leaves the page cache alone
+size_t readBuffered(const std::string &filePath, int &descriptor, byte *destination, const uint64_t offset,
+                    const size_t length)
+{
+    if (descriptor < 0)
+    {
+        descriptor = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0)
+        {
+            throw std::system_error(errno, std::system_category(), "Failed to open file");
+        }
+    }
+
+    size_t filled = 0;
+    while (filled < length)
+    {
+        const ssize_t result =
+            pread(descriptor, destination + filled, length - filled, static_cast<off_t>(offset + filled));
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result < 0)
+        {
+            throw std::system_error(errno, std::system_category(), "Failed to read file");
+        }
+        if (result == 0)
+        {
+            break;
+        }
+        filled += static_cast<size_t>(result);
+    }
+    posix_fadvise(descriptor, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_DONTNEED);
+    return filled;
+}
+
+// Reads with O_DIRECT into aligned buffers so multi-terabyte runs do not evict everything else from the page cache.
+// Requests are always whole blocks; the kernel stops at end of file, so the unaligned tail still comes back exact.
+class DirectReader final : public FileReader
+{
+    std::string filePath;
+    int descriptor = -1;
+    int bufferedDescriptor = -1;
+    size_t alignment = 0;
+    uint64_t offset = 0;
+    AlignedBuffers buffers;
+
+    void closeDescriptors()
+    {
+        if (this->bufferedDescriptor >= 0)
+        {
+            close(this->bufferedDescriptor);
+            this->bufferedDescriptor = -1;
+        }
+        if (this->descriptor >= 0)
+        {
+            close(this->descriptor);
+            this->descriptor = -1;
+        }
+    }
+
+  public:
+    DirectReader(const size_t slotCount, const bool hugePages) : buffers(slotCount, hugePages)
+    {
+    }
+
+    DirectReader(const DirectReader &) = delete;
+    DirectReader &operator=(const DirectReader &) = delete;
+
+    [[nodiscard]] bool matches(const size_t slotCount, const bool hugePages) const
+    {
+        return this->buffers.matches(slotCount, hugePages);
+    }
+
+    // Take over a descriptor opened with O_DIRECT. The path is kept for the buffered reads that finish what
+    // O_DIRECT rejects
+    void open(const std::string &filePath, const int descriptor, const size_t alignment, const uint64_t size)
+    {
+        this->filePath = filePath;
+        this->descriptor = descriptor;
+        this->alignment = alignment;
+        this->offset = 0;
+        this->fileSize = size;
+        this->atEnd = size == 0;
+    }
+
+    std::span<const byte> read(const size_t slot) override
+    {
+        const std::span<byte> buffer = this->buffers.buffer(slot);
+        const size_t length = static_cast<size_t>(std::min<uint64_t>(BUFFER_SIZE, *this->fileSize - this->offset));
+
+        size_t filled = 0;
+        while (filled < length)
+        {
+            const uint64_t position = this->offset + filled;
+            if (position % this->alignment != 0)
+            {
+                filled += readBuffered(this->filePath, this->bufferedDescriptor, buffer.data() + filled, position,
+                                       length - filled);
+                break;
+            }
+
+            const size_t request = (length - filled + this->alignment - 1) / this->alignment * this->alignment;
+            const ssize_t result =
+                pread(this->descriptor, buffer.data() + filled, request, static_cast<off_t>(position));
+            if (result < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (result < 0 && errno == EINVAL)
+            {
+                // Some filesystems refuse direct reads that run past the end of the file
+                filled += readBuffered(this->filePath, this->bufferedDescriptor, buffer.data() + filled, position,
+                                       length - filled);
+                break;
+            }
+            if (result < 0)
+            {
+                throw std::system_error(errno, std::system_category(), "Failed to read file");
+            }
+            if (result == 0)
+            {
+                break;
+            }
+            filled = std::min(length, filled + static_cast<size_t>(result));
+        }
+
+        this->offset += filled;
+        this->atEnd = this->offset >= *this->fileSize || filled < length;
+        return buffer.first(filled);
+    }
+
+    bool closeForReuse() override
+    {
+        this->closeDescriptors();
+        return true;
+    }
+
+    ~DirectReader() override
+    {
+        this->closeDescriptors();
+    }
+};
+
+FileReaderPtr tryDirectReader(const std::string &filePath, const HashOptions &options, const size_t slotCount)
+{
+    size_t alignment = 0;
+    const int descriptor = openDirect(filePath, alignment);
+    if (descriptor < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat status{};
+    if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        close(descriptor);
+        return nullptr;
+    }
+
+    // A parked reader with buffers of another shape is dropped, since remapping them is all a new reader costs
+    std::unique_ptr<DirectReader> reader = takeParked<DirectReader>(options.arena);
+    if (!reader || !reader->matches(slotCount, options.hugePages))
+    {
+        reader = std::make_unique<DirectReader>(slotCount, options.hugePages);
+    }
+    reader->open(filePath, descriptor, alignment, static_cast<uint64_t>(status.st_size));
+    return FileReaderPtr(reader.release(), FileReaderDeleter{options.arena});
+}
+#endif
+
+#ifdef HASHER_HAVE_IO_URING
+// Minimal io_uring over the raw syscalls, owning one aligned buffer per slot that is registered with the kernel when
+// the memlock limit allows it
+class IoUring
+{
+    int ringDescriptor = -1;
+    void *submissionRing = MAP_FAILED;
+    size_t submissionRingSize = 0;
+    void *completionRing = MAP_FAILED;
+    size_t completionRingSize = 0;
+    io_uring_sqe *submissionEntries = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t submissionEntriesSize = 0;
+
+    unsigned *submissionTail = nullptr;
+    unsigned submissionMask = 0;
+    unsigned *submissionArray = nullptr;
+    unsigned *completionHead = nullptr;
+    unsigned *completionTail = nullptr;
+    unsigned completionMask = 0;
+    io_uring_cqe *completionEntries = nullptr;
+    unsigned pendingSubmissions = 0;
+
+    AlignedBuffers buffers;
+    size_t slots;
+    bool hugePages;
+    bool registered = false;
+
+    void teardown()
+    {
+        if (this->submissionEntries != MAP_FAILED)
+        {
+            munmap(this->submissionEntries, this->submissionEntriesSize);
+        }
+        if (this->completionRing != MAP_FAILED)
+        {
+            munmap(this->completionRing, this->completionRingSize);
+        }
+        if (this->submissionRing != MAP_FAILED)
+        {
+            munmap(this->submissionRing, this->submissionRingSize);
+        }
+        if (this->ringDescriptor >= 0)
+        {
+            close(this->ringDescriptor);
+        }
+    }
+
+    // The destructor does not run for a half built ring, so clean up before reporting the failure
+    [[noreturn]] void fail(const char *operation)
+    {
+        const int error = errno;
+        this->teardown();
+        throw std::system_error(error, std::system_category(), operation);
+    }
+
+  public:
+    IoUring(const size_t slotCount, const bool hugePages)
+        : buffers(slotCount, hugePages), slots(slotCount), hugePages(hugePages)
+    {
+        io_uring_params params{};
+        this->ringDescriptor =
+            static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(slotCount), &params));
+        if (this->ringDescriptor < 0)
+        {
+            this->fail("io_uring_setup");
+        }
+
+        this->submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        this->completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap)
+        {
+            this->submissionRingSize = this->completionRingSize =
+                std::max(this->submissionRingSize, this->completionRingSize);
+        }
+
+        this->submissionRing = mmap(nullptr, this->submissionRingSize, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, this->ringDescriptor, IORING_OFF_SQ_RING);
+        if (this->submissionRing == MAP_FAILED)
+        {
+            this->fail("mmap io_uring submission ring");
+        }
+        if (!singleMap)
+        {
+            this->completionRing = mmap(nullptr, this->completionRingSize, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, this->ringDescriptor, IORING_OFF_CQ_RING);
+            if (this->completionRing == MAP_FAILED)
+            {
+                this->fail("mmap io_uring completion ring");
+            }
+        }
+        this->submissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+        this->submissionEntries = static_cast<io_uring_sqe *>(mmap(nullptr, this->submissionEntriesSize,
+                                                                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                                   this->ringDescriptor, IORING_OFF_SQES));
+        if (this->submissionEntries == MAP_FAILED)
+        {
+            this->fail("mmap io_uring submission entries");
+        }
+
+        auto *submission = static_cast<byte *>(this->submissionRing);
+        auto *completion = static_cast<byte *>(singleMap ? this->submissionRing : this->completionRing);
+        this->submissionTail = reinterpret_cast<unsigned *>(submission + params.sq_off.tail);
+        this->submissionMask = *reinterpret_cast<unsigned *>(submission + params.sq_off.ring_mask);
+        this->submissionArray = reinterpret_cast<unsigned *>(submission + params.sq_off.array);
+        this->completionHead = reinterpret_cast<unsigned *>(completion + params.cq_off.head);
+        this->completionTail = reinterpret_cast<unsigned *>(completion + params.cq_off.tail);
+        this->completionMask = *reinterpret_cast<unsigned *>(completion + params.cq_off.ring_mask);
+        this->completionEntries = reinterpret_cast<io_uring_cqe *>(completion + params.cq_off.cqes);
+
+        // Registered buffers save the kernel pinning pages on every read, but count against RLIMIT_MEMLOCK on older
+        // kernels, so plain reads are used when registration is refused
+        std::vector<iovec> vectors(slotCount);
+        for (size_t slot = 0; slot < slotCount; slot++)
+        {
+            vectors[slot] = {this->buffer(slot).data(), BUFFER_SIZE};
+        }
+        this->registered = syscall(__NR_io_uring_register, this->ringDescriptor, IORING_REGISTER_BUFFERS,
+                                   vectors.data(), static_cast<unsigned>(slotCount)) == 0;
+    }
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    ~IoUring()
+    {
+        this->teardown();
+    }
+
+    [[nodiscard]] size_t slotCount() const
+    {
+        return this->slots;
+    }
+
+    [[nodiscard]] bool usesHugePages() const
+    {
+        return this->hugePages;
+    }
+
+    [[nodiscard]] std::span<byte> buffer(const size_t slot) const
+    {
+        return this->buffers.buffer(slot);
+    }
+
+    // Queue a read into a slot's buffer; it is handed to the kernel with the next wait
+    void queueRead(const int descriptor, const size_t slot, const uint64_t offset, const size_t bufferOffset,
+                   const size_t length)
+    {
+        const unsigned tail = *this->submissionTail;
+        const unsigned index = tail & this->submissionMask;
+        io_uring_sqe &entry = this->submissionEntries[index];
+        entry = {};
+        entry.opcode = this->registered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        entry.fd = descriptor;
+        entry.off = offset;
+        entry.addr = reinterpret_cast<uint64_t>(this->buffer(slot).data() + bufferOffset);
+        entry.len = static_cast<unsigned>(length);
+        entry.buf_index = static_cast<uint16_t>(slot);
+        entry.user_data = slot;
+        this->submissionArray[index] = index;
+        std::atomic_ref(*this->submissionTail).store(tail + 1, std::memory_order_release);
+        this->pendingSubmissions++;
+    }
+
+    // Submit queued reads and wait for the next completion, returning its slot and result
+    std::pair<size_t, int> waitCompletion()
+    {
+        for (;;)
+        {
+            const unsigned head = *this->completionHead;
+            if (head != std::atomic_ref(*this->completionTail).load(std::memory_order_acquire))
+            {
+                const io_uring_cqe &entry = this->completionEntries[head & this->completionMask];
+                const std::pair<size_t, int> completion = {static_cast<size_t>(entry.user_data), entry.res};
+                std::atomic_ref(*this->completionHead).store(head + 1, std::memory_order_release);
+                return completion;
+            }
+
+            const long submitted = syscall(__NR_io_uring_enter, this->ringDescriptor, this->pendingSubmissions, 1,
+                                           IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (submitted < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::system_category(), "io_uring_enter");
+            }
+            this->pendingSubmissions -= static_cast<unsigned>(submitted);
+        }
+    }
+};
+
+// Rings and their registered buffers are kept for the next file instead of being torn down, so a batch run sets up
+// one ring per concurrently hashed file rather than one per file
+std::mutex idleRingsMutex;
+std::vector<std::unique_ptr<IoUring>> idleRings;
+std::atomic ioUringUnavailable(false);
+
+std::unique_ptr<IoUring> takeRing(const size_t slotCount, const bool hugePages)
+{
+    {
+        std::lock_guard lock(idleRingsMutex);
+        const auto match = std::ranges::find_if(
+            idleRings, [&](const std::unique_ptr<IoUring> &ring) {
+                return ring->slotCount() == slotCount && ring->usesHugePages() == hugePages;
+            });
+        if (match != idleRings.end())
+        {
+            std::unique_ptr<IoUring> ring = std::move(*match);
+            idleRings.erase(match);
+            return ring;
+        }
+    }
+    return std::make_unique<IoUring>(slotCount, hugePages);
+}
+
+void returnRing(std::unique_ptr<IoUring> ring)
+{
+    std::lock_guard lock(idleRingsMutex);
+    idleRings.push_back(std::move(ring));
+}
+
+// Keeps a read in flight for every slot the hashers are not using, so the device sees up to slotCount outstanding
+// requests per file. Slot s always holds chunks s, s + slotCount, s + 2 * slotCount and so on.
+class IoUringReader final : public FileReader
+{
+    enum class SlotState
+    {
+        Idle,
+        InFlight,
+        Ready,
+        HandedOut,
+    };
+
+    struct Slot
+    {
+        SlotState state = SlotState::Idle;
+        uint64_t offset = 0;
+        size_t length = 0;
+        size_t filled = 0;
+    };
+
+    std::string filePath;
+    int descriptor = -1;
+    int bufferedDescriptor = -1;
+    // Block alignment when the file was opened with O_DIRECT, otherwise 0
+    size_t alignment = 0;
+    std::unique_ptr<IoUring> ring;
+    std::vector<Slot> slots;
+
+    // The kernel may still be writing into the buffers, so wait for every read before the ring is used again
+    void drain()
+    {
+        while (std::ranges::any_of(this->slots, [](const Slot &slot) { return slot.state == SlotState::InFlight; }))
+        {
+            // Each slot has at most one read queued, so its completion means the buffer is free again
+            const size_t completed = this->ring->waitCompletion().first;
+            this->slots[completed].state = SlotState::Idle;
+        }
+    }
+
+    void closeDescriptors()
+    {
+        if (this->bufferedDescriptor >= 0)
+        {
+            close(this->bufferedDescriptor);
+            this->bufferedDescriptor = -1;
+        }
+        if (this->descriptor >= 0)
+        {
+            close(this->descriptor);
+            this->descriptor = -1;
+        }
+    }
+
+    void submit(const size_t slot)
+    {
+        Slot &state = this->slots[slot];
+        state.filled = 0;
+        const uint64_t remaining = *this->fileSize - std::min(state.offset, *this->fileSize);
+        state.length = static_cast<size_t>(std::min<uint64_t>(BUFFER_SIZE, remaining));
+        if (state.length == 0)
+        {
+            state.state = SlotState::Idle;
+            return;
+        }
+        state.state = SlotState::InFlight;
+        this->queueRemainder(slot);
+    }
+
+    // Queue a read for the part of a slot's chunk that has not arrived yet
+    void queueRemainder(const size_t slot)
+    {
+        Slot &state = this->slots[slot];
+        const uint64_t position = state.offset + state.filled;
+        size_t request = state.length - state.filled;
+        if (this->alignment != 0)
+        {
+            if (position % this->alignment != 0)
+            {
+                this->finishBuffered(slot);
+                return;
+            }
+            request = (request + this->alignment - 1) / this->alignment * this->alignment;
+        }
+        this->ring->queueRead(this->descriptor, slot, position, state.filled, request);
+    }
+
+    void finishBuffered(const size_t slot)
+    {
+        Slot &state = this->slots[slot];
+        state.filled += readBuffered(this->filePath, this->bufferedDescriptor,
+                                     this->ring->buffer(slot).data() + state.filled, state.offset + state.filled,
+                                     state.length - state.filled);
+        state.state = SlotState::Ready;
+    }
+
+    void complete(const size_t slot, const int result)
+    {
+        Slot &state = this->slots[slot];
+        if (result == -EINTR || result == -EAGAIN)
+        {
+            this->queueRemainder(slot);
+            return;
+        }
+        if (result == -EINVAL && this->alignment != 0)
+        {
+            this->finishBuffered(slot);
+            return;
+        }
+        if (result < 0)
+        {
+            state.state = SlotState::Idle;
+            throw std::system_error(-result, std::system_category(), "Failed to read file");
+        }
+
+        state.filled = std::min(state.length, state.filled + static_cast<size_t>(result));
+        if (result == 0 || state.filled == state.length)
+        {
+            state.state = SlotState::Ready;
+            return;
+        }
+        // Short read, so ask for the rest of the chunk
+        this->queueRemainder(slot);
+    }
+
+  public:
+    explicit IoUringReader(std::unique_ptr<IoUring> ring) : ring(std::move(ring))
+    {
+        this->slots.resize(this->ring->slotCount());
+    }
+
+    IoUringReader(const IoUringReader &) = delete;
+    IoUringReader &operator=(const IoUringReader &) = delete;
+
+    [[nodiscard]] bool matches(const size_t slotCount, const bool hugePages) const
+    {
+        return this->ring->slotCount() == slotCount && this->ring->usesHugePages() == hugePages;
+    }
+
+    // Take over an open descriptor and start a read into every slot
+    void open(const std::string &filePath, const int descriptor, const size_t alignment, const uint64_t size)
+    {
+        this->filePath = filePath;
+        this->descriptor = descriptor;
+        this->alignment = alignment;
+        this->fileSize = size;
+        this->atEnd = false;
+        for (size_t slot = 0; slot < this->slots.size(); slot++)
+        {
+            this->slots[slot] = {.offset = slot * BUFFER_SIZE};
+            this->submit(slot);
+        }
+    }
+
+    std::span<const byte> read(const size_t slot) override
+    {
+        Slot &state = this->slots[slot];
+        while (state.state == SlotState::InFlight)
+        {
+            const auto [completed, result] = this->ring->waitCompletion();
+            this->complete(completed, result);
+        }
+        if (state.state != SlotState::Ready)
+        {
+            this->atEnd = true;
+            return {};
+        }
+
+        state.state = SlotState::HandedOut;
+        this->atEnd = state.offset + state.filled >= *this->fileSize || state.filled < state.length;
+        return this->ring->buffer(slot).first(state.filled);
+    }
+
+    void release(const size_t slot) override
+    {
+        Slot &state = this->slots[slot];
+        if (state.state == SlotState::HandedOut)
+        {
+            state.offset += this->slots.size() * BUFFER_SIZE;
+            this->submit(slot);
+        }
+    }
+
+    // The ring stays with the reader while it is parked
+    bool closeForReuse() override
+    {
+        try
+        {
+            this->drain();
+        }
+        catch (const std::exception &)
+        {
+            // Dropping the ring tears it down, which also cancels anything still in flight
+            this->ring.reset();
+        }
+        this->closeDescriptors();
+        return this->ring != nullptr;
+    }
+
+    ~IoUringReader() override
+    {
+        try
+        {
+            if (this->ring)
+            {
+                this->drain();
+                returnRing(std::move(this->ring));
+            }
+        }
+        catch (const std::exception &)
+        {
+            // Dropping the ring tears it down, which also cancels anything still in flight
+        }
+        this->closeDescriptors();
+    }
+};
+
+FileReaderPtr tryIoUringReader(const std::string &filePath, const HashOptions &options, const size_t slotCount)
+{
+    if (ioUringUnavailable.load())
+    {
+        return nullptr;
+    }
+
+    size_t alignment = 0;
+    int descriptor = options.directIo ? openDirect(filePath, alignment) : -1;
+    if (descriptor < 0)
+    {
+        alignment = 0;
+        descriptor = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (descriptor < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat status{};
+    if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        close(descriptor);
+        return nullptr;
+    }
+
+    // A parked reader keeps its ring, unless the ring has the wrong number or kind of buffers
+    std::unique_ptr<IoUringReader> reader = takeParked<IoUringReader>(options.arena);
+    if (!reader || !reader->matches(slotCount, options.hugePages))
+    {
+        std::unique_ptr<IoUring> ring;
+        try
+        {
+            ring = takeRing(slotCount, options.hugePages);
+        }
+        catch (const std::system_error &)
+        {
+            // Kernels without io_uring, or sandboxes that block it, get the other readers from now on
+            ioUringUnavailable.store(true);
+            close(descriptor);
+            return nullptr;
+        }
+        reader = std::make_unique<IoUringReader>(std::move(ring));
+    }
+    reader->open(filePath, descriptor, alignment, static_cast<uint64_t>(status.st_size));
+    return FileReaderPtr(reader.release(), FileReaderDeleter{options.arena});
+}
+#endif
+} // namespace
+
+void FileReaderDeleter::operator()(FileReader *reader) const
+{
+    std::unique_ptr<FileReader> owned(reader);
+    if (this->arena != nullptr && owned->closeForReuse())
+    {
+        this->arena->parkReader(std::move(owned));
+    }
+}
+
+FileReaderPtr openFileReader(const std::string &filePath, [[maybe_unused]] const HashOptions &options,
+                             const size_t slotCount)
+{
+#ifdef HASHER_HAVE_IO_URING
+    if (options.reader == ReaderBackend::IoUring)
+    {
+        if (FileReaderPtr reader = tryIoUringReader(filePath, options, slotCount))
+        {
+            return reader;
+        }
+    }
+#endif
+
+#ifdef HASHER_HAVE_DIRECT_IO
+    if (options.directIo)
+    {
+        // Filesystems without O_DIRECT support fall through to the cached readers
+        if (FileReaderPtr reader = tryDirectReader(filePath, options, slotCount))
+        {
+            return reader;
+        }
+    }
+#endif
+
+#ifdef HASHER_HAVE_MMAP
+    // Only when asked for: a file truncated under a mapping kills the whole process, see ReaderBackend::Mmap
+    if (options.reader == ReaderBackend::Mmap)
+    {
+        if (FileReaderPtr reader = tryMmapReader(filePath, slotCount, options.arena))
+        {
+            return reader;
+        }
+    }
+#endif
+
+    return openStreamReader(filePath, slotCount, options.arena);
+}
+
+FileReaderPtr openFileRangeReader(const std::string &filePath, const uint64_t offset, const uint64_t length,
+                                  [[maybe_unused]] const HashOptions &options, const size_t slotCount)
+{
+#ifdef HASHER_HAVE_MMAP
+    if (options.reader == ReaderBackend::Mmap && length > BUFFER_SIZE)
+    {
+        if (FileReaderPtr reader = tryMmapReader(filePath, slotCount, options.arena, offset, length))
+        {
+            return reader;
+        }
+    }
+#endif
+
+    return openStreamReader(filePath, slotCount, options.arena, offset, length);
+}
\ No newline at end of file
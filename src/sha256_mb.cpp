@@ -0,0 +1,150 @@
+#include "sha256_mb.h"
+#include "cpu.h"
+#include "sha256_mb_impl.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+constexpr size_t MAX_LANES = 8;
+
+// Where one lane is in its message: whole blocks are compressed straight from the message, then the padded tail of
+// one or two blocks from a copy
+struct Lane
+{
+    size_t message = 0;
+    const uint8_t *data = nullptr;
+    size_t blocks = 0;
+    size_t nextBlock = 0;
+    uint8_t tail[2 * SHA256_BLOCK_LEN] = {};
+    size_t tailBlocks = 0;
+    bool active = false;
+
+    void start(const size_t index, const std::span<const uint8_t> input)
+    {
+        this->message = index;
+        this->data = input.data();
+        this->blocks = input.size() / SHA256_BLOCK_LEN;
+        this->nextBlock = 0;
+        this->active = true;
+
+        // The rest of the message, a 1 bit, zeros and the length in bits as a big endian 64-bit number
+        const size_t remaining = input.size() % SHA256_BLOCK_LEN;
+        this->tailBlocks = remaining + 9 <= SHA256_BLOCK_LEN ? 1 : 2;
+        std::memset(this->tail, 0, sizeof(this->tail));
+        if (remaining > 0)
+        {
+            std::memcpy(this->tail, input.data() + this->blocks * SHA256_BLOCK_LEN, remaining);
+        }
+        this->tail[remaining] = 0x80;
+        const uint64_t bits = static_cast<uint64_t>(input.size()) * 8;
+        uint8_t *length = this->tail + this->tailBlocks * SHA256_BLOCK_LEN - 8;
+        for (size_t i = 0; i < 8; i++)
+        {
+            length[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+        }
+    }
+
+    [[nodiscard]] const uint8_t *block() const
+    {
+        if (this->nextBlock < this->blocks)
+        {
+            return this->data + this->nextBlock * SHA256_BLOCK_LEN;
+        }
+        return this->tail + (this->nextBlock - this->blocks) * SHA256_BLOCK_LEN;
+    }
+
+    // Move past the block just compressed, returning true once the padded tail is done
+    bool advance()
+    {
+        return ++this->nextBlock == this->blocks + this->tailBlocks;
+    }
+};
+
+using CompressFunction = void (*)(uint32_t *state, const uint8_t *const *blocks);
+
+void compressScalar(uint32_t *state, const uint8_t *const *blocks)
+{
+    sha256CompressLanes<Sha256Scalar>(state, blocks);
+}
+} // namespace
+
+size_t sha256MultiBufferLanes()
+{
+#ifdef HASHER_HAVE_SHA256_MB_X86
+    if (cpuFeatures().avx2)
+    {
+        return 8;
+    }
+#endif
+    return 1;
+}
+
+void sha256MultiBuffer(const std::span<const std::span<const uint8_t>> messages,
+                       const std::span<std::array<uint8_t, SHA256_MB_DIGEST_SIZE>> digests)
+{
+    if (digests.size() < messages.size())
+    {
+        throw std::invalid_argument("Every message needs room for its digest");
+    }
+
+    const size_t lanes = sha256MultiBufferLanes();
+    CompressFunction compress = compressScalar;
+#ifdef HASHER_HAVE_SHA256_MB_X86
+    if (lanes == 8)
+    {
+        compress = sha256CompressAvx2;
+    }
+#endif
+
+    // Idle lanes compress a block of zeros into a state nobody reads
+    static constexpr uint8_t IDLE_BLOCK[SHA256_BLOCK_LEN] = {};
+    Lane laneStates[MAX_LANES];
+    uint32_t state[8 * MAX_LANES];
+    const uint8_t *blocks[MAX_LANES];
+    size_t nextMessage = 0;
+
+    while (true)
+    {
+        size_t active = 0;
+        for (size_t lane = 0; lane < lanes; lane++)
+        {
+            if (!laneStates[lane].active && nextMessage < messages.size())
+            {
+                laneStates[lane].start(nextMessage, messages[nextMessage]);
+                nextMessage++;
+                for (size_t word = 0; word < 8; word++)
+                {
+                    state[word * lanes + lane] = SHA256_IV[word];
+                }
+            }
+            blocks[lane] = laneStates[lane].active ? laneStates[lane].block() : IDLE_BLOCK;
+            active += laneStates[lane].active ? 1 : 0;
+        }
+        if (active == 0)
+        {
+            return;
+        }
+
+        compress(state, blocks);
+
+        for (size_t lane = 0; lane < lanes; lane++)
+        {
+            if (!laneStates[lane].active || !laneStates[lane].advance())
+            {
+                continue;
+            }
+            std::array<uint8_t, SHA256_MB_DIGEST_SIZE> &digest = digests[laneStates[lane].message];
+            for (size_t word = 0; word < 8; word++)
+            {
+                const uint32_t value = state[word * lanes + lane];
+                for (size_t i = 0; i < 4; i++)
+                {
+                    digest[4 * word + i] = static_cast<uint8_t>(value >> (24 - 8 * i));
+                }
+            }
+            laneStates[lane].active = false;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "sha256_mb_impl.h"
+
+#ifdef HASHER_HAVE_SHA256_MB_X86
+#include <immintrin.h>
+
+namespace
+{
+struct Avx2
+{
+    using Vec = __m256i;
+    static constexpr size_t LANES = 8;
+
+    static Vec load(const uint32_t *words)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words));
+    }
+
+    static void store(uint32_t *words, const Vec value)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words), value);
+    }
+
+    static Vec set1(const uint32_t value)
+    {
+        return _mm256_set1_epi32(static_cast<int>(value));
+    }
+
+    static Vec add(const Vec a, const Vec b)
+    {
+        return _mm256_add_epi32(a, b);
+    }
+
+    static Vec bitXor(const Vec a, const Vec b)
+    {
+        return _mm256_xor_si256(a, b);
+    }
+
+    static Vec bitAnd(const Vec a, const Vec b)
+    {
+        return _mm256_and_si256(a, b);
+    }
+
+    static Vec bitOr(const Vec a, const Vec b)
+    {
+        return _mm256_or_si256(a, b);
+    }
+
+    static Vec andNot(const Vec a, const Vec b)
+    {
+        return _mm256_andnot_si256(a, b);
+    }
+
+    template <int Bits>
+    static Vec rotr(const Vec value)
+    {
+        return _mm256_or_si256(_mm256_srli_epi32(value, Bits), _mm256_slli_epi32(value, 32 - Bits));
+    }
+
+    template <int Bits>
+    static Vec shr(const Vec value)
+    {
+        return _mm256_srli_epi32(value, Bits);
+    }
+
+    // Each lane's block is loaded as two rows of eight words, and each 8x8 square is transposed so that vector i
+    // holds word i of every lane
+    static void loadMessage(const uint8_t *const *blocks, Vec message[16])
+    {
+        const Vec byteSwap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8,
+                                             9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+        for (size_t half = 0; half < 2; half++)
+        {
+            Vec rows[8];
+            for (size_t lane = 0; lane < LANES; lane++)
+            {
+                rows[lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(blocks[lane] + 32 * half));
+            }
+
+            // Pairs of lanes, then quads, then the two 128-bit halves
+            Vec pairs[8];
+            for (size_t i = 0; i < 4; i++)
+            {
+                pairs[2 * i] = _mm256_unpacklo_epi32(rows[2 * i], rows[2 * i + 1]);
+                pairs[2 * i + 1] = _mm256_unpackhi_epi32(rows[2 * i], rows[2 * i + 1]);
+            }
+            Vec quads[8];
+            for (size_t i = 0; i < 2; i++)
+            {
+                quads[4 * i] = _mm256_unpacklo_epi64(pairs[4 * i], pairs[4 * i + 2]);
+                quads[4 * i + 1] = _mm256_unpackhi_epi64(pairs[4 * i], pairs[4 * i + 2]);
+                quads[4 * i + 2] = _mm256_unpacklo_epi64(pairs[4 * i + 1], pairs[4 * i + 3]);
+                quads[4 * i + 3] = _mm256_unpackhi_epi64(pairs[4 * i + 1], pairs[4 * i + 3]);
+            }
+            Vec *words = message + 8 * half;
+            for (size_t i = 0; i < 4; i++)
+            {
+                words[i] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(quads[i], quads[i + 4], 0x20), byteSwap);
+                words[i + 4] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(quads[i], quads[i + 4], 0x31), byteSwap);
+            }
+        }
+    }
+};
+} // namespace
+
+void sha256CompressAvx2(uint32_t state[8 * 8], const uint8_t *const blocks[8])
+{
+    sha256CompressLanes<Avx2>(state, blocks);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,402 @@
+#include "tree.h"
+#include "arena.h"
+#include "cache.h"
+#include "pool.h"
+#include "reader.h"
+#include "sha256_mb.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// Small files are handed out in batches so a tree of millions of tiny files does not cost a task per file
+constexpr size_t BATCH_FILES = 64;
+// Files of a batch up to this size are read whole, so their SHA-256 can be computed side by side in SIMD lanes
+constexpr uint64_t MULTI_BUFFER_FILE_SIZE = 256 * 1024;
+
+class TreeWalk
+{
+    WorkStealingPool &pool;
+    const std::vector<wc_HashType> &hashesToCalculate;
+    const HashOptions &options;
+    const std::function<void(const FileHashResult &)> &onResult;
+    std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel;
+    // Whether small files of a batch go through the multi-buffer SHA-256 engine
+    bool multiBuffer;
+    // What the multi-buffer engine leaves to the usual hashers
+    std::vector<wc_HashType> otherAlgorithms;
+
+    struct Batch
+    {
+        std::vector<std::pair<std::string, uint64_t>> files;
+        uint64_t bytes = 0;
+    };
+
+    // A small file read whole, waiting for the SHA-256 of its batch
+    struct Pending
+    {
+        FileHashResult result;
+        // File buffers only move when the arena's list of them grows, which leaves their contents in place
+        std::span<const byte> contents;
+        std::optional<FileIdentity> identity;
+    };
+
+    // What a pool worker keeps from one file and batch to the next, so it is set up once per worker instead of once
+    // per file
+    struct Worker
+    {
+        HashArena arena;
+        std::vector<Pending> pending;
+    };
+    std::vector<Worker> workers;
+    DirectoryWalkCallbacks callbacks;
+
+    [[nodiscard]] bool isCancelled() const
+    {
+        return this->shouldCancel && this->shouldCancel->get().load();
+    }
+
+    Worker &worker()
+    {
+        return this->workers[this->pool.currentWorkerIndex()];
+    }
+
+    void report(const FileHashResult &result)
+    {
+        if (result.error.empty())
+        {
+            this->files.fetch_add(1);
+            this->bytes.fetch_add(result.size);
+        }
+        else
+        {
+            this->failed.fetch_add(1);
+        }
+        this->onResult(result);
+    }
+
+    void reportError(const fs::path &path, const std::error_code &error)
+    {
+        FileHashResult result;
+        result.path = path.string();
+        result.error = error.message();
+        this->report(result);
+    }
+
+    void hashFile(const std::string &path, const uint64_t size)
+    {
+        if (this->isCancelled())
+        {
+            return;
+        }
+
+        FileHashResult result;
+        result.path = path;
+        result.size = size;
+        HashOptions fileOptions = this->options;
+        fileOptions.arena = &this->worker().arena;
+        try
+        {
+            result.digests = calculateDigests(path, this->hashesToCalculate, fileOptions, this->shouldCancel);
+        }
+        catch (const std::exception &exception)
+        {
+            result.error = exception.what();
+        }
+        if (this->isCancelled())
+        {
+            return;
+        }
+        this->report(result);
+    }
+
+    // Read a whole small file into the index-th file buffer of the arena, hashing it with every algorithm but
+    // SHA-256 on the way
+    std::span<const byte> readSmallFile(const std::string &path, const uint64_t size, HashArena &arena,
+                                        const size_t index, DigestSet &digests)
+    {
+        const std::vector<Hasher *> &hashers = arena.hashers(this->otherAlgorithms);
+        std::vector<byte> &contents = arena.fileBuffer(index, size);
+        arena.countFile();
+
+        HashOptions readOptions = this->options;
+        readOptions.arena = &arena;
+        const FileReaderPtr reader = openFileReader(path, readOptions, 1);
+        do
+        {
+            const std::span<const byte> data = reader->read(0);
+            contents.insert(contents.end(), data.begin(), data.end());
+            for (Hasher *hasher : hashers)
+            {
+                hasher->updateWithBuffer(data.data(), static_cast<word32>(data.size()));
+            }
+            reader->release(0);
+        } while (!reader->finished());
+
+        for (Hasher *hasher : hashers)
+        {
+            hasher->finalize();
+            digests.set(hasher->getAlgorithm(), hasher->getRawDigest());
+        }
+        return contents;
+    }
+
+    // Hash small files whole, with the SHA-256 of all of them computed together at the end
+    void hashSmallFiles(const std::vector<std::pair<std::string, uint64_t>> &files)
+    {
+        Worker &worker = this->worker();
+        HashArena &arena = worker.arena;
+        std::vector<Pending> &pending = worker.pending;
+        pending.clear();
+
+        for (const auto &[path, size] : files)
+        {
+            if (this->isCancelled())
+            {
+                return;
+            }
+
+            Pending file;
+            file.result.path = path;
+            file.result.size = size;
+            try
+            {
+                // Unchanged files are answered from the digest cache, as calculateDigests would
+                if (this->options.cache != nullptr)
+                {
+                    file.identity = fileIdentity(path);
+                    if (file.identity)
+                    {
+                        if (auto cached = this->options.cache->lookup(*file.identity, this->hashesToCalculate))
+                        {
+                            file.result.digests = std::move(*cached);
+                            this->report(file.result);
+                            continue;
+                        }
+                    }
+                }
+                file.contents = this->readSmallFile(path, size, arena, pending.size(), file.result.digests);
+            }
+            catch (const std::exception &exception)
+            {
+                file.result.error = exception.what();
+                this->report(file.result);
+                continue;
+            }
+            pending.push_back(std::move(file));
+        }
+
+        std::vector<std::span<const uint8_t>> &messages = arena.batchMessages();
+        for (const Pending &file : pending)
+        {
+            messages.emplace_back(file.contents);
+        }
+        std::vector<std::array<uint8_t, SHA256_MB_DIGEST_SIZE>> &sha256 = arena.batchDigests(pending.size());
+        sha256MultiBuffer(messages, sha256);
+
+        for (size_t i = 0; i < pending.size(); i++)
+        {
+            if (this->isCancelled())
+            {
+                return;
+            }
+            Pending &file = pending[i];
+            file.result.digests.set(WC_HASH_TYPE_SHA256, sha256[i]);
+            // Only cache the result if the file did not change while it was being read
+            if (file.identity && fileIdentity(file.result.path) == file.identity)
+            {
+                this->options.cache->store(*file.identity, file.result.path, file.result.digests);
+            }
+            this->report(file.result);
+        }
+    }
+
+    void hashBatch(const std::vector<std::pair<std::string, uint64_t>> &files)
+    {
+        std::vector<std::pair<std::string, uint64_t>> smallFiles;
+        for (const auto &[path, size] : files)
+        {
+            if (this->multiBuffer && size <= MULTI_BUFFER_FILE_SIZE)
+            {
+                smallFiles.emplace_back(path, size);
+            }
+            else
+            {
+                this->hashFile(path, size);
+            }
+        }
+
+        // A lone file gains nothing from the lanes
+        if (smallFiles.size() == 1)
+        {
+            this->hashFile(smallFiles.front().first, smallFiles.front().second);
+        }
+        else if (!smallFiles.empty())
+        {
+            this->hashSmallFiles(smallFiles);
+        }
+    }
+
+    void submitBatch(Batch &batch)
+    {
+        if (batch.files.empty())
+        {
+            return;
+        }
+        this->pool.submit([this, files = std::move(batch.files)]() { this->hashBatch(files); });
+        batch = {};
+    }
+
+    // Queue a file, giving large ones a task of their own so they never hold up the small files batched with them
+    void addFile(Batch &batch, std::string path, const uint64_t size)
+    {
+        if (size >= LARGE_FILE_SIZE)
+        {
+            this->pool.submit([this, path = std::move(path), size]() { this->hashFile(path, size); });
+            return;
+        }
+
+        batch.files.emplace_back(std::move(path), size);
+        batch.bytes += size;
+        if (batch.files.size() >= BATCH_FILES || batch.bytes >= LARGE_FILE_SIZE)
+        {
+            this->submitBatch(batch);
+        }
+    }
+
+    // Queue the files of one listed directory, batching those that are not large
+    void addDirectoryFiles(const std::span<const fs::directory_entry> entries)
+    {
+        Batch batch;
+        for (const fs::directory_entry &entry : entries)
+        {
+            std::error_code error;
+            const uint64_t size = entry.file_size(error);
+            this->addFile(batch, entry.path().string(), error ? 0 : size);
+        }
+        this->submitBatch(batch);
+    }
+
+  public:
+    std::atomic<uint64_t> files = 0;
+    std::atomic<uint64_t> failed = 0;
+    std::atomic<uint64_t> bytes = 0;
+
+    TreeWalk(WorkStealingPool &pool, const std::vector<wc_HashType> &hashesToCalculate, const HashOptions &options,
+             const std::function<void(const FileHashResult &)> &onResult,
+             const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+        : pool(pool), hashesToCalculate(hashesToCalculate), options(options), onResult(onResult),
+          shouldCancel(shouldCancel),
+          // Worth it only where the CPU has lanes to spare, and a checkpoint needs the file hashed the usual way
+          multiBuffer(options.multiBuffer && options.checkpoint == nullptr && sha256MultiBufferLanes() > 1 &&
+                      std::ranges::find(hashesToCalculate, WC_HASH_TYPE_SHA256) != hashesToCalculate.end()),
+          workers(pool.workerCount()),
+          callbacks{
+              .onFiles = [this](const std::span<const fs::directory_entry> entries) {
+                  this->addDirectoryFiles(entries);
+              },
+              .onError = [this](const fs::path &path, const std::error_code &error) { this->reportError(path, error); },
+              .isCancelled = [this]() { return this->isCancelled(); },
+          }
+    {
+        std::ranges::copy_if(hashesToCalculate, std::back_inserter(this->otherAlgorithms),
+                             [](const wc_HashType algorithm) { return algorithm != WC_HASH_TYPE_SHA256; });
+    }
+
+    [[nodiscard]] HashArena::Stats arenaStats() const
+    {
+        HashArena::Stats total;
+        for (const Worker &worker : this->workers)
+        {
+            total += worker.arena.stats();
+        }
+        return total;
+    }
+
+    void addRoots(const std::vector<std::string> &roots)
+    {
+        Batch batch;
+        for (const std::string &root : roots)
+        {
+            std::error_code error;
+            if (fs::is_directory(root, error))
+            {
+                walkDirectoryTree(this->pool, root, this->callbacks);
+                continue;
+            }
+
+            // Anything else, including paths that do not exist, is left for calculateHashes to report on
+            const uintmax_t size = fs::file_size(root, error);
+            this->addFile(batch, root, error ? 0 : static_cast<uint64_t>(size));
+        }
+        this->submitBatch(batch);
+    }
+};
+} // namespace
+
+void walkDirectoryTree(WorkStealingPool &pool, const fs::path &directory, const DirectoryWalkCallbacks &callbacks)
+{
+    pool.submit([&pool, directory, &callbacks]() {
+        if (callbacks.isCancelled())
+        {
+            return;
+        }
+
+        std::error_code error;
+        fs::directory_iterator iterator(directory, fs::directory_options::skip_permission_denied, error);
+        if (error)
+        {
+            callbacks.onError(directory, error);
+            return;
+        }
+
+        std::vector<fs::directory_entry> files;
+        for (; iterator != fs::directory_iterator(); iterator.increment(error))
+        {
+            const fs::directory_entry &entry = *iterator;
+            std::error_code entryError;
+            if (entry.is_directory(entryError) && !entry.is_symlink(entryError))
+            {
+                walkDirectoryTree(pool, entry.path(), callbacks);
+            }
+            else if (entry.is_regular_file(entryError))
+            {
+                files.push_back(entry);
+            }
+        }
+        callbacks.onFiles(files);
+        if (error)
+        {
+            callbacks.onError(directory, error);
+        }
+    });
+}
+
+TreeSummary hashTree(const std::vector<std::string> &roots, const std::vector<wc_HashType> &hashesToCalculate,
+                     const HashOptions &options, const size_t jobs,
+                     const std::function<void(const FileHashResult &)> &onResult,
+                     const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    WorkStealingPool pool(jobs);
+    TreeWalk walk(pool, hashesToCalculate, options, onResult, shouldCancel);
+    walk.addRoots(roots);
+    pool.wait();
+
+    return {
+        .files = walk.files.load(),
+        .failed = walk.failed.load(),
+        .bytes = walk.bytes.load(),
+        .seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+        .arenaMisses = walk.arenaStats().misses,
+    };
+}
\ No newline at end of file
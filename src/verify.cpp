@@ -0,0 +1,303 @@
+#include "verify.h"
+#include "encoding.h"
+#include "pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// Entries are handed to workers a few at a time, so a manifest of a million small files is not a million tasks
+constexpr size_t BATCH_ENTRIES = 16;
+// How often the caller's cancel flag is passed on to the stop flag that hashes in flight watch
+constexpr std::chrono::milliseconds CANCEL_POLL_INTERVAL(10);
+
+// Algorithm named by a manifest file such as SHA256SUMS, release.sha512 or files.b2
+std::optional<wc_HashType> algorithmFromManifestName(const std::string &manifestName)
+{
+    std::string name;
+    for (const char c : fs::path(manifestName).filename().string())
+    {
+        if (c != '-' && c != '_')
+        {
+            name += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+    }
+
+    // Longer names first, so "sha3256" is not taken for "sha256"
+    constexpr std::pair<std::string_view, wc_HashType> HINTS[] = {
+        {"sha3256", WC_HASH_TYPE_SHA3_256}, {"sha3512", WC_HASH_TYPE_SHA3_512}, {"sha256", WC_HASH_TYPE_SHA256},
+        {"sha512", WC_HASH_TYPE_SHA512},    {"sha1", WC_HASH_TYPE_SHA},          {"md5", WC_HASH_TYPE_MD5},
+        {"blake2", WC_HASH_TYPE_BLAKE2B},   {"blake3", HASH_TYPE_BLAKE3},        {"b2", WC_HASH_TYPE_BLAKE2B},
+        {"b3", HASH_TYPE_BLAKE3},           {"xxh128", HASH_TYPE_XXH3_128},      {"xxh3", HASH_TYPE_XXH3_64},
+        {"crc32c", HASH_TYPE_CRC32C},
+    };
+    for (const auto &[hint, algorithm] : HINTS)
+    {
+        if (name.find(hint) != std::string::npos)
+        {
+            return algorithm;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<wc_HashType> algorithmFromDigestLength(const size_t hexLength)
+{
+    switch (hexLength)
+    {
+    case 32:
+        return WC_HASH_TYPE_MD5;
+    case 40:
+        return WC_HASH_TYPE_SHA;
+    case 64:
+        return WC_HASH_TYPE_SHA256;
+    case 128:
+        return WC_HASH_TYPE_SHA512;
+    default:
+        return std::nullopt;
+    }
+}
+
+// Undo the escaping GNU tools apply to names holding a backslash, newline or carriage return
+std::optional<std::string> unescapePath(const std::string_view escaped)
+{
+    std::string path;
+    for (size_t i = 0; i < escaped.size(); i++)
+    {
+        if (escaped[i] != '\\')
+        {
+            path += escaped[i];
+            continue;
+        }
+        if (++i == escaped.size())
+        {
+            return std::nullopt;
+        }
+        switch (escaped[i])
+        {
+        case '\\':
+            path += '\\';
+            break;
+        case 'n':
+            path += '\n';
+            break;
+        case 'r':
+            path += '\r';
+            break;
+        default:
+            return std::nullopt;
+        }
+    }
+    return path;
+}
+
+// Fill in an entry from its parts, checking the digest is hex of the right length for the algorithm
+bool makeEntry(ChecksumEntry &entry, const std::string_view hex, const std::optional<wc_HashType> algorithm)
+{
+    if (!algorithm || hex.size() != Hasher(*algorithm).getDigestSize() * 2)
+    {
+        return false;
+    }
+    entry.algorithm = *algorithm;
+    entry.digest.resize(hex.size() / 2);
+    return decodeHex(hex, entry.digest.data());
+}
+
+std::optional<ChecksumEntry> parseLine(std::string_view line, const std::optional<wc_HashType> algorithm)
+{
+    ChecksumEntry entry;
+    const bool escaped = line.starts_with('\\');
+    if (escaped)
+    {
+        line.remove_prefix(1);
+    }
+
+    // BSD style: ALGORITHM (PATH) = DIGEST
+    const size_t open = line.find(" (");
+    const size_t close = line.rfind(") = ");
+    if (open != std::string_view::npos && close != std::string_view::npos && open < close &&
+        line.find(' ') == open)
+    {
+        const std::string_view hex = line.substr(close + 4);
+        const std::optional<std::string> path = escaped ? unescapePath(line.substr(open + 2, close - open - 2))
+                                                        : std::string(line.substr(open + 2, close - open - 2));
+        if (!path || path->empty() || !makeEntry(entry, hex, algorithmFromName(line.substr(0, open))))
+        {
+            return std::nullopt;
+        }
+        entry.path = *path;
+        return entry;
+    }
+
+    // GNU style: DIGEST, a space, then a space for text or '*' for binary mode, then PATH
+    const size_t space = line.find(' ');
+    if (space == std::string_view::npos || space + 2 >= line.size() ||
+        (line[space + 1] != ' ' && line[space + 1] != '*'))
+    {
+        return std::nullopt;
+    }
+    const std::string_view hex = line.substr(0, space);
+    const std::optional<std::string> path =
+        escaped ? unescapePath(line.substr(space + 2)) : std::string(line.substr(space + 2));
+    if (!path || !makeEntry(entry, hex, algorithm ? algorithm : algorithmFromDigestLength(hex.size())))
+    {
+        return std::nullopt;
+    }
+    entry.path = *path;
+    return entry;
+}
+} // namespace
+
+ChecksumManifest parseChecksumManifest(std::istream &input, const std::string &manifestName,
+                                       const std::optional<wc_HashType> algorithm)
+{
+    const std::optional<wc_HashType> untagged = algorithm ? algorithm : algorithmFromManifestName(manifestName);
+
+    ChecksumManifest manifest;
+    std::string line;
+    for (size_t number = 1; std::getline(input, line); number++)
+    {
+        if (line.ends_with('\r'))
+        {
+            line.pop_back();
+        }
+        if (line.empty() || line.starts_with('#'))
+        {
+            continue;
+        }
+
+        std::optional<ChecksumEntry> entry = parseLine(line, untagged);
+        if (!entry)
+        {
+            manifest.malformedLines++;
+            continue;
+        }
+        entry->line = number;
+        manifest.entries.push_back(std::move(*entry));
+    }
+    return manifest;
+}
+
+VerifySummary verifyChecksums(const ChecksumManifest &manifest, const std::string &baseDirectory,
+                              const HashOptions &options, const size_t jobs, const bool stopOnFailure,
+                              const std::function<void(const ChecksumResult &)> &onResult,
+                              const std::optional<std::reference_wrapper<const std::atomic<bool>>> shouldCancel)
+{
+    std::atomic<uint64_t> ok = 0;
+    std::atomic<uint64_t> failed = 0;
+    std::atomic<uint64_t> missing = 0;
+    std::atomic stop(false);
+    std::atomic stoppedByFailure(false);
+
+    // Hashes in flight watch the stop flag when a failure has to end them, otherwise the caller's flag. In the first
+    // case a watcher below raises the stop flag for the caller's too, and either way it is checked before every file
+    const std::optional<std::reference_wrapper<const std::atomic<bool>>> inFlight =
+        stopOnFailure ? std::optional(std::cref(stop)) : shouldCancel;
+    auto isStopped = [&]() {
+        if (shouldCancel && shouldCancel->get().load())
+        {
+            stop.store(true);
+        }
+        return stop.load();
+    };
+
+    auto check = [&](const ChecksumEntry &entry) {
+        if (isStopped())
+        {
+            return;
+        }
+
+        ChecksumResult result;
+        result.entry = &entry;
+        const fs::path path = baseDirectory.empty() || fs::path(entry.path).is_absolute()
+                                  ? fs::path(entry.path)
+                                  : fs::path(baseDirectory) / entry.path;
+        std::error_code error;
+        if (!fs::exists(path, error))
+        {
+            result.status = ChecksumStatus::Missing;
+        }
+        else
+        {
+            try
+            {
+                const DigestSet digests = calculateDigests(path.string(), {entry.algorithm}, options, inFlight);
+                if (digests.empty())
+                {
+                    // Cancelled part way, so there is nothing to report
+                    return;
+                }
+                result.status = std::ranges::equal(digests.at(entry.algorithm), entry.digest) ? ChecksumStatus::Ok
+                                                                                              : ChecksumStatus::Failed;
+            }
+            catch (const std::exception &exception)
+            {
+                result.status = ChecksumStatus::Failed;
+                result.error = exception.what();
+            }
+        }
+
+        switch (result.status)
+        {
+        case ChecksumStatus::Ok:
+            ok.fetch_add(1);
+            break;
+        case ChecksumStatus::Failed:
+            failed.fetch_add(1);
+            break;
+        case ChecksumStatus::Missing:
+            missing.fetch_add(1);
+            break;
+        }
+        if (result.status != ChecksumStatus::Ok && stopOnFailure)
+        {
+            stoppedByFailure.store(true);
+            stop.store(true);
+        }
+        onResult(result);
+    };
+
+    {
+        std::jthread cancelWatcher;
+        if (stopOnFailure && shouldCancel)
+        {
+            cancelWatcher = std::jthread([&](const std::stop_token token) {
+                while (!token.stop_requested() && !isStopped())
+                {
+                    std::this_thread::sleep_for(CANCEL_POLL_INTERVAL);
+                }
+            });
+        }
+
+        WorkStealingPool pool(std::max<size_t>(jobs, 1));
+        const std::vector<ChecksumEntry> &entries = manifest.entries;
+        for (size_t first = 0; first < entries.size(); first += BATCH_ENTRIES)
+        {
+            const size_t last = std::min(first + BATCH_ENTRIES, entries.size());
+            pool.submit([&, first, last]() {
+                for (size_t i = first; i < last; i++)
+                {
+                    check(entries[i]);
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    const uint64_t checked = ok.load() + failed.load() + missing.load();
+    return {
+        .ok = ok.load(),
+        .failed = failed.load(),
+        .missing = missing.load(),
+        .stopped = stoppedByFailure.load() && checked < manifest.entries.size(),
+    };
+}
\ No newline at end of file
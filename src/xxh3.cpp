@@ -0,0 +1,360 @@
+#include "xxh3.h"
+#include "cpu.h"
+#include "xxh3_impl.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace
+{
+// Where the short input functions and the final merge read the secret, as xxHash places them
+constexpr size_t MIDSIZE_START_OFFSET = 3;
+constexpr size_t MIDSIZE_LAST_OFFSET = 17;
+constexpr size_t SECRET_SIZE_MIN = 136;
+constexpr size_t LAST_STRIPE_OFFSET = XXH3_SECRET_SIZE - XXH3_STRIPE_LEN - 7;
+constexpr size_t MERGE_OFFSET = 11;
+constexpr size_t MIDSIZE_MAX = 240;
+constexpr uint64_t PRIME_MX1 = 0x165667919E3779F9;
+constexpr uint64_t PRIME_MX2 = 0x9FB21C651E98DF25;
+
+struct Hash128
+{
+    uint64_t low;
+    uint64_t high;
+};
+
+// Fold stripes with the widest kernel available
+size_t accumulateStripes(uint64_t *acc, const uint8_t *input, const size_t stripes, const size_t stripeInBlock)
+{
+#ifdef HASHER_HAVE_XXH3_X86
+    const CpuFeatures &cpu = cpuFeatures();
+    if (cpu.avx512f)
+    {
+        return xxh3AccumulateAvx512(acc, input, stripes, stripeInBlock);
+    }
+    if (cpu.avx2)
+    {
+        return xxh3AccumulateAvx2(acc, input, stripes, stripeInBlock);
+    }
+    // Every x86-64 CPU has SSE2
+    return xxh3AccumulateSse2(acc, input, stripes, stripeInBlock);
+#else
+    return xxh3AccumulatePortable(acc, input, stripes, stripeInBlock);
+#endif
+}
+
+uint32_t read32(const uint8_t *bytes)
+{
+    return uint32_t{bytes[0]} | uint32_t{bytes[1]} << 8 | uint32_t{bytes[2]} << 16 | uint32_t{bytes[3]} << 24;
+}
+
+uint64_t read64(const uint8_t *bytes)
+{
+    return xxh3Read64(bytes);
+}
+
+uint64_t secret64(const size_t offset)
+{
+    return xxh3Read64(XXH3_SECRET + offset);
+}
+
+void storeBigEndian(uint8_t *output, const uint64_t value)
+{
+    for (size_t i = 0; i < 8; i++)
+    {
+        output[i] = static_cast<uint8_t>(value >> (56 - 8 * i));
+    }
+}
+
+Hash128 multiply128(const uint64_t a, const uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return {static_cast<uint64_t>(product), static_cast<uint64_t>(product >> 64)};
+#else
+    const uint64_t lowLow = (a & 0xffffffff) * (b & 0xffffffff);
+    const uint64_t highLow = (a >> 32) * (b & 0xffffffff);
+    const uint64_t lowHigh = (a & 0xffffffff) * (b >> 32);
+    const uint64_t highHigh = (a >> 32) * (b >> 32);
+    const uint64_t cross = (lowLow >> 32) + (highLow & 0xffffffff) + lowHigh;
+    return {(cross << 32) | (lowLow & 0xffffffff), (highLow >> 32) + (cross >> 32) + highHigh};
+#endif
+}
+
+uint64_t multiplyFold64(const uint64_t a, const uint64_t b)
+{
+    const Hash128 product = multiply128(a, b);
+    return product.low ^ product.high;
+}
+
+uint64_t xxh64Avalanche(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    return hash ^ (hash >> 32);
+}
+
+uint64_t avalanche(uint64_t hash)
+{
+    hash ^= hash >> 37;
+    hash *= PRIME_MX1;
+    return hash ^ (hash >> 32);
+}
+
+uint64_t rrmxmx(uint64_t hash, const uint64_t length)
+{
+    hash ^= std::rotl(hash, 49) ^ std::rotl(hash, 24);
+    hash *= PRIME_MX2;
+    hash ^= (hash >> 35) + length;
+    hash *= PRIME_MX2;
+    return hash ^ (hash >> 28);
+}
+
+uint64_t mix16(const uint8_t *input, const uint8_t *secret)
+{
+    return multiplyFold64(read64(input) ^ read64(secret), read64(input + 8) ^ read64(secret + 8));
+}
+
+void mix32(Hash128 &acc, const uint8_t *first, const uint8_t *second, const uint8_t *secret)
+{
+    acc.low += mix16(first, secret);
+    acc.low ^= read64(second) + read64(second + 8);
+    acc.high += mix16(second, secret + 16);
+    acc.high ^= read64(first) + read64(first + 8);
+}
+
+uint64_t mergeAccumulators(const std::array<uint64_t, 8> &acc, const uint8_t *secret, const uint64_t start)
+{
+    uint64_t result = start;
+    for (size_t i = 0; i < 4; i++)
+    {
+        result += multiplyFold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+    }
+    return avalanche(result);
+}
+
+// The 64-bit digest of an input of at most 240 bytes
+uint64_t hashShort64(const uint8_t *input, const size_t length)
+{
+    if (length == 0)
+    {
+        return xxh64Avalanche(secret64(56) ^ secret64(64));
+    }
+    if (length <= 3)
+    {
+        const uint32_t combined = uint32_t{input[0]} << 16 | uint32_t{input[length >> 1]} << 24 |
+                                  uint32_t{input[length - 1]} | static_cast<uint32_t>(length) << 8;
+        const uint64_t bitflip = read32(XXH3_SECRET) ^ read32(XXH3_SECRET + 4);
+        return xxh64Avalanche(combined ^ bitflip);
+    }
+    if (length <= 8)
+    {
+        const uint64_t bitflip = secret64(8) ^ secret64(16);
+        const uint64_t combined = read32(input + length - 4) + (uint64_t{read32(input)} << 32);
+        return rrmxmx(combined ^ bitflip, length);
+    }
+    if (length <= 16)
+    {
+        const uint64_t low = read64(input) ^ (secret64(24) ^ secret64(32));
+        const uint64_t high = read64(input + length - 8) ^ (secret64(40) ^ secret64(48));
+        return avalanche(length + std::byteswap(low) + high + multiplyFold64(low, high));
+    }
+
+    uint64_t acc = length * XXH_PRIME64_1;
+    if (length <= 128)
+    {
+        // Pairs of 16 bytes from each end, working inwards
+        for (size_t i = 0; i <= (length - 1) / 32; i++)
+        {
+            acc += mix16(input + 16 * i, XXH3_SECRET + 32 * i);
+            acc += mix16(input + length - 16 * (i + 1), XXH3_SECRET + 32 * i + 16);
+        }
+        return avalanche(acc);
+    }
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        acc += mix16(input + 16 * i, XXH3_SECRET + 16 * i);
+    }
+    acc = avalanche(acc);
+    for (size_t i = 8; i < length / 16; i++)
+    {
+        acc += mix16(input + 16 * i, XXH3_SECRET + 16 * (i - 8) + MIDSIZE_START_OFFSET);
+    }
+    acc += mix16(input + length - 16, XXH3_SECRET + SECRET_SIZE_MIN - MIDSIZE_LAST_OFFSET);
+    return avalanche(acc);
+}
+
+// The 128-bit digest of an input of at most 240 bytes
+Hash128 hashShort128(const uint8_t *input, const size_t length)
+{
+    if (length == 0)
+    {
+        return {xxh64Avalanche(secret64(64) ^ secret64(72)), xxh64Avalanche(secret64(80) ^ secret64(88))};
+    }
+    if (length <= 3)
+    {
+        const uint32_t combinedLow = uint32_t{input[0]} << 16 | uint32_t{input[length >> 1]} << 24 |
+                                     uint32_t{input[length - 1]} | static_cast<uint32_t>(length) << 8;
+        const uint32_t combinedHigh = std::rotl(std::byteswap(combinedLow), 13);
+        const uint64_t bitflipLow = read32(XXH3_SECRET) ^ read32(XXH3_SECRET + 4);
+        const uint64_t bitflipHigh = read32(XXH3_SECRET + 8) ^ read32(XXH3_SECRET + 12);
+        return {xxh64Avalanche(combinedLow ^ bitflipLow), xxh64Avalanche(combinedHigh ^ bitflipHigh)};
+    }
+    if (length <= 8)
+    {
+        const uint64_t combined = read32(input) + (uint64_t{read32(input + length - 4)} << 32);
+        Hash128 product = multiply128(combined ^ (secret64(16) ^ secret64(24)), XXH_PRIME64_1 + (length << 2));
+        product.high += product.low << 1;
+        product.low ^= product.high >> 3;
+        product.low ^= product.low >> 35;
+        product.low *= PRIME_MX2;
+        product.low ^= product.low >> 28;
+        product.high = avalanche(product.high);
+        return product;
+    }
+    if (length <= 16)
+    {
+        const uint64_t low = read64(input);
+        uint64_t high = read64(input + length - 8);
+        Hash128 product = multiply128(low ^ high ^ (secret64(32) ^ secret64(40)), XXH_PRIME64_1);
+        product.low += static_cast<uint64_t>(length - 1) << 54;
+        high ^= secret64(48) ^ secret64(56);
+        product.high += high + (high & 0xffffffff) * (XXH_PRIME32_2 - 1);
+        product.low ^= std::byteswap(product.high);
+        Hash128 result = multiply128(product.low, XXH_PRIME64_2);
+        result.high += product.high * XXH_PRIME64_2;
+        return {avalanche(result.low), avalanche(result.high)};
+    }
+
+    Hash128 acc = {length * XXH_PRIME64_1, 0};
+    if (length <= 128)
+    {
+        for (size_t i = (length - 1) / 32 + 1; i-- > 0;)
+        {
+            mix32(acc, input + 16 * i, input + length - 16 * (i + 1), XXH3_SECRET + 32 * i);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < 4; i++)
+        {
+            mix32(acc, input + 32 * i, input + 32 * i + 16, XXH3_SECRET + 32 * i);
+        }
+        acc = {avalanche(acc.low), avalanche(acc.high)};
+        for (size_t i = 4; i < length / 32; i++)
+        {
+            mix32(acc, input + 32 * i, input + 32 * i + 16, XXH3_SECRET + 32 * (i - 4) + MIDSIZE_START_OFFSET);
+        }
+        mix32(acc, input + length - 16, input + length - 32,
+              XXH3_SECRET + SECRET_SIZE_MIN - MIDSIZE_LAST_OFFSET - 16);
+    }
+    const uint64_t low = acc.low + acc.high;
+    const uint64_t high = acc.low * XXH_PRIME64_1 + acc.high * XXH_PRIME64_4 + length * XXH_PRIME64_2;
+    return {avalanche(low), 0 - avalanche(high)};
+}
+} // namespace
+
+Xxh3::Xxh3()
+    : acc{XXH_PRIME32_3, XXH_PRIME64_1, XXH_PRIME64_2, XXH_PRIME64_3,
+          XXH_PRIME64_4, XXH_PRIME32_2, XXH_PRIME64_5, XXH_PRIME32_1}
+{
+}
+
+void Xxh3::accumulate(const uint8_t *input, const size_t stripes)
+{
+    this->stripeInBlock = static_cast<uint32_t>(accumulateStripes(this->acc.data(), input, stripes, this->stripeInBlock));
+    std::memcpy(this->previousStripe.data(), input + (stripes - 1) * XXH3_STRIPE_LEN, XXH3_STRIPE_LEN);
+}
+
+void Xxh3::update(const uint8_t *input, size_t size)
+{
+    this->totalLength += size;
+    if (size <= INTERNAL_BUFFER_SIZE - this->bufferLength)
+    {
+        std::memcpy(this->buffer.data() + this->bufferLength, input, size);
+        this->bufferLength += static_cast<uint32_t>(size);
+        return;
+    }
+
+    // A stripe is only folded once a byte follows it, since the last stripe of the input is folded differently
+    if (this->bufferLength > 0)
+    {
+        const size_t filled = INTERNAL_BUFFER_SIZE - this->bufferLength;
+        std::memcpy(this->buffer.data() + this->bufferLength, input, filled);
+        input += filled;
+        size -= filled;
+        this->accumulate(this->buffer.data(), INTERNAL_BUFFER_SIZE / XXH3_STRIPE_LEN);
+        this->bufferLength = 0;
+    }
+    if (size > INTERNAL_BUFFER_SIZE)
+    {
+        const size_t stripes = (size - 1) / XXH3_STRIPE_LEN;
+        this->accumulate(input, stripes);
+        input += stripes * XXH3_STRIPE_LEN;
+        size -= stripes * XXH3_STRIPE_LEN;
+    }
+    std::memcpy(this->buffer.data(), input, size);
+    this->bufferLength = static_cast<uint32_t>(size);
+}
+
+bool Xxh3::isValid() const
+{
+    // Short inputs stay whole in the buffer, and past that at least one byte is always kept back for the last stripe
+    const bool bufferMatches = this->totalLength <= MIDSIZE_MAX ? this->bufferLength == this->totalLength
+                                                                : this->bufferLength > 0;
+    return this->bufferLength <= INTERNAL_BUFFER_SIZE && this->stripeInBlock < XXH3_STRIPES_PER_BLOCK && bufferMatches;
+}
+
+std::array<uint64_t, 8> Xxh3::finalAccumulators() const
+{
+    std::array<uint64_t, 8> result = this->acc;
+    const size_t stripes = (this->bufferLength - 1) / XXH3_STRIPE_LEN;
+    accumulateStripes(result.data(), this->buffer.data(), stripes, this->stripeInBlock);
+
+    uint8_t lastStripe[XXH3_STRIPE_LEN];
+    if (this->bufferLength >= XXH3_STRIPE_LEN)
+    {
+        std::memcpy(lastStripe, this->buffer.data() + this->bufferLength - XXH3_STRIPE_LEN, XXH3_STRIPE_LEN);
+    }
+    else
+    {
+        const size_t earlier = XXH3_STRIPE_LEN - this->bufferLength;
+        std::memcpy(lastStripe, this->previousStripe.data() + this->bufferLength, earlier);
+        std::memcpy(lastStripe + earlier, this->buffer.data(), this->bufferLength);
+    }
+    xxh3AccumulateStripe(result.data(), lastStripe, XXH3_SECRET + LAST_STRIPE_OFFSET);
+    return result;
+}
+
+void Xxh3::finalize64(uint8_t *output) const
+{
+    if (this->totalLength <= MIDSIZE_MAX)
+    {
+        storeBigEndian(output, hashShort64(this->buffer.data(), static_cast<size_t>(this->totalLength)));
+        return;
+    }
+    storeBigEndian(output, mergeAccumulators(this->finalAccumulators(), XXH3_SECRET + MERGE_OFFSET,
+                                             this->totalLength * XXH_PRIME64_1));
+}
+
+void Xxh3::finalize128(uint8_t *output) const
+{
+    Hash128 hash;
+    if (this->totalLength <= MIDSIZE_MAX)
+    {
+        hash = hashShort128(this->buffer.data(), static_cast<size_t>(this->totalLength));
+    }
+    else
+    {
+        const std::array<uint64_t, 8> accumulators = this->finalAccumulators();
+        hash.low = mergeAccumulators(accumulators, XXH3_SECRET + MERGE_OFFSET, this->totalLength * XXH_PRIME64_1);
+        hash.high = mergeAccumulators(accumulators, XXH3_SECRET + XXH3_SECRET_SIZE - 64 - MERGE_OFFSET,
+                                      ~(this->totalLength * XXH_PRIME64_2));
+    }
+    storeBigEndian(output, hash.high);
+    storeBigEndian(output + 8, hash.low);
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "xxh3_impl.h"
+
+#ifdef HASHER_HAVE_XXH3_X86
+#include <immintrin.h>
+
+namespace
+{
+struct Avx2
+{
+    using Vec = __m256i;
+    static constexpr size_t LANES = 4;
+
+    static Vec load(const void *data)
+    {
+        return _mm256_loadu_si256(static_cast<const __m256i *>(data));
+    }
+
+    static void store(uint64_t *words, const Vec value)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words), value);
+    }
+
+    static Vec set1(const uint32_t value)
+    {
+        return _mm256_set1_epi32(static_cast<int>(value));
+    }
+
+    static Vec add(const Vec a, const Vec b)
+    {
+        return _mm256_add_epi64(a, b);
+    }
+
+    static Vec bitXor(const Vec a, const Vec b)
+    {
+        return _mm256_xor_si256(a, b);
+    }
+
+    static Vec multiplyLow32(const Vec a, const Vec b)
+    {
+        return _mm256_mul_epu32(a, b);
+    }
+
+    static Vec highHalves(const Vec value)
+    {
+        return _mm256_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1));
+    }
+
+    static Vec swapPairs(const Vec value)
+    {
+        return _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+    }
+
+    static Vec shiftRight47(const Vec value)
+    {
+        return _mm256_srli_epi64(value, 47);
+    }
+
+    static Vec shiftLeft32(const Vec value)
+    {
+        return _mm256_slli_epi64(value, 32);
+    }
+};
+} // namespace
+
+size_t xxh3AccumulateAvx2(uint64_t acc[8], const uint8_t *input, const size_t stripes, const size_t stripeInBlock)
+{
+    return xxh3AccumulateVector<Avx2>(acc, input, stripes, stripeInBlock);
+}
+#endif
\ No newline at end of file
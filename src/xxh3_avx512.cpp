@@ -0,0 +1,69 @@
+#include "xxh3_impl.h"
+
+#ifdef HASHER_HAVE_XXH3_X86
+#include <immintrin.h>
+
+namespace
+{
+struct Avx512
+{
+    using Vec = __m512i;
+    static constexpr size_t LANES = 8;
+
+    static Vec load(const void *data)
+    {
+        return _mm512_loadu_si512(data);
+    }
+
+    static void store(uint64_t *words, const Vec value)
+    {
+        _mm512_storeu_si512(words, value);
+    }
+
+    static Vec set1(const uint32_t value)
+    {
+        return _mm512_set1_epi32(static_cast<int>(value));
+    }
+
+    static Vec add(const Vec a, const Vec b)
+    {
+        return _mm512_add_epi64(a, b);
+    }
+
+    static Vec bitXor(const Vec a, const Vec b)
+    {
+        return _mm512_xor_si512(a, b);
+    }
+
+    static Vec multiplyLow32(const Vec a, const Vec b)
+    {
+        return _mm512_mul_epu32(a, b);
+    }
+
+    static Vec highHalves(const Vec value)
+    {
+        return _mm512_shuffle_epi32(value, static_cast<_MM_PERM_ENUM>(_MM_SHUFFLE(0, 3, 0, 1)));
+    }
+
+    static Vec swapPairs(const Vec value)
+    {
+        return _mm512_shuffle_epi32(value, static_cast<_MM_PERM_ENUM>(_MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    static Vec shiftRight47(const Vec value)
+    {
+        return _mm512_srli_epi64(value, 47);
+    }
+
+    static Vec shiftLeft32(const Vec value)
+    {
+        return _mm512_slli_epi64(value, 32);
+    }
+};
+} // namespace
+
+size_t xxh3AccumulateAvx512(uint64_t acc[8], const uint8_t *input, const size_t stripes, const size_t stripeInBlock)
+{
+    return xxh3AccumulateVector<Avx512>(acc, input, stripes, stripeInBlock);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "cpu.h"
+#include "encoding.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Shared by the known-answer tests. Each test binary counts the checks that failed and exits non-zero if any did;
+// CMake runs every binary once per instruction set, see HASHER_CPU_DISABLE in cpu.h.
+
+inline int failures = 0;
+
+inline void checkHex(const std::string_view what, const std::span<const uint8_t> actual,
+                     const std::string_view expected)
+{
+    const std::string hex = toHex(actual);
+    if (hex != expected)
+    {
+        failures++;
+        std::cerr << std::format("FAIL {}\n  expected {}\n  actual   {}\n", what, expected, hex);
+    }
+}
+
+inline void checkSame(const std::string_view what, const std::span<const uint8_t> actual,
+                      const std::span<const uint8_t> expected)
+{
+    checkHex(what, actual, toHex(expected));
+}
+
+// Bytes 0, 1, ..., 250, 0, 1, ..., the input pattern of the official BLAKE3 test vectors
+inline std::vector<uint8_t> testInput(const size_t size)
+{
+    std::vector<uint8_t> input(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        input[i] = static_cast<uint8_t>(i % 251);
+    }
+    return input;
+}
+
+// Print the result along with the instruction sets the kernels were allowed to use
+inline int finish(const std::string_view name)
+{
+    const CpuFeatures &cpu = cpuFeatures();
+    std::string features;
+    for (const auto &[enabled, feature] : {std::pair{cpu.sse41, "sse4.1"}, std::pair{cpu.sse42, "sse4.2"},
+                                           std::pair{cpu.pclmul, "pclmul"}, std::pair{cpu.avx2, "avx2"},
+                                           std::pair{cpu.avx512f, "avx512f"}})
+    {
+        if (enabled)
+        {
+            features += features.empty() ? feature : std::format(",{}", feature);
+        }
+    }
+    std::cout << std::format("{}: {} with [{}]\n", name, failures == 0 ? "passed" : std::format("{} failed", failures),
+                             features);
+    return failures == 0 ? 0 : 1;
+}
+
+#endif // CHECK_H
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "check.h"
+#include "crc32c.h"
+#include "xxh3.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <string_view>
+#include <vector>
+
+// XXH3 digests from the reference xxHash, as xxhsum prints them, either side of the 16, 128 and 240 byte short-input
+// cases, the 256 byte internal buffer and the 1024 byte block
+struct KnownAnswer {
+    size_t inputLength;
+    std::string_view xxh3_64;
+    std::string_view xxh3_128;
+};
+
+static constexpr KnownAnswer KNOWN_ANSWERS[] = {
+    {0, "2d06800538d394c2", "99aa06d3014798d86001c324468d497f"},
+    {1, "c44bdff4074eecdb", "a6cd5e9392000f6ac44bdff4074eecdb"},
+    {3, "5f4299fc161c9cbb", "e3b55f57945a17cf5f4299fc161c9cbb"},
+    {4, "60dab036a58211f2", "eb70bf5fc779e9e6a6111d53e80a3db5"},
+    {8, "3a1c2d7c85af88f8", "e1e4432a62217fe4cfd50c61c8bb98c1"},
+    {9, "e9612598145bb9dc", "16c769d83e4aebce907931979dca3746"},
+    {16, "8355e3a6f61770db", "72950631827607e2842812cc870dcae2"},
+    {17, "9ef341a99de37328", "685bc458b37d057fc06e233df7729217"},
+    {128, "85c6174c7ff4c46b", "14792fc3af88dc6c05321a0b64d67b41"},
+    {129, "ec7642b431ba3e5a", "dd5e74ac6b45f54ebc30b63382b09a3b"},
+    {240, "375a384d957fe865", "65b5be86da5540e7c92b68e16f83bbb6"},
+    {241, "02e8cd95421c6d02", "1da1cb61bcb8a2a102e8cd95421c6d02"},
+    {255, "074191baf9c49567", "65652759c081c563074191baf9c49567"},
+    {256, "44f5d90dacde463a", "96c36c85d00e5bc544f5d90dacde463a"},
+    {257, "88fc3f7934a6c9be", "8c650dc0594ae28188fc3f7934a6c9be"},
+    {1023, "d3d91d80ac495685", "4325711b0ed4d742d3d91d80ac495685"},
+    {1024, "e5d78bafa45b2aa5", "d0ac1f7b93bf57b9e5d78bafa45b2aa5"},
+    {1025, "e95c42288f28186e", "2882ebca04ec915ce95c42288f28186e"},
+    {2048, "25339063db861586", "a5141efedfefc1af25339063db861586"},
+    {4096, "7135ffa504f1bc71", "e12cd72144990fe57135ffa504f1bc71"},
+    {10000, "1cb3abee1c2fc1c4", "89dec82a789965e61cb3abee1c2fc1c4"},
+    {102400, "1428e17f1cac2837", "ecd387d36185351b1428e17f1cac2837"},
+};
+
+// Update sizes cycled through when streaming, so the input reaches the state cut at every sort of offset within a
+// stripe, the internal buffer and a block
+static constexpr size_t PIECE_SIZES[] = {1, 7, 63, 64, 65, 239, 256, 1023, 1025, 4096};
+
+template <typename Update>
+static void updateInPieces(const std::vector<uint8_t> &input, Update update)
+{
+    size_t offset = 0;
+    for (size_t i = 0; offset < input.size(); i++)
+    {
+        const size_t size = std::min(PIECE_SIZES[i % std::size(PIECE_SIZES)], input.size() - offset);
+        update(input.data() + offset, size);
+        offset += size;
+    }
+}
+
+// CRC-32C one bit at a time, the definition the table and crc32 instruction kernels must agree with
+static std::array<uint8_t, CRC32C_OUT_LEN> bitwiseCrc32c(const std::vector<uint8_t> &input)
+{
+    uint32_t crc = 0xffffffff;
+    for (const uint8_t byte : input)
+    {
+        crc ^= byte;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0x82f63b78 & (0u - (crc & 1)));
+        }
+    }
+    crc = ~crc;
+    return {static_cast<uint8_t>(crc >> 24), static_cast<uint8_t>(crc >> 16), static_cast<uint8_t>(crc >> 8),
+            static_cast<uint8_t>(crc)};
+}
+
+static void checkXxh3(const KnownAnswer &known)
+{
+    const std::vector<uint8_t> input = testInput(known.inputLength);
+    std::array<uint8_t, XXH3_64_OUT_LEN> digest64{};
+    std::array<uint8_t, XXH3_128_OUT_LEN> digest128{};
+
+    Xxh3 whole;
+    whole.update(input.data(), input.size());
+    whole.finalize64(digest64.data());
+    whole.finalize128(digest128.data());
+    checkHex(std::format("XXH3-64 of {} bytes", known.inputLength), digest64, known.xxh3_64);
+    checkHex(std::format("XXH3-128 of {} bytes", known.inputLength), digest128, known.xxh3_128);
+
+    Xxh3 pieces;
+    updateInPieces(input, [&](const uint8_t *data, const size_t size) { pieces.update(data, size); });
+    pieces.finalize64(digest64.data());
+    pieces.finalize128(digest128.data());
+    checkHex(std::format("XXH3-64 of {} bytes in pieces", known.inputLength), digest64, known.xxh3_64);
+    checkHex(std::format("XXH3-128 of {} bytes in pieces", known.inputLength), digest128, known.xxh3_128);
+}
+
+static void checkCrc32c(const size_t length)
+{
+    const std::vector<uint8_t> input = testInput(length);
+    const std::array<uint8_t, CRC32C_OUT_LEN> expected = bitwiseCrc32c(input);
+    std::array<uint8_t, CRC32C_OUT_LEN> digest{};
+
+    Crc32c whole;
+    whole.update(input.data(), input.size());
+    whole.finalize(digest.data());
+    checkSame(std::format("CRC-32C of {} bytes", length), digest, expected);
+
+    Crc32c pieces;
+    updateInPieces(input, [&](const uint8_t *data, const size_t size) { pieces.update(data, size); });
+    pieces.finalize(digest.data());
+    checkSame(std::format("CRC-32C of {} bytes in pieces", length), digest, expected);
+}
+
+int main()
+{
+    for (const KnownAnswer &known : KNOWN_ANSWERS)
+    {
+        checkXxh3(known);
+    }
+
+    // The check value from the CRC catalogue pins the bitwise reference itself
+    const std::string_view check = "123456789";
+    checkHex("CRC-32C bitwise reference", bitwiseCrc32c({check.begin(), check.end()}), "e3069283");
+    // Lengths around the three 256 and 8192 byte streams of the crc32 kernel as well as the vector lengths
+    for (const KnownAnswer &known : KNOWN_ANSWERS)
+    {
+        checkCrc32c(known.inputLength);
+    }
+    for (const size_t length : {7, 767, 768, 769, 3 * 8192 - 1, 3 * 8192, 3 * 8192 + 768, 1024 * 1024 + 3})
+    {
+        checkCrc32c(length);
+    }
+
+    return finish("checksum_test");
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "check.h"
+#include "hash.h"
+#include "sha256_mb.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Message lengths either side of every padding edge: the tail fits one block up to 55 bytes and needs a second from
+// 56, and the same again one and two blocks further on
+static std::vector<size_t> edgeLengths()
+{
+    std::vector<size_t> lengths;
+    for (size_t length = 0; length <= 200; length++)
+    {
+        lengths.push_back(length);
+    }
+    for (const size_t length : {247, 248, 255, 256, 257, 1000, 4095, 4096, 4097, 65537})
+    {
+        lengths.push_back(length);
+    }
+    return lengths;
+}
+
+static std::array<uint8_t, SHA256_MB_DIGEST_SIZE> scalarSha256(const std::span<const uint8_t> message)
+{
+    wc_Sha256 sha;
+    wc_InitSha256(&sha);
+    wc_Sha256Update(&sha, message.data(), static_cast<word32>(message.size()));
+    std::array<uint8_t, SHA256_MB_DIGEST_SIZE> digest{};
+    wc_Sha256Final(&sha, digest.data());
+    wc_Sha256Free(&sha);
+    return digest;
+}
+
+// Hash the messages as one batch and compare every digest with wolfCrypt's for that message alone
+static void checkBatch(const std::string_view what, const std::vector<std::span<const uint8_t>> &messages)
+{
+    std::vector<std::array<uint8_t, SHA256_MB_DIGEST_SIZE>> digests(messages.size());
+    sha256MultiBuffer(messages, digests);
+    for (size_t i = 0; i < messages.size(); i++)
+    {
+        checkSame(std::format("{}: message {} of {} bytes", what, i, messages[i].size()), digests[i],
+                  scalarSha256(messages[i]));
+    }
+}
+
+int main()
+{
+    // Pin the reference itself to the FIPS 180-2 examples
+    const std::string_view abc = "abc";
+    checkHex("SHA-256 of \"\"", scalarSha256({}),
+             "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    checkHex("SHA-256 of \"abc\"", scalarSha256({reinterpret_cast<const uint8_t *>(abc.data()), abc.size()}),
+             "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    std::mt19937 random(22);
+    std::vector<uint8_t> data(256 * 1024);
+    for (uint8_t &byte : data)
+    {
+        byte = static_cast<uint8_t>(random());
+    }
+
+    // Every message starts at its own offset, so few of them are aligned
+    const std::vector<size_t> lengths = edgeLengths();
+    std::vector<std::span<const uint8_t>> messages;
+    size_t offset = 0;
+    for (const size_t length : lengths)
+    {
+        messages.emplace_back(data.data() + offset, length);
+        offset = (offset + length + 1) % (data.size() - 65537);
+    }
+    checkBatch("ascending", messages);
+
+    // Lanes finish at different blocks and are refilled with messages of other lengths
+    checkBatch("descending", {messages.rbegin(), messages.rend()});
+    std::vector<std::span<const uint8_t>> shuffled = messages;
+    std::ranges::shuffle(shuffled, random);
+    checkBatch("shuffled", shuffled);
+
+    // One long message holding a lane while the others cycle through short ones
+    std::vector<std::span<const uint8_t>> oneLong = {messages.back()};
+    oneLong.insert(oneLong.end(), messages.begin(), messages.begin() + 130);
+    checkBatch("one long", oneLong);
+
+    // Batches smaller than, equal to and just over the lane count, leaving some lanes idle
+    for (size_t count = 1; count <= 17; count++)
+    {
+        std::vector<std::span<const uint8_t>> batch;
+        for (size_t i = 0; i < count; i++)
+        {
+            batch.push_back(messages[(i * 37 + count * 11) % messages.size()]);
+        }
+        checkBatch(std::format("{} messages", count), batch);
+    }
+
+    return finish("sha256_mb_test");
+}
\ No newline at end of file